@@ -0,0 +1,462 @@
+//
+//  SepiaBench.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+// Runs every sepia, grayscale, sketchbook, funhouse and neonising implementation over a matrix of image sizes
+// and thread counts on a plain linux box, no phone or java needed (see the
+// Makefile next to this). Each run is timed on the wall clock and the output
+// is checked against the scalar reference:
+//   sepia      applySepiaToneWithDirectPixelManipulations
+//   grayscale  the split, cvAddWeighted and merge applyGrayscale used to be
+//   sketchbook applySketchbook on the scalar backend
+//   funhouse   the row by row mirror, cvErode and cvDilate applyFunhouse used to be
+//   neonising  applyNeonisingWithScratch on the scalar backend
+//
+//   ./sepiabench [-s WxH[,WxH...]] [-t N[,N...]] [-r reps] [-w warmup] [-f filter]
+//
+// Exits non zero if an exact variant doesn't match its reference, so it can
+// sit in front of a release.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "ImageProcessor.h"
+
+/*
+ * Variants
+ */
+
+enum {
+    BENCH_SEPIA = 0,
+    BENCH_GRAYSCALE,
+    BENCH_SKETCHBOOK,
+    BENCH_FUNHOUSE,
+    BENCH_NEONISING,
+    BENCH_KINDS
+};
+
+//for a variant that doesn't compute the same thing as its reference
+#define BENCH_REPORT_ONLY   -1
+
+struct bench_variant
+{
+    const char* name;
+    int         kind;
+    //split over the worker pool, so worth running at every thread count
+    bool        parallel;
+    //largest per channel difference from the reference that still passes,
+    //BENCH_REPORT_ONLY when the difference is only printed
+    int         tolerance;
+    void        (*run)(IplImage* image, int backend);
+    //FILTER_BACKEND_* for the fused kernels, -1 when it doesn't matter
+    int         backend;
+};
+
+static void runOpenCV(IplImage* image, int backend){ applySepiaTone(image); }
+static void runDirect(IplImage* image, int backend){ applySepiaToneWithDirectPixelManipulations(image); }
+static void runDirectSMP(IplImage* image, int backend){ applySepiaToneWithDirectPixelManipulationsAndPthreadsForSMP(image); }
+static void runNe10(IplImage* image, int backend){ applySepiaToneWithDirectPixelManipulationsAndNe10(image); }
+static void runNe10SMP(IplImage* image, int backend){ applySepiaToneWithDirectPixelManipulationsAndNe10AndPthreadsForSMP(image); }
+#if defined(HAVE_NEON)
+static void runNeon(IplImage* image, int backend){ applySepiaToneWithDirectPixelManipulationsAndNeonSSE(image); }
+static void runNeonSMP(IplImage* image, int backend){ applySepiaToneWithDirectPixelManipulationsAndNeonSSEAndPthreadsForSMP(image); }
+#endif
+
+static void runFused(IplImage* image, int backend){
+    setFilterBackend(backend);
+    applySepiaToneFused(image);
+}
+
+//the planar grayscale from before GrayscaleEngine, kept here as the reference
+static void runGrayscalePlanes(IplImage* image, int backend){
+    IplImage* b = cvCreateImage(cvGetSize(image), IPL_DEPTH_8U, 1);
+    IplImage* g = cvCreateImage(cvGetSize(image), IPL_DEPTH_8U, 1);
+    IplImage* r = cvCreateImage(cvGetSize(image), IPL_DEPTH_8U, 1);
+    IplImage* s = cvCreateImage(cvGetSize(image), IPL_DEPTH_8U, 1);
+
+    cvSplit(image, b, g, r, 0);
+    cvAddWeighted(r, 1./3., g, 1./3., 0.0, s);
+    cvAddWeighted(s, 2./3., b, 1./3., 0.0, s);
+    cvMerge(s, s, s, 0, image);
+
+    cvReleaseImage(&b);
+    cvReleaseImage(&g);
+    cvReleaseImage(&r);
+    cvReleaseImage(&s);
+}
+
+static void runGrayscale(IplImage* image, int backend){
+    setFilterBackend(backend);
+    applyGrayscale(image);
+}
+
+static void runGrayscaleGraph(IplImage* image, int backend){
+    static FilterGraph* graph = 0;
+    if (graph == 0) {
+        graph = new FilterGraph();
+        addEffectToGraph(graph, EFFECT_GRAYSCALE);
+    }
+
+    //row nodes work in place, so the result is always image
+    graph->Run(image);
+}
+
+//the grey sketch spread back over the image, so it can be compared like the rest
+static void runSketchbook(IplImage* image, int backend){
+    IplImage* gray = cvCreateImage(cvGetSize(image), IPL_DEPTH_8U, 1);
+
+    if (backend >= 0)
+        setFilterBackend(backend);
+    applySketchbook(image, gray);
+    cvCvtColor(gray, image, CV_GRAY2BGR);
+
+    cvReleaseImage(&gray);
+}
+
+//the sketchbook from before SketchEngine: blur and dodge every colour channel,
+//then take the grey of that with the CV_BGR2GRAY weights. Only here for the
+//timing: SketchEngine takes the blue weighted grey first, and the dodge wraps,
+//so the two are up to 255 apart
+static void runSketchbookPlanes(IplImage* image, int backend){
+    IplImage* blurred = cvCreateImage(cvGetSize(image), IPL_DEPTH_8U, 3);
+    IplImage* gray = cvCreateImage(cvGetSize(image), IPL_DEPTH_8U, 1);
+
+    cvSmooth(image, blurred, CV_GAUSSIAN, 7, 7, 0, 0);
+
+    for (int y = 0; y < image->height; y++) {
+        uchar* src = (uchar*)(image->imageData + y*image->widthStep);
+        uchar* blur = (uchar*)(blurred->imageData + y*blurred->widthStep);
+
+        for (int x = 0; x < image->width*3; x++) {
+            int sum = (255 - src[x]) + blur[x];
+            src[x] = (uchar)(sum < 255 ? 255 : sum);
+        }
+    }
+
+    cvCvtColor(image, gray, CV_BGR2GRAY);
+    cvCvtColor(gray, image, CV_GRAY2BGR);
+
+    cvReleaseImage(&blurred);
+    cvReleaseImage(&gray);
+}
+
+//the funhouse from before FunhouseEngine, kept here as the reference
+static void runFunhousePlanes(IplImage* image, int backend){
+    int half = image->width/2;
+
+    for (int y = 0; y < image->height; y++) {
+        uchar* row = (uchar*)(image->imageData + y*image->widthStep);
+
+        for (int x = 0; x < half; x++)
+            memcpy(row + (image->width-1-x)*3, row + x*3, 3);
+    }
+
+    cvErode(image, image, 0, 2);
+    cvDilate(image, image);
+}
+
+static void runFunhouse(IplImage* image, int backend){
+    setFilterBackend(backend);
+    applyFunhouse(image);
+}
+
+//the neon edges copied back over the image, so it can be compared like the rest
+static void runNeonising(IplImage* image, int backend){
+    IplImage* grey = cvCreateImage(cvGetSize(image), IPL_DEPTH_8U, 1);
+    IplImage* target = cvCreateImage(cvGetSize(image), IPL_DEPTH_8U, 3);
+
+    if (backend >= 0)
+        setFilterBackend(backend);
+    applyNeonisingWithScratch(image, target, grey, NEONISING_TURQUOISE, NEONISING_MAGENTA);
+    cvCopy(target, image);
+
+    cvReleaseImage(&grey);
+    cvReleaseImage(&target);
+}
+
+static std::vector<struct bench_variant> buildVariants(){
+    std::vector<struct bench_variant> variants;
+
+    //the reference of each kind goes first, it's what the rest are checked against
+    struct bench_variant fixed[] = {
+        {"direct",          BENCH_SEPIA,     false, 0, runDirect,         -1},
+        {"opencv",          BENCH_SEPIA,     false, 0, runOpenCV,         -1},
+        {"direct_smp",      BENCH_SEPIA,     true,  0, runDirectSMP,      -1},
+        //Ne10 scales by 0.3 rather than dividing by 3, which is out by at
+        //most 765*(1/3 - 0.3), so 26 levels with the rounding
+        {"ne10",            BENCH_SEPIA,     false, 26, runNe10,          -1},
+        {"ne10_smp",        BENCH_SEPIA,     true,  26, runNe10SMP,       -1},
+#if defined(HAVE_NEON)
+        //vdiv3_u8 is a shift and add approximation
+        {"neon",            BENCH_SEPIA,     false, 1, runNeon,           -1},
+        {"neon_smp",        BENCH_SEPIA,     true,  1, runNeonSMP,        -1},
+#endif
+        {"grayscale_planes", BENCH_GRAYSCALE, false, 0, runGrayscalePlanes, -1},
+        {"grayscale_graph", BENCH_GRAYSCALE, true,  0, runGrayscaleGraph, -1},
+        {"sketch_planes",   BENCH_SKETCHBOOK, false, BENCH_REPORT_ONLY, runSketchbookPlanes, -1},
+        {"funhouse_planes", BENCH_FUNHOUSE,  false, 0, runFunhousePlanes, -1},
+    };
+
+    for (size_t i = 0; i < sizeof(fixed)/sizeof(fixed[0]); i++)
+        variants.push_back(fixed[i]);
+
+    //the single pass kernels once per backend this cpu can run
+    static char names[FILTER_BACKEND_COUNT][5][32];
+    for (int b = 0; b < FILTER_BACKEND_COUNT; b++) {
+        if (!isFilterBackendSupported(b))
+            continue;
+
+        snprintf(names[b][0], sizeof(names[b][0]), "fused_%s", getFilterBackendName(b));
+        struct bench_variant fused = {names[b][0], BENCH_SEPIA, true, 0, runFused, b};
+        variants.push_back(fused);
+
+        snprintf(names[b][1], sizeof(names[b][1]), "grayscale_%s", getFilterBackendName(b));
+        struct bench_variant grayscale = {names[b][1], BENCH_GRAYSCALE, true, 0, runGrayscale, b};
+        variants.push_back(grayscale);
+
+        snprintf(names[b][2], sizeof(names[b][2]), "sketch_%s", getFilterBackendName(b));
+        struct bench_variant sketch = {names[b][2], BENCH_SKETCHBOOK, true, 0, runSketchbook, b};
+        variants.push_back(sketch);
+
+        snprintf(names[b][3], sizeof(names[b][3]), "funhouse_%s", getFilterBackendName(b));
+        struct bench_variant funhouse = {names[b][3], BENCH_FUNHOUSE, true, 0, runFunhouse, b};
+        variants.push_back(funhouse);
+
+        snprintf(names[b][4], sizeof(names[b][4]), "neonising_%s", getFilterBackendName(b));
+        struct bench_variant neonising = {names[b][4], BENCH_NEONISING, true, 0, runNeonising, b};
+        variants.push_back(neonising);
+    }
+
+    return variants;
+}
+
+/*
+ * Private functions
+ */
+
+static void fillTestImage(IplImage* image){
+    //something photo like: smooth gradients plus some noise, full range
+    unsigned int seed = 12345;
+
+    for (int y = 0; y < image->height; y++) {
+        uchar* row = (uchar*)(image->imageData + y*image->widthStep);
+
+        for (int x = 0; x < image->width; x++) {
+            seed = seed*1103515245 + 12345;
+            int noise = (seed >> 16) & 31;
+
+            row[3*x+0] = (uchar)((x*255/image->width + noise) & 255);
+            row[3*x+1] = (uchar)((y*255/image->height + noise) & 255);
+            row[3*x+2] = (uchar)(((x+y)*255/(image->width+image->height) + 2*noise) & 255);
+        }
+    }
+}
+
+static int maxDifference(IplImage* a, IplImage* b){
+    int worst = 0;
+
+    for (int y = 0; y < a->height; y++) {
+        uchar* pa = (uchar*)(a->imageData + y*a->widthStep);
+        uchar* pb = (uchar*)(b->imageData + y*b->widthStep);
+
+        for (int x = 0; x < a->width*3; x++) {
+            int d = abs(pa[x] - pb[x]);
+            if (d > worst)
+                worst = d;
+        }
+    }
+
+    return worst;
+}
+
+static bool parseSizes(const char* arg, std::vector<CvSize>* sizes){
+    sizes->clear();
+
+    while (*arg) {
+        int w, h, n = 0;
+        if (sscanf(arg, "%dx%d%n", &w, &h, &n) != 2 || w <= 0 || h <= 0)
+            return false;
+
+        sizes->push_back(cvSize(w, h));
+        arg += n;
+        if (*arg == ',')
+            arg++;
+    }
+
+    return !sizes->empty();
+}
+
+static bool parseCounts(const char* arg, std::vector<int>* counts){
+    counts->clear();
+
+    while (*arg) {
+        char* end;
+        long n = strtol(arg, &end, 10);
+        if (end == arg || n <= 0)
+            return false;
+
+        counts->push_back((int)n);
+        arg = *end == ',' ? end+1 : end;
+    }
+
+    return !counts->empty();
+}
+
+static void usage(const char* name){
+    fprintf(stderr, "usage: %s [-s WxH[,WxH...]] [-t threads[,threads...]] [-r reps] [-w warmup] [-f filter]\n", name);
+}
+
+/*
+ * Main
+ */
+
+int main(int argc, char** argv){
+    std::vector<CvSize> sizes;
+    std::vector<int> threads;
+    int reps = 21;
+    int warmup = 3;
+    const char* filter = 0;
+
+    sizes.push_back(cvSize(320, 240));
+    sizes.push_back(cvSize(640, 480));
+    sizes.push_back(cvSize(1280, 720));
+    sizes.push_back(cvSize(2048, 1536));
+
+    //powers of two up to the pool, and the pool itself
+    int workers = WorkerPool::GetShared()->GetNumberOfWorkers();
+    for (int t = 1; t < workers; t *= 2)
+        threads.push_back(t);
+    threads.push_back(workers);
+
+    for (int i = 1; i < argc; i++) {
+        const char* value = i+1 < argc ? argv[i+1] : 0;
+
+        if (strcmp(argv[i], "-s") == 0 && value && parseSizes(value, &sizes)) {
+            i++;
+        }else if (strcmp(argv[i], "-t") == 0 && value && parseCounts(value, &threads)) {
+            i++;
+        }else if (strcmp(argv[i], "-r") == 0 && value && (reps = atoi(value)) > 0) {
+            i++;
+        }else if (strcmp(argv[i], "-w") == 0 && value && (warmup = atoi(value)) >= 0) {
+            i++;
+        }else if (strcmp(argv[i], "-f") == 0 && value) {
+            filter = value;
+            i++;
+        }else{
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<struct bench_variant> variants = buildVariants();
+    int defaultBackend = getFilterBackend();
+    int failures = 0;
+
+    printf("%d worker threads, %s backend by default, %d reps after %d warm up\n\n",
+           workers, getFilterBackendName(defaultBackend), reps, warmup);
+    printf("%-17s %11s %7s %10s %10s %9s %7s\n",
+           "variant", "size", "threads", "median ms", "p99 ms", "MPix/s", "maxdiff");
+
+    for (size_t s = 0; s < sizes.size(); s++) {
+        IplImage* source = cvCreateImage(sizes[s], IPL_DEPTH_8U, 3);
+        IplImage* image = cvCreateImage(sizes[s], IPL_DEPTH_8U, 3);
+        IplImage* reference[BENCH_KINDS];
+        for (int k = 0; k < BENCH_KINDS; k++)
+            reference[k] = cvCreateImage(sizes[s], IPL_DEPTH_8U, 3);
+        double pixels = (double)sizes[s].width*sizes[s].height;
+
+        fillTestImage(source);
+
+        //the reference outputs, single threaded on the scalar backend
+        WorkerPool::GetShared()->SetActiveWorkers(1);
+        setFilterBackend(FILTER_BACKEND_SCALAR);
+        cvCopy(source, reference[BENCH_SEPIA]);
+        applySepiaToneWithDirectPixelManipulations(reference[BENCH_SEPIA]);
+        cvCopy(source, reference[BENCH_GRAYSCALE]);
+        runGrayscalePlanes(reference[BENCH_GRAYSCALE], -1);
+        cvCopy(source, reference[BENCH_SKETCHBOOK]);
+        runSketchbook(reference[BENCH_SKETCHBOOK], -1);
+        cvCopy(source, reference[BENCH_FUNHOUSE]);
+        runFunhousePlanes(reference[BENCH_FUNHOUSE], -1);
+        cvCopy(source, reference[BENCH_NEONISING]);
+        runNeonising(reference[BENCH_NEONISING], -1);
+
+        for (size_t v = 0; v < variants.size(); v++) {
+            struct bench_variant* variant = &variants[v];
+
+            if (filter && strstr(variant->name, filter) == 0)
+                continue;
+
+            int previous = 0;
+
+            for (size_t t = 0; t < threads.size(); t++) {
+                //single threaded variants only need the one run
+                if (!variant->parallel && t > 0)
+                    break;
+
+                //asking for more threads than the pool has gets the whole pool
+                WorkerPool::GetShared()->SetActiveWorkers(variant->parallel ? threads[t] : 1);
+                int count = WorkerPool::GetShared()->GetActiveWorkers();
+                if (count == previous)
+                    continue;
+
+                previous = count;
+                setFilterBackend(variant->backend >= 0 ? variant->backend : defaultBackend);
+
+                std::vector<double> samples;
+                int worst = 0;
+
+                for (int r = -warmup; r < reps; r++) {
+                    cvCopy(source, image);
+
+                    int64_t begin = timingNow();
+                    variant->run(image, variant->backend);
+                    int64_t end = timingNow();
+
+                    if (r >= 0)
+                        samples.push_back((double)(end - begin) / 1000000.0);
+
+                    //every run is checked, not just the first
+                    worst = std::max(worst, maxDifference(image, reference[variant->kind]));
+                }
+
+                std::sort(samples.begin(), samples.end());
+                double median = samples[samples.size()/2];
+                //nearest rank
+                double p99 = samples[std::min(samples.size()-1, (size_t)(samples.size()*0.99))];
+
+                bool reportOnly = variant->tolerance == BENCH_REPORT_ONLY;
+                bool passed = reportOnly || worst <= variant->tolerance;
+                if (!passed)
+                    failures++;
+
+                char size[24];
+                snprintf(size, sizeof(size), "%dx%d", sizes[s].width, sizes[s].height);
+                printf("%-17s %11s %7d %10.3f %10.3f %9.1f %7d%s\n",
+                       variant->name, size, count, median, p99,
+                       pixels / (median / 1000.0) / 1000000.0, worst,
+                       reportOnly ? "  (not checked)" : (passed ? "" : "  MISMATCH"));
+                fflush(stdout);
+            }
+        }
+
+        for (int k = 0; k < BENCH_KINDS; k++)
+            cvReleaseImage(&reference[k]);
+        cvReleaseImage(&image);
+        cvReleaseImage(&source);
+    }
+
+    WorkerPool::GetShared()->SetActiveWorkers(0);
+    setFilterBackend(FILTER_BACKEND_AUTO);
+
+    if (failures)
+        printf("\n%d runs didn't match their reference\n", failures);
+
+    return failures ? 1 : 0;
+}
@@ -31,6 +31,7 @@ LOCAL_SRC_FILES := \
         cxcore/src/cxminmaxloc.cpp \
         cxcore/src/cxnorm.cpp \
         cxcore/src/cxouttext.cpp \
+        cxcore/src/cxparallel.cpp \
         cxcore/src/cxpersistence.cpp \
         cxcore/src/cxprecomp.cpp \
         cxcore/src/cxrand.cpp \
@@ -120,6 +121,19 @@ LOCAL_SRC_FILES := \
         cv/src/mycvHaarDetectObjects.cpp
 #        cv/src/cvkdtree.cpp \
 
+# stage 0 of the haar scan written with neon intrinsics, picked at runtime
+# through cpufeatures like the app's kernels (see mycvHaarDetectObjects.cpp)
+cv_neon_source_files := \
+        cv/src/mycvHaarDetectObjectsNeon.cpp
+
+# the .neon suffix builds just these files with -mfpu=neon
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_CFLAGS += -DHAVE_NEON=1
+LOCAL_SRC_FILES += $(cv_neon_source_files:%=%.neon)
+endif
+
+LOCAL_STATIC_LIBRARIES := cpufeatures
+
 include $(BUILD_STATIC_LIBRARY)
 
 
@@ -276,7 +290,7 @@ ne10_neon_source := \
     source/NE10_sub.neon.s \
     source/NE10_transmat.neon.s \
 
-ne10_source_files := \
+ne10_asm_source_files := \
     source/NE10_abs.asm.s \
     source/NE10_addc.asm.s \
     source/NE10_addmat.asm.s \
@@ -302,6 +316,8 @@ ne10_source_files := \
     source/NE10_submat.asm.s \
     source/NE10_sub.asm.s \
     source/NE10_transmat.asm.s \
+
+ne10_source_files := \
     source/NE10_abs.c \
     source/NE10_addc.c \
     source/NE10_addmat.c \
@@ -331,7 +347,6 @@ ne10_source_files := \
 include $(CLEAR_VARS)
 
 #LOCAL_CPP_EXTENSION := .cc
-LOCAL_CFLAGS := -D_ARM_ASSEM_
 LOCAL_ARM_MODE := arm
 
 
@@ -346,24 +361,59 @@ LOCAL_C_INCLUDES := \
         $(LOCAL_PATH)/otherlibs/highgui \
         $(LOCAL_PATH)/headers/ \
         $(LOCAL_PATH)/inc 
-LOCAL_CFLAGS := $(LOCAL_C_INCLUDES:%=-I%) -mfloat-abi=softfp -mfpu=neon -march=armv7 -mthumb -O2 -ftree-vectorize
-
-ifeq ($(ARCH_ARM_HAVE_NEON),true)
-LOCAL_SRC_FILES += $(ne10_neon_source)
-endif
+# no -mfpu=neon here: the library has to load on cpus without it, the neon
+# kernels are built separately below and picked at runtime (FilterBackend)
+LOCAL_CFLAGS := $(LOCAL_C_INCLUDES:%=-I%) -O2 -ftree-vectorize
 
-LOCAL_LDLIBS := -L$(SYSROOT)/usr/lib -ldl -llog \
+LOCAL_LDLIBS := -L$(SYSROOT)/usr/lib -ldl -llog -ljnigraphics \
                 -L$(TARGET_OUT) -lcxcore -lcv -lcvaux -lcvml -lcvhighgui
 
 
 LOCAL_SRC_FILES := \
 		$(ne10_source_files) \
         WLNonFileByteStream.cpp \
+        WorkerPool.cpp \
+        StageTimer.cpp \
+        FilterBackend.cpp \
+        SepiaEngine.cpp \
+        SepiaEngineX86.cpp \
+        PackEngine.cpp \
+        PackEngineX86.cpp \
+        GrayscaleEngine.cpp \
+        GrayscaleEngineX86.cpp \
+        SketchEngine.cpp \
+        SketchEngineX86.cpp \
+        FunhouseEngine.cpp \
+        FunhouseEngineX86.cpp \
+        NeonisingEngine.cpp \
+        NeonisingEngineX86.cpp \
+        ImagePool.cpp \
+        FilterGraph.cpp \
+        ProcessingContext.cpp \
+        JobQueue.cpp \
         ImageProcessor.cpp
 
+# kernels written with neon intrinsics
+neon_source_files := \
+        SepiaEngineNeon.cpp \
+        PackEngineNeon.cpp \
+        GrayscaleEngineNeon.cpp \
+        SketchEngineNeon.cpp \
+        FunhouseEngineNeon.cpp \
+        NeonisingEngineNeon.cpp \
+        ImageProcessorNeon.cpp
+
+# the .neon suffix builds just these files with -mfpu=neon
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_CFLAGS += -DHAVE_NEON=1
+LOCAL_SRC_FILES += $(ne10_asm_source_files) \
+                   $(neon_source_files:%=%.neon)
+endif
+
 LOCAL_MODULE_TAGS := eng
 
-LOCAL_STATIC_LIBRARIES := cxcore cv cvaux cvml cvhighgui
+LOCAL_STATIC_LIBRARIES := cxcore cv cvaux cvml cvhighgui cpufeatures
 
 include $(BUILD_SHARED_LIBRARY)
 
+$(call import-module,android/cpufeatures)
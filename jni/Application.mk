@@ -1,4 +1,4 @@
-APP_ABI := armeabi armeabi-v7a
+APP_ABI := armeabi armeabi-v7a x86
 APP_PLATFORM := android-15
 ANDROID=1
 DEBUG=1
@@ -0,0 +1,208 @@
+//
+//  FilterBackend.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#include "FilterBackend.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ANDROID) && defined(__arm__)
+    #include <cpu-features.h>
+#endif
+
+/*
+ * Private variables
+ */
+
+static const char* backendNames[FILTER_BACKEND_COUNT] = {
+    "scalar",
+    "neon",
+    "ssse3",
+    "avx2"
+};
+
+static unsigned int cpuFeatures = 0;
+static struct filter_kernels kernelTable[FILTER_BACKEND_COUNT];
+static const struct filter_kernels* volatile activeKernels = 0;
+static pthread_once_t backendOnce = PTHREAD_ONCE_INIT;
+
+/*
+ * Private functions
+ */
+
+static unsigned int probeCpuFeatures(){
+    unsigned int features = 0;
+
+#if defined(ANDROID) && defined(__arm__)
+    if (android_getCpuFamily() == ANDROID_CPU_FAMILY_ARM &&
+        (android_getCpuFeatures() & ANDROID_CPU_ARM_FEATURE_NEON)) {
+        features |= CPU_FEATURE_NEON;
+    }
+#elif defined(HAVE_NEON)
+    //no cpufeatures off android, trust the build
+    features |= CPU_FEATURE_NEON;
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+        features |= CPU_FEATURE_SSSE3;
+    if (__builtin_cpu_supports("avx2"))
+        features |= CPU_FEATURE_AVX2;
+#endif
+
+    return features;
+}
+
+static void buildKernelTables(){
+    memset(kernelTable, 0, sizeof(kernelTable));
+
+    //scalar is the floor every other backend starts from, so a backend only
+    //has to fill in the filters it actually has a kernel for
+    for (int b = 0; b < FILTER_BACKEND_COUNT; b++) {
+        kernelTable[b].backend = b;
+        kernelTable[b].name = backendNames[b];
+    }
+
+#if defined(HAVE_NEON)
+    kernelTable[FILTER_BACKEND_NEON].sepiaToneRow = sepiaToneRowNeon;
+    kernelTable[FILTER_BACKEND_NEON].packArgbRow = packArgbRowNeon;
+    kernelTable[FILTER_BACKEND_NEON].grayscaleRow = grayscaleRowNeon;
+    kernelTable[FILTER_BACKEND_NEON].sketchBlurColumn = sketchBlurColumnNeon;
+    kernelTable[FILTER_BACKEND_NEON].sketchDodgeRow = sketchDodgeRowNeon;
+    kernelTable[FILTER_BACKEND_NEON].mirrorRow = mirrorRowNeon;
+    kernelTable[FILTER_BACKEND_NEON].morphologyRow = morphologyRowNeon;
+    kernelTable[FILTER_BACKEND_NEON].morphologyColumn = morphologyColumnNeon;
+    kernelTable[FILTER_BACKEND_NEON].sobelMagnitudeRow = sobelMagnitudeRowNeon;
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+    kernelTable[FILTER_BACKEND_SSSE3].sepiaToneRow = sepiaToneRowSSSE3;
+    kernelTable[FILTER_BACKEND_SSSE3].packArgbRow = packArgbRowSSSE3;
+    kernelTable[FILTER_BACKEND_SSSE3].grayscaleRow = grayscaleRowSSSE3;
+    kernelTable[FILTER_BACKEND_SSSE3].sketchBlurColumn = sketchBlurColumnSSSE3;
+    kernelTable[FILTER_BACKEND_SSSE3].sketchDodgeRow = sketchDodgeRowSSSE3;
+    kernelTable[FILTER_BACKEND_SSSE3].mirrorRow = mirrorRowSSSE3;
+    kernelTable[FILTER_BACKEND_SSSE3].morphologyRow = morphologyRowSSSE3;
+    kernelTable[FILTER_BACKEND_SSSE3].morphologyColumn = morphologyColumnSSSE3;
+    kernelTable[FILTER_BACKEND_SSSE3].sobelMagnitudeRow = sobelMagnitudeRowSSSE3;
+
+    //anything avx2 doesn't have a kernel for falls back to ssse3
+    kernelTable[FILTER_BACKEND_AVX2] = kernelTable[FILTER_BACKEND_SSSE3];
+    kernelTable[FILTER_BACKEND_AVX2].backend = FILTER_BACKEND_AVX2;
+    kernelTable[FILTER_BACKEND_AVX2].name = backendNames[FILTER_BACKEND_AVX2];
+    kernelTable[FILTER_BACKEND_AVX2].sepiaToneRow = sepiaToneRowAVX2;
+#endif
+}
+
+static bool supportedByCpu(int backend){
+    switch (backend) {
+        case FILTER_BACKEND_SCALAR:
+            return true;
+        case FILTER_BACKEND_NEON:
+#if defined(HAVE_NEON)
+            return (cpuFeatures & CPU_FEATURE_NEON) != 0;
+#else
+            //this build has no neon kernels to run
+            return false;
+#endif
+        case FILTER_BACKEND_SSSE3:
+            return (cpuFeatures & CPU_FEATURE_SSSE3) != 0;
+        case FILTER_BACKEND_AVX2:
+            return (cpuFeatures & CPU_FEATURE_AVX2) != 0;
+        default:
+            return false;
+    }
+}
+
+static int bestBackend(){
+    //fastest first
+    if (supportedByCpu(FILTER_BACKEND_AVX2))
+        return FILTER_BACKEND_AVX2;
+    if (supportedByCpu(FILTER_BACKEND_SSSE3))
+        return FILTER_BACKEND_SSSE3;
+    if (supportedByCpu(FILTER_BACKEND_NEON))
+        return FILTER_BACKEND_NEON;
+    return FILTER_BACKEND_SCALAR;
+}
+
+static int backendFromName(const char* name){
+    for (int b = 0; b < FILTER_BACKEND_COUNT; b++) {
+        if (strcmp(name, backendNames[b]) == 0)
+            return b;
+    }
+    return FILTER_BACKEND_AUTO;
+}
+
+static void initialiseBackends(){
+    cpuFeatures = probeCpuFeatures();
+    buildKernelTables();
+
+    int backend = bestBackend();
+
+    //let hosts force a backend without recompiling
+    const char* forced = getenv("FACEIT_FILTER_BACKEND");
+    if (forced) {
+        int b = backendFromName(forced);
+        if (b != FILTER_BACKEND_AUTO && supportedByCpu(b))
+            backend = b;
+    }
+
+    activeKernels = &kernelTable[backend];
+}
+
+/*
+ * Public functions
+ */
+
+unsigned int getCpuFeatures(){
+    pthread_once(&backendOnce, initialiseBackends);
+    return cpuFeatures;
+}
+
+bool isFilterBackendSupported(int backend){
+    pthread_once(&backendOnce, initialiseBackends);
+    return supportedByCpu(backend);
+}
+
+int getBestFilterBackend(){
+    pthread_once(&backendOnce, initialiseBackends);
+    return bestBackend();
+}
+
+bool setFilterBackend(int backend){
+    if (backend == FILTER_BACKEND_AUTO)
+        backend = getBestFilterBackend();
+
+    if (!isFilterBackendSupported(backend))
+        return false;
+
+    activeKernels = &kernelTable[backend];
+    return true;
+}
+
+int getFilterBackend(){
+    return getFilterKernels()->backend;
+}
+
+const char* getFilterBackendName(int backend){
+    if (backend < 0 || backend >= FILTER_BACKEND_COUNT)
+        return "unknown";
+    return backendNames[backend];
+}
+
+const struct filter_kernels* getFilterKernels(){
+    pthread_once(&backendOnce, initialiseBackends);
+    return activeKernels;
+}
+
+const struct filter_kernels* getFilterKernelsFor(int backend){
+    if (!isFilterBackendSupported(backend))
+        return 0;
+    return &kernelTable[backend];
+}
@@ -0,0 +1,123 @@
+//
+//  FilterBackend.h
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#ifndef FaceIt_FilterBackend_h
+#define FaceIt_FilterBackend_h
+
+#include <stdint.h>
+
+/*
+ * Runtime selection of the vector kernels behind each filter.
+ *
+ * The cpu is probed once (cpufeatures on arm, cpuid on x86) and every filter
+ * is sent to the best kernel the device can run. setFilterBackend forces a
+ * particular one, which is handy for comparing them on the same device, and
+ * the FACEIT_FILTER_BACKEND environment variable ("scalar", "neon", "ssse3"
+ * or "avx2") does the same thing on hosts without a java side.
+ */
+
+enum {
+    FILTER_BACKEND_AUTO = -1,
+    FILTER_BACKEND_SCALAR = 0,
+    FILTER_BACKEND_NEON,
+    FILTER_BACKEND_SSSE3,
+    FILTER_BACKEND_AVX2,
+    FILTER_BACKEND_COUNT
+};
+
+#define CPU_FEATURE_NEON    (1 << 0)
+#define CPU_FEATURE_SSSE3   (1 << 1)
+#define CPU_FEATURE_AVX2    (1 << 2)
+
+//row kernels process as many whole vectors as fit in width and return how
+//many pixels they did, the caller finishes the rest with scalar code.
+//a NULL entry means the backend has nothing better than scalar for that filter
+typedef int (*SepiaRowKernel)(uint8_t* row, int width);
+typedef int (*PackRowKernel)(const uint8_t* src, uint8_t* dst, int width, bool rgba);
+//replicate writes the grey back out as 3 channels, otherwise dst is 1 channel
+typedef int (*GrayscaleRowKernel)(const uint8_t* src, uint8_t* dst, int width, bool rgba, bool replicate);
+//the two halves of the sketchbook effect (see SketchEngine.h): the vertical blur
+//of 7 grey rows, and the horizontal blur of that plus the dodge against grey
+typedef int (*SketchBlurKernel)(const uint8_t* const* rows, uint8_t* dst, int width);
+typedef int (*SketchDodgeKernel)(const uint8_t* blurred, const uint8_t* grey, uint8_t* dst, int width);
+//the funhouse effect (see FunhouseEngine.h). The mirror returns how many pixels
+//of the left half it did, the morphology kernels work in bytes: the minimum (or
+//maximum) of each byte and its neighbours radius pixels either side in a row,
+//and of the same byte in count rows
+typedef int (*MirrorRowKernel)(uint8_t* row, int width, int channels);
+typedef int (*MorphologyRowKernel)(const uint8_t* padded, uint8_t* dst, int bytes, int channels,
+                                   int radius, bool dilate);
+typedef int (*MorphologyColumnKernel)(const uint8_t* const* rows, int count, uint8_t* dst, int bytes,
+                                      bool dilate);
+//the sobel magnitude of the middle one of 3 rows for the neonising effect (see
+//NeonisingEngine.h), each row has a pixel to spare either side
+typedef int (*SobelMagnitudeKernel)(const uint8_t* const* rows, uint8_t* dst, int width);
+
+struct filter_kernels
+{
+    int             backend;
+    const char*     name;
+
+    SepiaRowKernel  sepiaToneRow;
+    PackRowKernel   packArgbRow;
+    GrayscaleRowKernel grayscaleRow;
+    SketchBlurKernel sketchBlurColumn;
+    SketchDodgeKernel sketchDodgeRow;
+    MirrorRowKernel mirrorRow;
+    MorphologyRowKernel morphologyRow;
+    MorphologyColumnKernel morphologyColumn;
+    SobelMagnitudeKernel sobelMagnitudeRow;
+};
+
+unsigned int    getCpuFeatures();
+
+bool            isFilterBackendSupported(int backend);
+int             getBestFilterBackend();
+
+//FILTER_BACKEND_AUTO goes back to the best supported backend,
+//returns false (and changes nothing) if the cpu can't run the one asked for
+bool            setFilterBackend(int backend);
+int             getFilterBackend();
+const char*     getFilterBackendName(int backend);
+
+//kernels for the active backend
+const struct filter_kernels*    getFilterKernels();
+
+//kernels for a given backend, or NULL if this cpu can't run it
+const struct filter_kernels*    getFilterKernelsFor(int backend);
+
+/*
+ * Vector kernels, each one lives in a translation unit built for its
+ * instruction set and is only ever called through the table above
+ */
+
+#if defined(HAVE_NEON)
+int sepiaToneRowNeon(uint8_t* row, int width);
+int packArgbRowNeon(const uint8_t* src, uint8_t* dst, int width, bool rgba);
+int grayscaleRowNeon(const uint8_t* src, uint8_t* dst, int width, bool rgba, bool replicate);
+int sketchBlurColumnNeon(const uint8_t* const* rows, uint8_t* dst, int width);
+int sketchDodgeRowNeon(const uint8_t* blurred, const uint8_t* grey, uint8_t* dst, int width);
+int mirrorRowNeon(uint8_t* row, int width, int channels);
+int morphologyRowNeon(const uint8_t* padded, uint8_t* dst, int bytes, int channels, int radius, bool dilate);
+int morphologyColumnNeon(const uint8_t* const* rows, int count, uint8_t* dst, int bytes, bool dilate);
+int sobelMagnitudeRowNeon(const uint8_t* const* rows, uint8_t* dst, int width);
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+int sepiaToneRowSSSE3(uint8_t* row, int width);
+int sepiaToneRowAVX2(uint8_t* row, int width);
+int packArgbRowSSSE3(const uint8_t* src, uint8_t* dst, int width, bool rgba);
+int grayscaleRowSSSE3(const uint8_t* src, uint8_t* dst, int width, bool rgba, bool replicate);
+int sketchBlurColumnSSSE3(const uint8_t* const* rows, uint8_t* dst, int width);
+int sketchDodgeRowSSSE3(const uint8_t* blurred, const uint8_t* grey, uint8_t* dst, int width);
+int mirrorRowSSSE3(uint8_t* row, int width, int channels);
+int morphologyRowSSSE3(const uint8_t* padded, uint8_t* dst, int bytes, int channels, int radius, bool dilate);
+int morphologyColumnSSSE3(const uint8_t* const* rows, int count, uint8_t* dst, int bytes, bool dilate);
+int sobelMagnitudeRowSSSE3(const uint8_t* const* rows, uint8_t* dst, int width);
+#endif
+
+#endif
@@ -0,0 +1,279 @@
+//
+//  FilterGraph.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#include "FilterGraph.h"
+#include "WorkerPool.h"
+
+#include <string.h>
+
+/*
+ * Private functions
+ */
+
+struct thread_data_rows
+{
+    IplImage *image;
+    struct filter_node *nodes;
+    int count;
+};
+
+static void doThreadGruntworkRows(void*threadarg, int startRow, int stopRow, int worker){
+    struct thread_data_rows *my_data = (struct thread_data_rows *) threadarg;
+    IplImage *image = my_data->image;
+
+    for (int y = startRow; y < stopRow; y++) {
+        uint8_t *row = (uint8_t*)image->imageData + y*image->widthStep;
+
+        //every fused stage while the row is still hot
+        for (int n = 0; n < my_data->count; n++) {
+            my_data->nodes[n].row(image, row, my_data->nodes[n].params);
+        }
+    }
+}
+
+///////////////////////////// FilterGraph //////////////////////////////////
+
+FilterGraph::FilterGraph()
+{
+    m_numberOfNodes = 0;
+    m_tileBytes = FILTER_GRAPH_TILE_BYTES;
+    memset(m_nodes, 0, sizeof(m_nodes));
+}
+
+
+FilterGraph::~FilterGraph()
+{
+}
+
+
+bool FilterGraph::AddRowNode(const char* name, FilterRowFunction row, void* params)
+{
+    if (m_numberOfNodes >= FILTER_GRAPH_MAX_NODES || !row)
+        return false;
+
+    struct filter_node* node = &m_nodes[m_numberOfNodes++];
+    node->kind = FILTER_NODE_ROW;
+    node->name = name;
+    node->row = row;
+    node->image = 0;
+    node->params = params;
+    node->outputChannels = 0;
+    node->halo = 0;
+
+    return true;
+}
+
+
+bool FilterGraph::AddImageNode(const char* name, FilterImageFunction image, void* params,
+                               int outputChannels, int halo)
+{
+    if (m_numberOfNodes >= FILTER_GRAPH_MAX_NODES || !image)
+        return false;
+
+    struct filter_node* node = &m_nodes[m_numberOfNodes++];
+    node->kind = FILTER_NODE_IMAGE;
+    node->name = name;
+    node->row = 0;
+    node->image = image;
+    node->params = params;
+    node->outputChannels = outputChannels;
+    node->halo = halo;
+
+    return true;
+}
+
+
+void FilterGraph::Clear()
+{
+    m_numberOfNodes = 0;
+    m_pool.Clear();
+}
+
+
+int FilterGraph::GetNumberOfNodes()
+{
+    return m_numberOfNodes;
+}
+
+
+ImagePool* FilterGraph::GetPool()
+{
+    return &m_pool;
+}
+
+
+void FilterGraph::SetTileBytes(int tileBytes)
+{
+    m_tileBytes = tileBytes > 0 ? tileBytes : 0;
+}
+
+
+int FilterGraph::GetTileBytes()
+{
+    return m_tileBytes;
+}
+
+
+bool FilterGraph::IsTileable(struct filter_node* node)
+{
+    if (node->kind == FILTER_NODE_ROW)
+        return true;
+
+    //has to stay in the same image and know how far it looks
+    return node->outputChannels == 0 && node->halo >= 0;
+}
+
+
+void FilterGraph::RunRowNodes(IplImage* image, int first, int stop)
+{
+    struct thread_data_rows rows_data;
+    rows_data.image = image;
+    rows_data.nodes = &m_nodes[first];
+    rows_data.count = stop - first;
+
+    WorkerPool::GetShared()->ParallelFor(image->height, doThreadGruntworkRows, (void*)&rows_data);
+}
+
+
+void FilterGraph::DoThreadGruntworkTiles(void* threadarg, int startBand, int stopBand, int worker)
+{
+    struct thread_data_tiles *my_data = (struct thread_data_tiles *) threadarg;
+    FilterGraph *graph = my_data->graph;
+    IplImage *src = my_data->src;
+    IplImage *dst = my_data->dst;
+    int halo = my_data->halo;
+    int rowBytes = src->width * src->nChannels * (src->depth & 255)/8;
+
+    //one band buffer per worker, big enough for any band and its halo
+    IplImage *buffer = graph->m_pool.Acquire(cvSize(src->width, my_data->bandRows + 2*halo),
+                                             src->depth, src->nChannels);
+
+    for (int b = startBand; b < stopBand; b++) {
+        int startRow = b * my_data->bandRows;
+        int stopRow = MIN(startRow + my_data->bandRows, src->height);
+
+        //the halo stops at the image edges, so the nodes see the real border there
+        int top = MAX(startRow - halo, 0);
+        int bottom = MIN(stopRow + halo, src->height);
+
+        IplImage band;
+        cvInitImageHeader(&band, cvSize(src->width, bottom - top), src->depth, src->nChannels);
+        cvSetData(&band, buffer->imageData, buffer->widthStep);
+        memcpy(band.channelSeq, src->channelSeq, 4);
+
+        for (int y = top; y < bottom; y++) {
+            memcpy(band.imageData + (y-top)*band.widthStep, src->imageData + y*src->widthStep, rowBytes);
+        }
+
+        for (int n = my_data->first; n < my_data->stop; n++) {
+            struct filter_node *node = &graph->m_nodes[n];
+
+            if (node->kind == FILTER_NODE_ROW) {
+                for (int y = 0; y < band.height; y++) {
+                    node->row(&band, (uint8_t*)band.imageData + y*band.widthStep, node->params);
+                }
+            }else{
+                node->image(&band, &band, graph, node->params);
+            }
+        }
+
+        //only the rows this band owns are right all the way through
+        for (int y = startRow; y < stopRow; y++) {
+            memcpy(dst->imageData + y*dst->widthStep, band.imageData + (y-top)*band.widthStep, rowBytes);
+        }
+    }
+
+    graph->m_pool.Release(buffer);
+}
+
+
+void FilterGraph::RunTiled(IplImage* src, IplImage* dst, int first, int stop, int halo)
+{
+    struct thread_data_tiles tiles_data;
+    tiles_data.graph = this;
+    tiles_data.src = src;
+    tiles_data.dst = dst;
+    tiles_data.first = first;
+    tiles_data.stop = stop;
+    tiles_data.halo = halo;
+    tiles_data.bandRows = MAX(m_tileBytes / src->widthStep, FILTER_GRAPH_MIN_TILE_ROWS);
+
+    int bands = (src->height + tiles_data.bandRows - 1) / tiles_data.bandRows;
+
+    WorkerPool::GetShared()->ParallelFor(bands, DoThreadGruntworkTiles, (void*)&tiles_data);
+}
+
+
+IplImage* FilterGraph::Run(IplImage* source)
+{
+    IplImage* current = source;
+    int n = 0;
+
+    while (n < m_numberOfNodes) {
+        //see how far the nodes from here can be tiled, it's only worth it
+        //when there's a neighbourhood op in the run and more than one band
+        int stop = n;
+        int halo = 0;
+        bool hasImageNode = false;
+        while (stop < m_numberOfNodes && IsTileable(&m_nodes[stop])) {
+            halo += m_nodes[stop].halo;
+            hasImageNode |= m_nodes[stop].kind == FILTER_NODE_IMAGE;
+            stop++;
+        }
+
+        if (hasImageNode && m_tileBytes > 0 &&
+            current->height > MAX(m_tileBytes / current->widthStep, FILTER_GRAPH_MIN_TILE_ROWS)) {
+            //bands read their halo from the rows around them, so they can't
+            //write back over them
+            IplImage* output = m_pool.Acquire(cvGetSize(current), current->depth, current->nChannels);
+            memcpy(output->channelSeq, current->channelSeq, 4);
+
+            RunTiled(current, output, n, stop, halo);
+
+            if (current != source)
+                m_pool.Release(current);
+            current = output;
+            n = stop;
+            continue;
+        }
+
+        //fuse the run of row nodes up to the next image node
+        if (m_nodes[n].kind == FILTER_NODE_ROW) {
+            int first = n;
+            while (n < m_numberOfNodes && m_nodes[n].kind == FILTER_NODE_ROW)
+                n++;
+
+            RunRowNodes(current, first, n);
+            continue;
+        }
+
+        struct filter_node* node = &m_nodes[n++];
+
+        if (node->outputChannels == 0) {
+            node->image(current, current, this, node->params);
+            continue;
+        }
+
+        IplImage* output = m_pool.Acquire(cvGetSize(current), current->depth, node->outputChannels);
+
+        //same layout in, same layout out
+        if (output->nChannels == current->nChannels)
+            memcpy(output->channelSeq, current->channelSeq, 4);
+
+        node->image(current, output, this, node->params);
+
+        //the source belongs to the caller, anything in between goes back
+        if (current != source)
+            m_pool.Release(current);
+        current = output;
+    }
+
+    if (current != source)
+        m_pool.Detach(current);
+
+    return current;
+}
@@ -0,0 +1,128 @@
+//
+//  FilterGraph.h
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#ifndef FaceIt_FilterGraph_h
+#define FaceIt_FilterGraph_h
+
+#include <stdint.h>
+#include "cxcore.h"
+#include "ImagePool.h"
+
+//the longest chain a graph will hold
+#define FILTER_GRAPH_MAX_NODES 16
+
+//rough size of each band of rows when tiling, small enough that a band and
+//the scratch its nodes want all stay in L2
+#define FILTER_GRAPH_TILE_BYTES (96*1024)
+
+//the fewest rows a band will have, however wide the image
+#define FILTER_GRAPH_MIN_TILE_ROWS 16
+
+//halo for image nodes that need the whole frame at once (histograms,
+//contours...) and so can't be tiled
+#define FILTER_NODE_WHOLE_FRAME -1
+
+class FilterGraph;
+
+//work on one row of image in place. Called from the worker threads, so it
+//must only touch that row
+typedef void (*FilterRowFunction)(IplImage* image, uint8_t* row, void* params);
+
+//work on the whole of src and write dst, which is src itself for nodes that
+//work in place. Scratch images should come from graph->GetPool()
+typedef void (*FilterImageFunction)(IplImage* src, IplImage* dst, FilterGraph* graph, void* params);
+
+enum {
+    FILTER_NODE_ROW = 0,
+    FILTER_NODE_IMAGE
+};
+
+struct filter_node
+{
+    int                 kind;
+    const char*         name;
+    FilterRowFunction   row;
+    FilterImageFunction image;
+    void*               params;
+    //channels of the image the node writes, 0 to work in place
+    int                 outputChannels;
+    //rows either side of a row the node reads to produce it (3 for a 7x7
+    //blur), or FILTER_NODE_WHOLE_FRAME
+    int                 halo;
+};
+
+struct thread_data_tiles
+{
+    FilterGraph *graph;
+    IplImage *src;
+    IplImage *dst;
+    int first;
+    int stop;
+    int bandRows;
+    int halo;
+};
+
+/*
+ * A chain of effects run over an image in one call.
+ *
+ * Each node takes the image the node before it left behind and declares
+ * what it writes. Row nodes are pointwise (or at least row local) and work
+ * in place; image nodes see the whole frame, for neighbourhood ops like
+ * cvSmooth or cvErode, and either work in place or ask for a new image with
+ * a given number of channels.
+ *
+ * Back to back row nodes are fused into a single pass, so each row goes
+ * through every one of them while it's still in cache, with the rows shared
+ * out across the worker pool. Images handed between nodes, and any scratch
+ * the nodes want, come out of an ImagePool that lives as long as the graph,
+ * so running the same chain on every frame stops allocating once it's warm.
+ *
+ * Runs of in place nodes that say how far they look (their halo) are tiled:
+ * the image is cut into bands of rows about FILTER_GRAPH_TILE_BYTES big, and
+ * each worker takes a band plus the halo rows either side through every node
+ * in the run before moving on, so the frame goes through memory once for the
+ * whole run instead of once per node. The halo rows are thrown away at the
+ * end, so the result is the same as running the nodes one after the other.
+ */
+class FilterGraph {
+public:
+    FilterGraph();
+    ~FilterGraph();
+
+    //false if the graph is already full
+    bool        AddRowNode(const char* name, FilterRowFunction row, void* params);
+    bool        AddImageNode(const char* name, FilterImageFunction image, void* params,
+                             int outputChannels, int halo = FILTER_NODE_WHOLE_FRAME);
+
+    void        Clear();
+    int         GetNumberOfNodes();
+    ImagePool*  GetPool();
+
+    //bytes per band when tiling, 0 runs every node over the whole frame
+    void        SetTileBytes(int tileBytes);
+    int         GetTileBytes();
+
+    //run every node over source, which in place nodes write straight into.
+    //Returns source, or a new image if a node changed the format or the
+    //chain was tiled, in which case the caller owns it (and can hand source
+    //to GetPool()->Release)
+    IplImage*   Run(IplImage* source);
+
+protected:
+    static void DoThreadGruntworkTiles(void* threadarg, int startBand, int stopBand, int worker);
+
+    bool        IsTileable(struct filter_node* node);
+    void        RunRowNodes(IplImage* image, int first, int stop);
+    void        RunTiled(IplImage* src, IplImage* dst, int first, int stop, int halo);
+
+    int         m_numberOfNodes;
+    struct filter_node m_nodes[FILTER_GRAPH_MAX_NODES];
+    ImagePool   m_pool;
+    int         m_tileBytes;
+};
+
+#endif
@@ -0,0 +1,306 @@
+//
+//  FunhouseEngine.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#include "FunhouseEngine.h"
+#include "FilterBackend.h"
+#include "WorkerPool.h"
+#include "StageTimer.h"
+
+#include "cv.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Private kernels
+ */
+
+//scalar versions, also used to finish off whatever the vector kernels leave
+static inline void mirrorPixels(uint8_t* row, int width, int channels, int start){
+    for (int j = start; j < width/2; j++) {
+        uint8_t* src = row + j*channels;
+        uint8_t* dst = row + (width-1-j)*channels;
+        for (int c = 0; c < channels; c++)
+            dst[c] = src[c];
+    }
+}
+
+static inline void morphologyRowBytes(const uint8_t* padded, uint8_t* dst, int start, int bytes,
+                                      int channels, int radius, bool dilate){
+    for (int i = start; i < bytes; i++) {
+        uint8_t v = padded[i];
+        for (int k = 1; k <= radius; k++) {
+            uint8_t l = padded[i - k*channels], r = padded[i + k*channels];
+            if (dilate) {
+                v = l > v ? l : v;
+                v = r > v ? r : v;
+            }else{
+                v = l < v ? l : v;
+                v = r < v ? r : v;
+            }
+        }
+        dst[i] = v;
+    }
+}
+
+static inline void morphologyColumnBytes(const uint8_t* const* rows, int count, uint8_t* dst,
+                                         int start, int bytes, bool dilate){
+    for (int i = start; i < bytes; i++) {
+        uint8_t v = rows[0][i];
+        for (int k = 1; k < count; k++) {
+            uint8_t p = rows[k][i];
+            v = dilate ? (p > v ? p : v) : (p < v ? p : v);
+        }
+        dst[i] = v;
+    }
+}
+
+static inline void mirrorRowWith(MirrorRowKernel kernel, uint8_t* row, int width, int channels){
+    int j = 0;
+
+    //vector kernel for this backend, if it has one
+    if (kernel)
+        j = kernel(row, width, channels);
+
+    mirrorPixels(row, width, channels, j);
+}
+
+struct thread_data_mirror
+{
+    MirrorRowKernel kernel;
+    uint8_t *data;
+    int step;
+    int width;
+    int channels;
+};
+
+static void doThreadGruntworkMirror(void*threadarg, int startRow, int stopRow, int worker){
+    struct thread_data_mirror *my_data = (struct thread_data_mirror *) threadarg;
+    int64_t begin = timingNow();
+
+    for (int y = startRow; y < stopRow; y++) {
+        mirrorRowWith(my_data->kernel, my_data->data + y*my_data->step, my_data->width, my_data->channels);
+    }
+
+    recordTimingSpan(TIMING_STAGE_KERNEL, worker, begin);
+}
+
+struct thread_data_morphology
+{
+    MorphologyRowKernel rowKernel;
+    MorphologyColumnKernel columnKernel;
+    uint8_t *data;
+    int step;
+    int width;
+    int height;
+    int channels;
+    int erodeRadius;
+    int dilateRadius;
+    int bands;
+    //copies of the rows just outside each band, taken before any band is
+    //written, since the bands either side work in place on them
+    uint8_t *halo;
+    int haloRows;
+};
+
+static inline int bandStart(struct thread_data_morphology* my_data, int band){
+    return (int)((long long)band*my_data->height/my_data->bands);
+}
+
+//source row y (clamped to the image) as band sees it
+static inline const uint8_t* morphologySourceRow(struct thread_data_morphology* my_data, int band,
+                                                 int start, int stop, int y){
+    int bytes = my_data->width*my_data->channels;
+    const uint8_t* halo = my_data->halo + band*2*my_data->haloRows*bytes;
+
+    y = y < 0 ? 0 : (y >= my_data->height ? my_data->height-1 : y);
+
+    if (y < start)
+        return halo + (y - (start - my_data->haloRows))*bytes;
+    if (y >= stop)
+        return halo + (my_data->haloRows + y - stop)*bytes;
+    return my_data->data + y*my_data->step;
+}
+
+//one pass of horizontal minimums (or maximums) over src, its edge pixels
+//repeated radius times either side in padded first
+static inline void morphologyRow(struct thread_data_morphology* my_data, const uint8_t* src,
+                                 uint8_t* padded, uint8_t* dst, int radius, bool dilate){
+    int cn = my_data->channels;
+    int bytes = my_data->width*cn;
+
+    memcpy(padded, src, bytes);
+    for (int k = 1; k <= radius; k++) {
+        memcpy(padded - k*cn, padded, cn);
+        memcpy(padded + bytes - cn + k*cn, padded + bytes - cn, cn);
+    }
+
+    int i = my_data->rowKernel ? my_data->rowKernel(padded, dst, bytes, cn, radius, dilate) : 0;
+    morphologyRowBytes(padded, dst, i, bytes, cn, radius, dilate);
+}
+
+static void morphologyBand(struct thread_data_morphology* my_data, int band){
+    int bytes = my_data->width*my_data->channels;
+    int re = my_data->erodeRadius;
+    int rd = my_data->dilateRadius;
+    int halo = my_data->haloRows;
+    int erodeRows = 2*re + 1;
+    int dilateRows = 2*rd + 1;
+    int pad = (re > rd ? re : rd)*my_data->channels;
+    int start = bandStart(my_data, band);
+    int stop = bandStart(my_data, band+1);
+    int last = my_data->height - 1;
+
+    //rolling rows of horizontal minimums of the source, horizontal maximums
+    //of the eroded rows, then one eroded row and a padded copy to work from
+    uint8_t* minRows = (uint8_t*)malloc((erodeRows + dilateRows + 1)*bytes + bytes + 2*pad);
+    if (minRows == 0)
+        return;
+    uint8_t* maxRows = minRows + erodeRows*bytes;
+    uint8_t* eroded = maxRows + dilateRows*bytes;
+    uint8_t* padded = eroded + bytes + pad;
+
+    const uint8_t* rows[2*FUNHOUSE_MAX_RADIUS + 1];
+    int nextSource = -halo - 1;
+
+    //e is the eroded row (clamped to the image, so the dilation sees the
+    //edge rows repeated), y the row it completes
+    for (int e = start - rd; e < stop + rd; e++) {
+        int ec = e < 0 ? 0 : (e > last ? last : e);
+
+        if (nextSource < ec - re)
+            nextSource = ec - re;
+        for (; nextSource <= ec + re; nextSource++) {
+            morphologyRow(my_data, morphologySourceRow(my_data, band, start, stop, nextSource), padded,
+                          minRows + ((nextSource + halo) % erodeRows)*bytes, re, false);
+        }
+
+        for (int k = 0; k < erodeRows; k++)
+            rows[k] = minRows + ((ec - re + k + halo) % erodeRows)*bytes;
+        int i = my_data->columnKernel ? my_data->columnKernel(rows, erodeRows, eroded, bytes, false) : 0;
+        morphologyColumnBytes(rows, erodeRows, eroded, i, bytes, false);
+
+        morphologyRow(my_data, eroded, padded, maxRows + ((e + halo) % dilateRows)*bytes, rd, true);
+
+        int y = e - rd;
+        if (y < start)
+            continue;
+
+        //every source row this one needs has been read, so it can go
+        //straight back into the image
+        for (int k = 0; k < dilateRows; k++)
+            rows[k] = maxRows + ((y - rd + k + halo) % dilateRows)*bytes;
+        uint8_t* out = my_data->data + y*my_data->step;
+        i = my_data->columnKernel ? my_data->columnKernel(rows, dilateRows, out, bytes, true) : 0;
+        morphologyColumnBytes(rows, dilateRows, out, i, bytes, true);
+    }
+
+    free(minRows);
+}
+
+static void doThreadGruntworkMorphology(void*threadarg, int startBand, int stopBand, int worker){
+    struct thread_data_morphology *my_data = (struct thread_data_morphology *) threadarg;
+    int64_t begin = timingNow();
+
+    for (int band = startBand; band < stopBand; band++)
+        morphologyBand(my_data, band);
+
+    recordTimingSpan(TIMING_STAGE_KERNEL, worker, begin);
+}
+
+/*
+ * Public functions
+ */
+
+void mirrorRow(uint8_t* row, int width, int channels){
+    mirrorRowWith(getFilterKernels()->mirrorRow, row, width, channels);
+}
+
+void mirrorImage(uint8_t* data, int step, int width, int height, int channels){
+    struct thread_data_mirror mirror_data;
+    //look the kernel up once so a backend switch can't land mid frame
+    mirror_data.kernel = getFilterKernels()->mirrorRow;
+    mirror_data.data = data;
+    mirror_data.step = step;
+    mirror_data.width = width;
+    mirror_data.channels = channels;
+
+    WorkerPool::GetShared()->ParallelFor(height, doThreadGruntworkMirror, (void*)&mirror_data);
+}
+
+void erodeDilateImage(uint8_t* data, int step, int width, int height, int channels,
+                      int erodeRadius, int dilateRadius){
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (erodeRadius < 0 || erodeRadius > FUNHOUSE_MAX_RADIUS ||
+        dilateRadius < 0 || dilateRadius > FUNHOUSE_MAX_RADIUS)
+        return;
+
+    //without vector kernels the fused pass is slower than cvErode/cvDilate
+    //(114 against 55ms at 1920x1080 on one thread), so leave it to them
+    const struct filter_kernels* kernels = getFilterKernels();
+    if (kernels->morphologyRow == 0 || kernels->morphologyColumn == 0) {
+        CvMat image;
+        int64_t begin = timingNow();
+
+        cvInitMatHeader(&image, height, width, CV_8UC(channels), data, step);
+        if (erodeRadius > 0)
+            cvErode(&image, &image, 0, erodeRadius);
+        if (dilateRadius > 0)
+            cvDilate(&image, &image, 0, dilateRadius);
+
+        recordTimingSpan(TIMING_STAGE_KERNEL, TIMING_CALLING_THREAD, begin);
+        return;
+    }
+
+    struct thread_data_morphology morphology_data;
+    morphology_data.rowKernel = kernels->morphologyRow;
+    morphology_data.columnKernel = kernels->morphologyColumn;
+    morphology_data.data = data;
+    morphology_data.step = step;
+    morphology_data.width = width;
+    morphology_data.height = height;
+    morphology_data.channels = channels;
+    morphology_data.erodeRadius = erodeRadius;
+    morphology_data.dilateRadius = dilateRadius;
+    morphology_data.haloRows = erodeRadius + dilateRadius;
+
+    //one band per worker, but no thinner than the rows it looks at either side
+    int bands = WorkerPool::GetShared()->GetActiveWorkers();
+    int most = height / (morphology_data.haloRows + 1);
+    if (bands > most)
+        bands = most;
+    if (bands < 1)
+        bands = 1;
+    morphology_data.bands = bands;
+
+    int bytes = width*channels;
+    morphology_data.halo = (uint8_t*)malloc((size_t)bands*2*morphology_data.haloRows*bytes + 1);
+    if (morphology_data.halo == 0)
+        return;
+
+    for (int band = 0; band < bands; band++) {
+        int start = bandStart(&morphology_data, band);
+        int stop = bandStart(&morphology_data, band+1);
+        uint8_t* halo = morphology_data.halo + band*2*morphology_data.haloRows*bytes;
+
+        for (int k = 0; k < morphology_data.haloRows; k++) {
+            int above = start - morphology_data.haloRows + k;
+            int below = stop + k;
+
+            if (above >= 0)
+                memcpy(halo + k*bytes, data + above*step, bytes);
+            if (below < height)
+                memcpy(halo + (morphology_data.haloRows + k)*bytes, data + below*step, bytes);
+        }
+    }
+
+    WorkerPool::GetShared()->ParallelFor(bands, doThreadGruntworkMorphology, (void*)&morphology_data);
+
+    free(morphology_data.halo);
+}
@@ -0,0 +1,45 @@
+//
+//  FunhouseEngine.h
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#ifndef FaceIt_FunhouseEngine_h
+#define FaceIt_FunhouseEngine_h
+
+#include <stdint.h>
+
+/*
+ * The funhouse effect: the left half of every row mirrored over the right
+ * half, then an erosion and a dilation with square elements.
+ *
+ * The erosion and dilation are done together in one streaming pass instead of
+ * a cvErode and a cvDilate over the whole frame each. Every worker takes a
+ * band of rows and keeps a few rolling rows of horizontal minimums (and then
+ * maximums) around, so each source row is read once and each result row
+ * written once. Edge pixels are repeated past the border like cvErode and
+ * cvDilate do, so the result is the same as
+ *   cvErode(image, image, 0, erodeRadius); cvDilate(image, image, 0, dilateRadius)
+ * (2 iterations of 3x3 is the same as one 5x5, so the radius is the number of
+ * 3x3 iterations).
+ *
+ * Everything works per byte, so any number of channels is fine, alpha included.
+ */
+
+//what applyFunhouse has always used
+#define FUNHOUSE_ERODE_RADIUS   2
+#define FUNHOUSE_DILATE_RADIUS  1
+#define FUNHOUSE_MAX_RADIUS     4
+
+//copy the left half of a row over the right half, back to front
+void mirrorRow(uint8_t* row, int width, int channels);
+
+//mirror every row of an image, with the rows shared out across the worker pool
+void mirrorImage(uint8_t* data, int step, int width, int height, int channels);
+
+//erode then dilate an image in place, radii up to FUNHOUSE_MAX_RADIUS
+void erodeDilateImage(uint8_t* data, int step, int width, int height, int channels,
+                      int erodeRadius, int dilateRadius);
+
+#endif
@@ -0,0 +1,86 @@
+//
+//  FunhouseEngineNeon.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+// Built with -mfpu=neon on armeabi-v7a only (see Android.mk), and only ever
+// reached through FilterBackend once cpufeatures has seen neon on the device.
+
+#include "FilterBackend.h"
+
+#if defined(HAVE_NEON) && defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+//all 16 lanes back to front, vrev64 does each half and the halves swap
+static inline uint8x16_t vreverseq_u8(uint8x16_t v){
+    v = vrev64q_u8(v);
+    return vcombine_u8(vget_high_u8(v), vget_low_u8(v));
+}
+
+//16 pixels a go off the left half, vld3/vld4 split the channels so each one
+//is reversed on its own and stored back to front on the right
+int mirrorRowNeon(uint8_t* row, int width, int channels){
+    int half = width/2;
+    int j = 0;
+
+    if (channels == 3) {
+        for (; j <= half - 16; j += 16) {
+            uint8x16x3_t pix = vld3q_u8(row + j*3);
+
+            pix.val[0] = vreverseq_u8(pix.val[0]);
+            pix.val[1] = vreverseq_u8(pix.val[1]);
+            pix.val[2] = vreverseq_u8(pix.val[2]);
+            vst3q_u8(row + (width - j - 16)*3, pix);
+        }
+    }else if (channels == 4) {
+        for (; j <= half - 16; j += 16) {
+            uint8x16x4_t pix = vld4q_u8(row + j*4);
+
+            pix.val[0] = vreverseq_u8(pix.val[0]);
+            pix.val[1] = vreverseq_u8(pix.val[1]);
+            pix.val[2] = vreverseq_u8(pix.val[2]);
+            pix.val[3] = vreverseq_u8(pix.val[3]);
+            vst4q_u8(row + (width - j - 16)*4, pix);
+        }
+    }
+    return j;
+}
+
+//16 bytes a go, the neighbours are just unaligned loads channels bytes either side
+int morphologyRowNeon(const uint8_t* padded, uint8_t* dst, int bytes, int channels, int radius, bool dilate){
+    int i = 0;
+    for (; i <= bytes - 16; i += 16) {
+        uint8x16_t v = vld1q_u8(padded + i);
+
+        for (int k = 1; k <= radius; k++) {
+            uint8x16_t l = vld1q_u8(padded + i - k*channels);
+            uint8x16_t r = vld1q_u8(padded + i + k*channels);
+
+            if (dilate)
+                v = vmaxq_u8(v, vmaxq_u8(l, r));
+            else
+                v = vminq_u8(v, vminq_u8(l, r));
+        }
+        vst1q_u8(dst + i, v);
+    }
+    return i;
+}
+
+int morphologyColumnNeon(const uint8_t* const* rows, int count, uint8_t* dst, int bytes, bool dilate){
+    int i = 0;
+    for (; i <= bytes - 16; i += 16) {
+        uint8x16_t v = vld1q_u8(rows[0] + i);
+
+        for (int k = 1; k < count; k++) {
+            uint8x16_t p = vld1q_u8(rows[k] + i);
+            v = dilate ? vmaxq_u8(v, p) : vminq_u8(v, p);
+        }
+        vst1q_u8(dst + i, v);
+    }
+    return i;
+}
+
+#endif
@@ -0,0 +1,101 @@
+//
+//  FunhouseEngineX86.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+// Built for its instruction set with a target attribute like SepiaEngineX86.cpp.
+// FilterBackend hands avx2 the ssse3 kernels.
+
+#include "FilterBackend.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+//16 pixels a go off the left half, stored back to front on the right.
+//3 channel pixels straddle registers, so each output register is put together
+//out of the two or three input registers its bytes come from
+__attribute__((target("ssse3")))
+int mirrorRowSSSE3(uint8_t* row, int width, int channels){
+    int half = width/2;
+    int j = 0;
+
+    if (channels == 3) {
+        const __m128i m01 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,14);
+        const __m128i m02 = _mm_setr_epi8(13,14,15,10,11,12, 7, 8, 9, 4, 5, 6, 1, 2, 3,-1);
+        const __m128i m10 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,15,-1);
+        const __m128i m11 = _mm_setr_epi8(15,-1,11,12,13, 8, 9,10, 5, 6, 7, 2, 3, 4,-1, 0);
+        const __m128i m12 = _mm_setr_epi8(-1, 0,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+        const __m128i m20 = _mm_setr_epi8(-1,12,13,14, 9,10,11, 6, 7, 8, 3, 4, 5, 0, 1, 2);
+        const __m128i m21 = _mm_setr_epi8( 1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+
+        for (; j <= half - 16; j += 16) {
+            const uint8_t* src = row + j*3;
+            uint8_t* dst = row + (width - j - 16)*3;
+
+            __m128i a0 = _mm_loadu_si128((const __m128i*)(src));
+            __m128i a1 = _mm_loadu_si128((const __m128i*)(src+16));
+            __m128i a2 = _mm_loadu_si128((const __m128i*)(src+32));
+
+            _mm_storeu_si128((__m128i*)(dst),
+                             _mm_or_si128(_mm_shuffle_epi8(a1, m01), _mm_shuffle_epi8(a2, m02)));
+            _mm_storeu_si128((__m128i*)(dst+16),
+                             _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, m10), _mm_shuffle_epi8(a1, m11)),
+                                          _mm_shuffle_epi8(a2, m12)));
+            _mm_storeu_si128((__m128i*)(dst+32),
+                             _mm_or_si128(_mm_shuffle_epi8(a0, m20), _mm_shuffle_epi8(a1, m21)));
+        }
+    }else if (channels == 4) {
+        //whole pixels per 32 bit lane, so pshufd reverses a register
+        for (; j <= half - 16; j += 16) {
+            const uint8_t* src = row + j*4;
+            uint8_t* dst = row + (width - j - 16)*4;
+
+            for (int k = 0; k < 4; k++) {
+                __m128i a = _mm_loadu_si128((const __m128i*)(src + 16*k));
+                _mm_storeu_si128((__m128i*)(dst + 48 - 16*k), _mm_shuffle_epi32(a, _MM_SHUFFLE(0,1,2,3)));
+            }
+        }
+    }
+    return j;
+}
+
+//16 bytes a go, the neighbours are just unaligned loads channels bytes either side
+__attribute__((target("ssse3")))
+int morphologyRowSSSE3(const uint8_t* padded, uint8_t* dst, int bytes, int channels, int radius, bool dilate){
+    int i = 0;
+    for (; i <= bytes - 16; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(padded + i));
+
+        for (int k = 1; k <= radius; k++) {
+            __m128i l = _mm_loadu_si128((const __m128i*)(padded + i - k*channels));
+            __m128i r = _mm_loadu_si128((const __m128i*)(padded + i + k*channels));
+
+            if (dilate)
+                v = _mm_max_epu8(v, _mm_max_epu8(l, r));
+            else
+                v = _mm_min_epu8(v, _mm_min_epu8(l, r));
+        }
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+int morphologyColumnSSSE3(const uint8_t* const* rows, int count, uint8_t* dst, int bytes, bool dilate){
+    int i = 0;
+    for (; i <= bytes - 16; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(rows[0] + i));
+
+        for (int k = 1; k < count; k++) {
+            __m128i p = _mm_loadu_si128((const __m128i*)(rows[k] + i));
+            v = dilate ? _mm_max_epu8(v, p) : _mm_min_epu8(v, p);
+        }
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+    return i;
+}
+
+#endif
@@ -0,0 +1,108 @@
+//
+//  GrayscaleEngine.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#include "GrayscaleEngine.h"
+#include "FilterBackend.h"
+#include "WorkerPool.h"
+#include "StageTimer.h"
+
+/*
+ * Private kernels
+ */
+
+static inline int greyOf(int b, int g, int r){
+    int s = ((r + g + 1)*21846) >> 16;
+    return ((2*s + b + 1)*21846) >> 16;
+}
+
+//scalar version, also used to finish off the last few pixels of each row.
+//blue is at b, red at 2-b, and only the colour channels of dst are written
+static inline void grayscalePixels(const uint8_t* src, int srcChannels,
+                                   uint8_t* dst, int dstChannels, int count, int b){
+    for (int x = 0; x < count; x++) {
+        uint8_t grey = (uint8_t)greyOf(src[b], src[1], src[2-b]);
+
+        if (dstChannels == 1) {
+            dst[0] = grey;
+        }else{
+            dst[0] = dst[1] = dst[2] = grey;
+            if (dstChannels == 4)
+                dst[3] = src[3];
+        }
+
+        src += srcChannels;
+        dst += dstChannels;
+    }
+}
+
+static inline void grayscaleRowWith(GrayscaleRowKernel kernel, const uint8_t* src, int srcChannels,
+                                    uint8_t* dst, int dstChannels, int width, bool rgba){
+    int x = 0;
+
+    //vector kernel for this backend, if it has one (3 channel sources only)
+    if (kernel && srcChannels == 3)
+        x = kernel(src, dst, width, rgba, dstChannels != 1);
+
+    //whatever is left over after the last full vector
+    grayscalePixels(src + x*srcChannels, srcChannels, dst + x*dstChannels, dstChannels,
+                    width - x, rgba ? 2 : 0);
+}
+
+struct thread_data_grayscale
+{
+    GrayscaleRowKernel kernel;
+    const uint8_t *src;
+    int srcStep;
+    int srcChannels;
+    uint8_t *dst;
+    int dstStep;
+    int dstChannels;
+    int width;
+    bool rgba;
+};
+
+static void doThreadGruntworkGrayscale(void*threadarg, int startRow, int stopRow, int worker){
+    struct thread_data_grayscale *my_data = (struct thread_data_grayscale *) threadarg;
+    int64_t begin = timingNow();
+
+    for (int y = startRow; y < stopRow; y++) {
+        grayscaleRowWith(my_data->kernel,
+                         my_data->src + y*my_data->srcStep, my_data->srcChannels,
+                         my_data->dst + y*my_data->dstStep, my_data->dstChannels,
+                         my_data->width, my_data->rgba);
+    }
+
+    recordTimingSpan(TIMING_STAGE_KERNEL, worker, begin);
+}
+
+/*
+ * Public functions
+ */
+
+void grayscaleRow(const uint8_t* src, int srcChannels, uint8_t* dst, int dstChannels,
+                  int width, bool rgba){
+    grayscaleRowWith(getFilterKernels()->grayscaleRow, src, srcChannels, dst, dstChannels,
+                     width, rgba);
+}
+
+void grayscaleImage(const uint8_t* src, int srcStep, int srcChannels,
+                    uint8_t* dst, int dstStep, int dstChannels,
+                    int width, int height, bool rgba){
+    struct thread_data_grayscale grayscale_data;
+    //look the kernel up once so a backend switch can't land mid frame
+    grayscale_data.kernel = getFilterKernels()->grayscaleRow;
+    grayscale_data.src = src;
+    grayscale_data.srcStep = srcStep;
+    grayscale_data.srcChannels = srcChannels;
+    grayscale_data.dst = dst;
+    grayscale_data.dstStep = dstStep;
+    grayscale_data.dstChannels = dstChannels;
+    grayscale_data.width = width;
+    grayscale_data.rgba = rgba;
+
+    WorkerPool::GetShared()->ParallelFor(height, doThreadGruntworkGrayscale, (void*)&grayscale_data);
+}
@@ -0,0 +1,38 @@
+//
+//  GrayscaleEngine.h
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#ifndef FaceIt_GrayscaleEngine_h
+#define FaceIt_GrayscaleEngine_h
+
+#include <stdint.h>
+
+/*
+ * Single pass grayscale straight on interleaved 8 bit BGR (or BGRA/RGBA) rows,
+ * instead of splitting into planes, two cvAddWeighted passes and a merge.
+ *
+ * The grey is the one those two passes worked out (weighted towards blue, as
+ * it always has been), done in integers:
+ *   s = round((r+g)/3)
+ *   grey = round((2*s + b)/3)
+ * where round(n/3) is ((n+1)*21846) >> 16, exact for every n that comes up.
+ *
+ * The output is either 1 channel grey or the grey written back over the
+ * colour channels of an image laid out like the source (alpha left as is),
+ * and src and dst can be the same image for the latter.
+ */
+
+//grey a single row of width pixels. srcChannels is 3 or 4, dstChannels is 1
+//or the same as srcChannels. rgba means the source is R,G,B,A in memory
+void grayscaleRow(const uint8_t* src, int srcChannels, uint8_t* dst, int dstChannels,
+                  int width, bool rgba);
+
+//grey a whole image, with the rows shared out across the worker pool
+void grayscaleImage(const uint8_t* src, int srcStep, int srcChannels,
+                    uint8_t* dst, int dstStep, int dstChannels,
+                    int width, int height, bool rgba);
+
+#endif
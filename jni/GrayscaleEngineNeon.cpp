@@ -0,0 +1,57 @@
+//
+//  GrayscaleEngineNeon.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+// Built with -mfpu=neon on armeabi-v7a only (see Android.mk), and only ever
+// reached through FilterBackend once cpufeatures has seen neon on the device.
+
+#include "FilterBackend.h"
+
+#if defined(HAVE_NEON) && defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+//round(n/3) -> ((n+1)*21846) >> 16, for the 8 sums in n
+static inline uint16x8_t vdiv3round_u16(uint16x8_t n){
+    const uint16x4_t third = vdup_n_u16(21846);
+
+    n = vaddq_u16(n, vdupq_n_u16(1));
+    return vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(n), third), 16),
+                        vshrn_n_u32(vmull_u16(vget_high_u16(n), third), 16));
+}
+
+//16 pixels a go, vld3 splits the channels and vst3 writes the grey back over them
+int grayscaleRowNeon(const uint8_t* src, uint8_t* dst, int width, bool rgba, bool replicate){
+    int x = 0;
+    for (; x <= width - 16; x += 16) {
+        uint8x16x3_t pix = vld3q_u8(src);
+        uint8x16_t blu = rgba ? pix.val[2] : pix.val[0];
+        uint8x16_t grn = pix.val[1];
+        uint8x16_t red = rgba ? pix.val[0] : pix.val[2];
+
+        //s = round((r+g)/3)
+        uint16x8_t sLo = vdiv3round_u16(vaddl_u8(vget_low_u8(red), vget_low_u8(grn)));
+        uint16x8_t sHi = vdiv3round_u16(vaddl_u8(vget_high_u8(red), vget_high_u8(grn)));
+
+        //grey = round((2*s + b)/3)
+        sLo = vdiv3round_u16(vaddw_u8(vshlq_n_u16(sLo, 1), vget_low_u8(blu)));
+        sHi = vdiv3round_u16(vaddw_u8(vshlq_n_u16(sHi, 1), vget_high_u8(blu)));
+        uint8x16_t grey = vcombine_u8(vmovn_u16(sLo), vmovn_u16(sHi));
+
+        if (replicate) {
+            pix.val[0] = pix.val[1] = pix.val[2] = grey;
+            vst3q_u8(dst, pix);
+            dst += 48;
+        }else{
+            vst1q_u8(dst, grey);
+            dst += 16;
+        }
+        src += 48;
+    }
+    return x;
+}
+
+#endif
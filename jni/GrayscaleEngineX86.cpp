@@ -0,0 +1,84 @@
+//
+//  GrayscaleEngineX86.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+// Built for its instruction set with a target attribute like SepiaEngineX86.cpp.
+// FilterBackend hands avx2 the ssse3 kernel.
+
+#include "FilterBackend.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+//16 pixels (3 registers) a go, pshufb does the (de)interleaving the same way
+//sepiaToneRowSSSE3 does it
+__attribute__((target("ssse3")))
+int grayscaleRowSSSE3(const uint8_t* src, uint8_t* dst, int width, bool rgba, bool replicate){
+    //gather each channel out of the three loaded registers
+    const __m128i c00 = _mm_setr_epi8( 0, 3, 6, 9,12,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+    const __m128i c01 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1, 2, 5, 8,11,14,-1,-1,-1,-1,-1);
+    const __m128i c02 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 1, 4, 7,10,13);
+    const __m128i c10 = _mm_setr_epi8( 1, 4, 7,10,13,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+    const __m128i c11 = _mm_setr_epi8(-1,-1,-1,-1,-1, 0, 3, 6, 9,12,15,-1,-1,-1,-1,-1);
+    const __m128i c12 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 2, 5, 8,11,14);
+    const __m128i c20 = _mm_setr_epi8( 2, 5, 8,11,14,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+    const __m128i c21 = _mm_setr_epi8(-1,-1,-1,-1,-1, 1, 4, 7,10,13,-1,-1,-1,-1,-1,-1);
+    const __m128i c22 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 3, 6, 9,12,15);
+
+    //grey spread back out 3 times for the colour channels
+    const __m128i spread0 = _mm_setr_epi8( 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    const __m128i spread1 = _mm_setr_epi8( 5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9,10,10);
+    const __m128i spread2 = _mm_setr_epi8(10,11,11,11,12,12,12,13,13,13,14,14,14,15,15,15);
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    //round(n/3) -> ((n+1)*21846) >> 16
+    const __m128i third = _mm_set1_epi16(21846);
+
+    int x = 0;
+    for (; x <= width - 16; x += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(src));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(src+16));
+        __m128i a2 = _mm_loadu_si128((const __m128i*)(src+32));
+
+        __m128i ch0 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, c00), _mm_shuffle_epi8(a1, c01)),
+                                   _mm_shuffle_epi8(a2, c02));
+        __m128i grn = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, c10), _mm_shuffle_epi8(a1, c11)),
+                                   _mm_shuffle_epi8(a2, c12));
+        __m128i ch2 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, c20), _mm_shuffle_epi8(a1, c21)),
+                                   _mm_shuffle_epi8(a2, c22));
+        __m128i blu = rgba ? ch2 : ch0;
+        __m128i red = rgba ? ch0 : ch2;
+
+        //s = round((r+g)/3)
+        __m128i sLo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(red, zero),
+                                                  _mm_unpacklo_epi8(grn, zero)), one);
+        __m128i sHi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(red, zero),
+                                                  _mm_unpackhi_epi8(grn, zero)), one);
+        sLo = _mm_mulhi_epu16(sLo, third);
+        sHi = _mm_mulhi_epu16(sHi, third);
+
+        //grey = round((2*s + b)/3)
+        sLo = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(sLo, sLo), _mm_unpacklo_epi8(blu, zero)), one);
+        sHi = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(sHi, sHi), _mm_unpackhi_epi8(blu, zero)), one);
+        __m128i grey = _mm_packus_epi16(_mm_mulhi_epu16(sLo, third), _mm_mulhi_epu16(sHi, third));
+
+        if (replicate) {
+            _mm_storeu_si128((__m128i*)(dst),    _mm_shuffle_epi8(grey, spread0));
+            _mm_storeu_si128((__m128i*)(dst+16), _mm_shuffle_epi8(grey, spread1));
+            _mm_storeu_si128((__m128i*)(dst+32), _mm_shuffle_epi8(grey, spread2));
+            dst += 48;
+        }else{
+            _mm_storeu_si128((__m128i*)(dst), grey);
+            dst += 16;
+        }
+        src += 48;
+    }
+    return x;
+}
+
+#endif
@@ -0,0 +1,141 @@
+//
+//  ImagePool.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#include "ImagePool.h"
+
+#include <string.h>
+
+///////////////////////////// ImagePool ////////////////////////////////////
+
+ImagePool::ImagePool()
+{
+    pthread_mutex_init(&m_lock, NULL);
+    memset(m_entries, 0, sizeof(m_entries));
+}
+
+
+ImagePool::~ImagePool()
+{
+    for (int i = 0; i < IMAGE_POOL_MAX_IMAGES; i++) {
+        if (m_entries[i].image)
+            cvReleaseImage(&m_entries[i].image);
+    }
+
+    pthread_mutex_destroy(&m_lock);
+}
+
+
+IplImage* ImagePool::Acquire(CvSize size, int depth, int channels)
+{
+    IplImage* image = 0;
+    int empty = -1;
+    int spare = -1;
+
+    pthread_mutex_lock(&m_lock);
+    for (int i = 0; i < IMAGE_POOL_MAX_IMAGES; i++) {
+        struct image_pool_entry* entry = &m_entries[i];
+
+        if (!entry->image) {
+            if (empty < 0)
+                empty = i;
+            continue;
+        }
+
+        if (entry->inUse)
+            continue;
+
+        if (entry->image->width == size.width && entry->image->height == size.height &&
+            entry->image->depth == depth && entry->image->nChannels == channels) {
+            entry->inUse = true;
+            image = entry->image;
+            break;
+        }
+
+        if (spare < 0)
+            spare = i;
+    }
+
+    if (!image) {
+        //no match, make room by dropping a free image of the wrong shape
+        if (empty < 0 && spare >= 0) {
+            cvReleaseImage(&m_entries[spare].image);
+            empty = spare;
+        }
+
+        image = cvCreateImage(size, depth, channels);
+
+        if (empty >= 0) {
+            m_entries[empty].image = image;
+            m_entries[empty].inUse = true;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    //whoever had it last may have tagged it as android RGBA
+    if (channels == 4)
+        memcpy(image->channelSeq, "BGRA", 4);
+
+    return image;
+}
+
+
+void ImagePool::Release(IplImage* image)
+{
+    if (!image)
+        return;
+
+    int empty = -1;
+
+    pthread_mutex_lock(&m_lock);
+    for (int i = 0; i < IMAGE_POOL_MAX_IMAGES; i++) {
+        if (m_entries[i].image == image) {
+            m_entries[i].inUse = false;
+            pthread_mutex_unlock(&m_lock);
+            return;
+        }
+        if (!m_entries[i].image && empty < 0)
+            empty = i;
+    }
+
+    //not one of ours, keep it if there's room
+    if (empty >= 0) {
+        m_entries[empty].image = image;
+        m_entries[empty].inUse = false;
+        image = 0;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (image)
+        cvReleaseImage(&image);
+}
+
+
+IplImage* ImagePool::Detach(IplImage* image)
+{
+    pthread_mutex_lock(&m_lock);
+    for (int i = 0; i < IMAGE_POOL_MAX_IMAGES; i++) {
+        if (m_entries[i].image == image) {
+            m_entries[i].image = 0;
+            m_entries[i].inUse = false;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    return image;
+}
+
+
+void ImagePool::Clear()
+{
+    pthread_mutex_lock(&m_lock);
+    for (int i = 0; i < IMAGE_POOL_MAX_IMAGES; i++) {
+        if (m_entries[i].image && !m_entries[i].inUse)
+            cvReleaseImage(&m_entries[i].image);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
@@ -0,0 +1,52 @@
+//
+//  ImagePool.h
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#ifndef FaceIt_ImagePool_h
+#define FaceIt_ImagePool_h
+
+#include <pthread.h>
+#include "cxcore.h"
+
+//the most images a pool keeps hold of, anything past this is just released
+#define IMAGE_POOL_MAX_IMAGES 32
+
+struct image_pool_entry
+{
+    IplImage*   image;
+    bool        inUse;
+};
+
+/*
+ * Full frame scratch images that get handed back instead of released, so
+ * running the same effects frame after frame stops hitting the allocator
+ * once the pool has warmed up. Images are matched on size, depth and number
+ * of channels. Safe to use from the worker threads.
+ */
+class ImagePool {
+public:
+    ImagePool();
+    ~ImagePool();
+
+    //a free image of this shape, made if the pool has none
+    IplImage*   Acquire(CvSize size, int depth, int channels);
+
+    //give an image back. The pool takes ownership, so this works for images
+    //that never came from Acquire too (they're kept if there's room)
+    void        Release(IplImage* image);
+
+    //take an image out of the pool for good, the caller now owns it
+    IplImage*   Detach(IplImage* image);
+
+    //release every image that isn't in use
+    void        Clear();
+
+protected:
+    pthread_mutex_t m_lock;
+    struct image_pool_entry m_entries[IMAGE_POOL_MAX_IMAGES];
+};
+
+#endif
@@ -14,8 +14,9 @@
 int numberOfFeatures = 0;
 char* pwd = (char*)"";
 #ifdef ANDROID
-//this is only used as a flag for the android device to wait for the NDK
-bool processingFinished = false;
+//the session the entry points without a context handle work on
+static ProcessingContext* defaultContext = 0;
+static pthread_once_t defaultContextOnce = PTHREAD_ONCE_INIT;
 #endif
 
 
@@ -57,366 +58,16 @@ void Log(char* message, bool errorFlag){
     return;
 }
 
-uint8x8_t vdiv3_u8(uint8x8_t in){
-    //widen in
-    uint16x8_t tmp = vmovl_u8(in);
-
-    //q = (n >> 2) + (n >> 4)   ~ q = n * 0.0101 (approx.)
-    uint16x8_t quo = vshrq_n_u16(tmp, 2);
-    quo = vaddq_u16(quo, vshrq_n_u16(tmp, 4));
-    
-    //q = q + (q >> 4)          ~ q = n * 0.01010101
-    quo = vaddq_u16(quo, vshrq_n_u16(quo, 4));
-    //q = q + (q >> 8)          ~ q = n * 0.0101010101010101
-    quo = vaddq_u16(quo, vshrq_n_u16(quo, 8));
-    
-    // r = n - q*3
-    uint16x8_t rem = vsubq_u16(tmp,vmulq_n_u16(quo,3));
-    
-    // return q + (6*r >> 4)
-    tmp = vaddq_u16(quo, vshrq_n_u16(vmulq_n_u16(rem,6),4));
-    
-    //shorten
-    in  = vmovn_u16(tmp);
-    return in;
-}
-
-const int NUMBER_OF_THREADS = 4;
-
-struct thread_data_neon
-{
-    int	thread_id;
-    
-    int image_size;
-    uint8_t *r;
-    uint8_t *g;
-    uint8_t *b;
-};
-
-struct thread_data_neon thread_data_array_neon[NUMBER_OF_THREADS];
-
-
-
-void *doThreadGruntworkNeon(void*threadarg){
-    
-    struct thread_data_neon *my_data;
-    
-    my_data = (struct thread_data_neon *) threadarg;
-    
-    //but do work on your quarter of the image
-    int segment = my_data->image_size/NUMBER_OF_THREADS;
-    int startPoint = my_data->thread_id * segment;
-    int stopPoint = (my_data->thread_id+1) * segment;
-    
-    int n = stopPoint;
-    
-    uint8x8_t rfac = vdup_n_u8 (40);
-    uint8x8_t gfac = vdup_n_u8 (20);
-    uint8x8_t bfac = vdup_n_u8 (20);
-    
-    uint8x8_t imin = vdup_n_u8 (0);
-    uint8x8_t imax = vdup_n_u8 (255);
-        
-    uint8_t *rptr = my_data->r+startPoint;
-    uint8_t *bptr = my_data->b+startPoint;
-    uint8_t *gptr = my_data->g+startPoint;
-    
-    for (int j=startPoint; j<stopPoint; j+=8){
-        //get values for this block
-        uint8x8_t red = vld1_u8(rptr);
-        uint8x8_t grn = vld1_u8(gptr);
-        uint8x8_t blu = vld1_u8(bptr);
-        //intensity vector
-        uint8x8_t ins;
-        
-        //average the channel intensity
-        red = vdiv3_u8(red);
-        grn = vdiv3_u8(grn);
-        blu = vdiv3_u8(blu);
-        
-        //add all channels together
-        ins = vadd_u8(blu,vadd_u8(red,grn));
-        
-        //add sepia weights
-        blu = vqsub_u8(ins, bfac);
-        grn = vqadd_u8(ins, gfac);
-        red = vqadd_u8(ins, rfac);
-        
-        //do boundary checks
-        blu = vmax_u8(blu, imin);
-        red = vmin_u8(red, imax);
-        grn = vmin_u8(grn, imax);
-        
-        //set values for this block
-        vst1_u8(rptr, red);
-        vst1_u8(gptr, grn);
-        vst1_u8(bptr, blu);
-        
-        rptr+=8;
-        bptr+=8;
-        gptr+=8;
-    }
-
-    
-    pthread_exit(NULL);
-}
-
-void applySepiaToneWithDirectPixelManipulationsAndNeonSSEAndPthreadsForSMP(IplImage* target){
-    
-    //allocate vectors
-    uint8_t *b = new uint8_t[target->height*target->width];
-    uint8_t *g = new uint8_t[target->height*target->width];
-    uint8_t *r = new uint8_t[target->height*target->width];
-    
-    
-    //collect image pixels into vectors
-    int i=0; //pixel Position
-    for( int y=0; y<target->height; y++ ){
-        uchar* ptr = (uchar*) (
-                               target->imageData + y * target->widthStep
-                               );
-        
-        for( int x=0; x<target->width; x++ ) {
-            b[i] = ptr[3*x+0];
-            g[i] = ptr[3*x+1];
-            r[i] = ptr[3*x+2];
-            
-            i++;
-        }
-    }
-    
-    
-#ifdef TIMEIT
-    //on the clock
-    clock_t begin, end;
-    double time_spent;
-    //gettimeofday()
-    begin = clock();
-#endif
-    
-    
-    //partition the toning into 4 threads
-    pthread_t threads[NUMBER_OF_THREADS];
-    int rc;
-    for (int t = 0; t < NUMBER_OF_THREADS; t ++) {
-        //load up resources for this thread
-        thread_data_array_neon[t].thread_id = t;
-        thread_data_array_neon[t].r = r;
-        thread_data_array_neon[t].g = g;
-        thread_data_array_neon[t].b = b;
-        thread_data_array_neon[t].image_size = target->width*target->height;
-        
-        rc = pthread_create(&threads[t], NULL, doThreadGruntworkNeon, (void *)
-                            &thread_data_array_neon[t]);
-        if (rc) {
-            LOGE("ERROR -> pthread_create() the thread was not born");
-        }
-    }
-    
-    //syncronise
-    if(pthread_join(*threads,NULL)){
-        LOGE("ERROR -> pthread_join() the threads weren't stuck back together");
-    }
-
-    
-    
-#ifdef TIMEIT
-    //off the clock
-    end = clock();
-    time_spent = (double)(end - begin) / CLOCKS_PER_SEC;
-    
-    //print the time taken
-    char my_string[22];
-    sprintf(my_string,"%18.4f",time_spent);
-    LOGE("****************************************");
-    LOGE("Time taken to compute Sepia Tone values:");
-    LOGE(my_string);
-    LOGE("****************************************");
-    //saving global timeStamp to return
-    timeStamp = time_spent;
-    
-#endif
-    
-    //write image pixels back from vectors
-    i=0; //pixel Position
-    for( int y=0; y<target->height; y++ ){
-        uchar* ptr = (uchar*) (
-                               target->imageData + y * target->widthStep
-                               );
-        
-        for( int x=0; x<target->width; x++ ) {
-            ptr[3*x+0] = b[i];
-            ptr[3*x+1] = g[i];
-            ptr[3*x+2] = r[i];
-            
-            i++;
-        }
-    }
-    
-    delete b;
-    delete g;
-    delete r;
-    
-}
-
-
-void applySepiaToneWithDirectPixelManipulationsAndNeonSSE(IplImage* target){
-    
-    //allocate vectors
-    uint8_t *b = new uint8_t[target->height*target->width];
-    uint8_t *g = new uint8_t[target->height*target->width];
-    uint8_t *r = new uint8_t[target->height*target->width];
-    
-    uint8_t* rptr = r;
-    uint8_t* bptr = b;
-    uint8_t* gptr = g;
-    
-    //collect image pixels into vectors
-    int i=0; //pixel Position
-    for( int y=0; y<target->height; y++ ){
-        uchar* ptr = (uchar*) (
-                               target->imageData + y * target->widthStep
-                               );
-        
-        for( int x=0; x<target->width; x++ ) {
-            b[i] = ptr[3*x+0];
-            g[i] = ptr[3*x+1];
-            r[i] = ptr[3*x+2];
-            
-            i++;
-        }
-    }
-    
-    
-#ifdef TIMEIT
-    //on the clock
-    clock_t begin, end;
-    double time_spent;
-    //gettimeofday()
-    begin = clock();
-#endif
-    
-    int n = target->width*target->height;
-
-    uint8x8_t rfac = vdup_n_u8 (40);
-    uint8x8_t gfac = vdup_n_u8 (20);
-    uint8x8_t bfac = vdup_n_u8 (20);
-    
-    uint8x8_t imin = vdup_n_u8 (0);
-    uint8x8_t imax = vdup_n_u8 (255);
-    
-    n/=8;
-    
-    for (int j=0; j<n; j++){
-        //get values for this block
-        uint8x8_t red = vld1_u8(rptr);
-        uint8x8_t grn = vld1_u8(gptr);
-        uint8x8_t blu = vld1_u8(bptr);
-        //intensity vector
-        uint8x8_t ins;
-        
-        //average the channel intensity
-        red = vdiv3_u8(red);
-        grn = vdiv3_u8(grn);
-        blu = vdiv3_u8(blu);
-        
-        //add all channels together
-        ins = vadd_u8(blu,vadd_u8(red,grn));
-        
-        //add sepia weights
-        blu = vqsub_u8(ins, bfac);
-        grn = vqadd_u8(ins, gfac);
-        red = vqadd_u8(ins, rfac);
-        
-        //do boundary checks
-        blu = vmax_u8(blu, imin);
-        red = vmin_u8(red, imax);
-        grn = vmin_u8(grn, imax);
-        
-        //set values for this block
-        vst1_u8(rptr, red);
-        vst1_u8(gptr, grn);
-        vst1_u8(bptr, blu);
-        
-        rptr+=8;
-        bptr+=8;
-        gptr+=8;
-    }
-    
-#ifdef TIMEIT
-    //off the clock
-    end = clock();
-    time_spent = (double)(end - begin) / CLOCKS_PER_SEC;
-    
-    //print the time taken
-    char my_string[22];
-    sprintf(my_string,"%18.4f",time_spent);
-    LOGE("****************************************");
-    LOGE("Time taken to compute Sepia Tone values:");
-    LOGE(my_string);
-    LOGE("****************************************");
-    
-    //saving global timeStamp to return
-    timeStamp = time_spent;
-    
-#endif
-    
-    //write image pixels back from vectors
-    i=0; //pixel Position
-    for( int y=0; y<target->height; y++ ){
-        uchar* ptr = (uchar*) (
-                               target->imageData + y * target->widthStep
-                               );
-        
-        for( int x=0; x<target->width; x++ ) {
-            ptr[3*x+0] = b[i];
-            ptr[3*x+1] = g[i];
-            ptr[3*x+2] = r[i];
-            
-            i++;
-        }
-    }
-    
-    delete b;
-    delete g;
-    delete r;
-    
-}
-
-struct thread_data_ne10
-{
-    int	thread_id;
-    
-    int image_size;
-    float *r;
-    float *g;
-    float *b;
-};
-
-struct thread_data_ne10 thread_data_ne10_array[NUMBER_OF_THREADS];
-
-
-void *doThreadGruntworkWithNe10(void*threadarg){
-    struct thread_data_ne10 *my_data;
+//tone count pixels of the planar float vectors with Ne10, any length
+void sepiaTonePlanesWithNe10(float *r, float *g, float *b, int count){
     
-    my_data = (struct thread_data_ne10 *) threadarg;
-    
-    //but do work on your quarter of the image
-    int segment = my_data->image_size/NUMBER_OF_THREADS;
-    int startPoint = my_data->thread_id * segment;
-    int stopPoint = (my_data->thread_id+1) * segment;
-
-    //assign the local float point with the same memory as the global,
-    //but using our thread specific offset (startpoint)
-    float *r = my_data->r+startPoint;
-    float *g = my_data->g+startPoint;
-    float *b = my_data->b+startPoint;
-    
-    int size = 8;
-    float* tmp = new float[size];
+    float tmp[8];
     
     //to avoid throttling cache operate on smaller partiotions of the vectors
-    for (int i = 0 ; i < segment; i += size) {
+    for (int i = 0 ; i < count; i += 8) {
+        
+        //the last block is however many pixels are left (Ne10 takes any count)
+        int size = MIN(8, count - i);
         
         add_float_c(tmp, b+i, g+i, size);
         add_float_c(b+i, tmp, r+i, size);
@@ -445,19 +96,49 @@ void *doThreadGruntworkWithNe10(void*threadarg){
             r[pos] = MIN(r[pos],255);
         }
     }
-    delete tmp;
+}
+
+struct thread_data_ne10
+{
+    int width;
+    float *r;
+    float *g;
+    float *b;
+};
 
-    pthread_exit(NULL);
+
+//start and stop are rows, handed out evenly by the worker pool
+void doThreadGruntworkWithNe10(void*threadarg, int startRow, int stopRow, int worker){
+    struct thread_data_ne10 *my_data;
+    
+    my_data = (struct thread_data_ne10 *) threadarg;
+    int64_t begin = timingNow();
+    
+    //but do work on your share of the image
+    int startPoint = startRow * my_data->width;
+    int segment = (stopRow - startRow) * my_data->width;
+
+    //assign the local float point with the same memory as the global,
+    //but using our thread specific offset (startpoint)
+    sepiaTonePlanesWithNe10(my_data->r+startPoint,
+                            my_data->g+startPoint,
+                            my_data->b+startPoint,
+                            segment);
+    
+    recordTimingSpan(TIMING_STAGE_KERNEL, worker, begin);
 }
 
 
 
-void applySepiaToneWithDirectPixelManipulationsAndNe10AndPthreadsForSMP(IplImage* target){
+float applySepiaToneWithDirectPixelManipulationsAndNe10AndPthreadsForSMP(IplImage* target){
+    float elapsed = 0;
     //allocate vectors
     float *b = new float[target->height*target->width];
     float *g = new float[target->height*target->width];
     float *r = new float[target->height*target->width];
     
+    int64_t begin = timingNow();
+    
     //collect image pixels into vectors
     int i=0; //pixel Position
     for( int y=0; y<target->height; y++ ){
@@ -474,54 +155,24 @@ void applySepiaToneWithDirectPixelManipulationsAndNe10AndPthreadsForSMP(IplImage
         }
     }
     
-#ifdef TIMEIT
     //on the clock
-    clock_t begin, end;
-    double time_spent;
-    
-    begin = clock();
-#endif
+    begin = recordTimingSpan(TIMING_STAGE_UNPACK, TIMING_CALLING_THREAD, begin);
     
-    //partition the toning into 4 threads
-    pthread_t threads[NUMBER_OF_THREADS];
-    int rc;
-    for (int t = 0; t < NUMBER_OF_THREADS; t ++) {
-        //load up resources for this thread
-        thread_data_ne10_array[t].thread_id = t;
-        thread_data_ne10_array[t].r = r;
-        thread_data_ne10_array[t].g = g;
-        thread_data_ne10_array[t].b = b;
-        thread_data_ne10_array[t].image_size = target->width*target->height;
-        
-        rc = pthread_create(&threads[t], NULL, doThreadGruntworkWithNe10, (void *)
-                            &thread_data_ne10_array[t]);
-        if (rc) {
-            LOGE("ERROR -> pthread_create() the thread was not born");
-        }
-    }
+    //partition the toning across the worker pool (in whole rows)
+    struct thread_data_ne10 sepia_data;
+    sepia_data.r = r;
+    sepia_data.g = g;
+    sepia_data.b = b;
+    sepia_data.width = target->width;
     
-    //syncronise
-    if(pthread_join(*threads,NULL)){
-        LOGE("ERROR -> pthread_join() the threads weren't stuck back together");
-    }
+    //returns once every worker is done, so the write back can't race them
+    WorkerPool::GetShared()->ParallelFor(target->height,
+                                         doThreadGruntworkWithNe10,
+                                         (void*)&sepia_data);
     
-#ifdef TIMEIT
     //off the clock
-    end = clock();
-    time_spent = (double)(end - begin) / CLOCKS_PER_SEC;
-    
-    //print the time taken
-    char my_string[22];
-    sprintf(my_string,"%18.4f",time_spent);
-    LOGE("****************************************");
-    LOGE("Time taken to compute Sepia Tone values:");
-    LOGE(my_string);
-    LOGE("****************************************");
-    
-    //saving global timeStamp to return
-    timeStamp = time_spent;
-    
-#endif
+    int64_t end = recordTimingSpan(TIMING_STAGE_KERNEL, TIMING_CALLING_THREAD, begin);
+    elapsed = timingSeconds(begin, end);
     
     //write image pixels back from vectors
     i=0; //pixel Position
@@ -538,15 +189,29 @@ void applySepiaToneWithDirectPixelManipulationsAndNe10AndPthreadsForSMP(IplImage
             i++;
         }
     }
-
+    
+    recordTimingSpan(TIMING_STAGE_REPACK, TIMING_CALLING_THREAD, end);
+    
+#ifdef TIMEIT
+    logTimeTaken("compute Sepia Tone values", elapsed);
+#endif
+    
+    delete[] b;
+    delete[] g;
+    delete[] r;
+    
+    return elapsed;
 }
 
-void applySepiaToneWithDirectPixelManipulationsAndNe10(IplImage* target){
+float applySepiaToneWithDirectPixelManipulationsAndNe10(IplImage* target){
+    float elapsed = 0;
     //allocate vectors (using floats to play nice with NEON)
     float *b = new float[target->height*target->width];
     float *g = new float[target->height*target->width];
     float *r = new float[target->height*target->width];
     
+    int64_t begin = timingNow();
+    
     //collect image pixels into vectors
     int i=0; //pixel Position
     for( int y=0; y<target->height; y++ ){
@@ -564,13 +229,8 @@ void applySepiaToneWithDirectPixelManipulationsAndNe10(IplImage* target){
     }
     
     
-#ifdef TIMEIT
     //on the clock
-    clock_t begin, end;
-    double time_spent;
-    
-    begin = clock();
-#endif
+    begin = recordTimingSpan(TIMING_STAGE_UNPACK, TIMING_CALLING_THREAD, begin);
     
     /*
      *before
@@ -666,61 +326,12 @@ void applySepiaToneWithDirectPixelManipulationsAndNe10(IplImage* target){
      *after
      */
     
-    int totSize = target->width*target->height;
-    
-    int size = 8;
-    
-    float* tmp = new float[size];
-    
-    //to avoid throttling cache operate on smaller partiotions of the vectors
-    for (int i = 0 ; i < totSize; i += size) {
-        
-        add_float_c(tmp, b+i, g+i, size);
-        add_float_c(b+i, tmp, r+i, size);
-        //divc_float_c(tmp, b+i, 3, size);
-        mulc_float_c(tmp, b+i, 0.3f, size);
-        
-        //set the other 2 vectors with the same greyscale value... da-doi
-        //b = tmp;
-        memcpy(b+i, tmp, sizeof(float) * size);
-        
-        //g = b;
-        memcpy(g+i, tmp, sizeof(float) * size);
-        
-        //r = b;
-        memcpy(r+i, tmp, sizeof(float) * size);
-        
-        subc_float_c(b+i, b+i, 20.0f, size);
-        addc_float_c(g+i, g+i, 20.0f, size);
-        addc_float_c(r+i, r+i, 40.0f, size);
-
-        
-        for (int j = 0; j < size; j++) {
-            int pos = i+j;
-            b[pos] = MAX(b[pos],0);
-            g[pos] = MIN(g[pos],255);
-            r[pos] = MIN(r[pos],255);
-        }
-    }
+    sepiaTonePlanesWithNe10(r, g, b, target->width*target->height);
         
             
-#ifdef TIMEIT
     //off the clock
-    end = clock();
-    time_spent = (double)(end - begin) / CLOCKS_PER_SEC;
-    
-    //print the time taken
-    char my_string[22];
-    sprintf(my_string,"%18.4f",time_spent);
-    LOGE("****************************************");
-    LOGE("Time taken to compute Sepia Tone values:");
-    LOGE(my_string);
-    LOGE("****************************************");
-    
-    //saving global timeStamp to return
-    timeStamp = time_spent;
-    
-#endif
+    int64_t end = recordTimingSpan(TIMING_STAGE_KERNEL, TIMING_CALLING_THREAD, begin);
+    elapsed = timingSeconds(begin, end);
     
     //write image pixels back from vectors
     i=0; //pixel Position
@@ -737,34 +348,39 @@ void applySepiaToneWithDirectPixelManipulationsAndNe10(IplImage* target){
             i++;
         }
     }
-
+    
+    recordTimingSpan(TIMING_STAGE_REPACK, TIMING_CALLING_THREAD, end);
+    
+#ifdef TIMEIT
+    logTimeTaken("compute Sepia Tone values", elapsed);
+#endif
+    
+    delete[] b;
+    delete[] g;
+    delete[] r;
+    
+    return elapsed;
 }
 
 
 struct thread_data
 {
-    int	thread_id;
-    
     int image_size;
     int *r;
     int *g;
     int *b;
 };
 
-struct thread_data thread_data_array[NUMBER_OF_THREADS];
-
 
 
-void *doThreadGruntwork(void*threadarg){
+void doThreadGruntwork(void*threadarg, int startPoint, int stopPoint, int worker){
     
     struct thread_data *my_data;
     
     my_data = (struct thread_data *) threadarg;
     
-    //but do work on your quarter of the image
-    int segment = my_data->image_size/NUMBER_OF_THREADS;
-    int startPoint = my_data->thread_id * segment;
-    int stopPoint = (my_data->thread_id+1) * segment;
+    //each worker's share gets a span of its own, to see how even the split is
+    int64_t begin = timingNow();
     
     /*
      *before
@@ -811,18 +427,21 @@ void *doThreadGruntwork(void*threadarg){
         my_data->r[i] = MIN(my_data->r[i],255);
     }
     
-    pthread_exit(NULL);
+    recordTimingSpan(TIMING_STAGE_KERNEL, worker, begin);
 }
 
 
 
 
-void applySepiaToneWithDirectPixelManipulationsAndPthreadsForSMP(IplImage* target){
+float applySepiaToneWithDirectPixelManipulationsAndPthreadsForSMP(IplImage* target){
+    float elapsed = 0;
     //allocate vectors
     int *b = new int[target->height*target->width];
     int *g = new int[target->height*target->width];
     int *r = new int[target->height*target->width];
     
+    int64_t begin = timingNow();
+    
     //collect image pixels into vectors
     int i=0; //pixel Position
     for( int y=0; y<target->height; y++ ){
@@ -839,54 +458,24 @@ void applySepiaToneWithDirectPixelManipulationsAndPthreadsForSMP(IplImage* targe
         }
     }
     
-    #ifdef TIMEIT
-        //on the clock
-        clock_t begin, end;
-        double time_spent;
-        
-        begin = clock();
-    #endif
-    
-    //partition the toning into 4 threads
-    pthread_t threads[NUMBER_OF_THREADS];
-    int rc;
-    for (int t = 0; t < NUMBER_OF_THREADS; t ++) {
-        //load up resources for this thread
-        thread_data_array[t].thread_id = t;
-        thread_data_array[t].r = r;
-        thread_data_array[t].g = g;
-        thread_data_array[t].b = b;
-        thread_data_array[t].image_size = target->width*target->height;
-        
-        rc = pthread_create(&threads[t], NULL, doThreadGruntwork, (void *)
-                            &thread_data_array[t]);
-        if (rc) {
-            LOGE("ERROR -> pthread_create() the thread was not born");
-        }
-    }
+    //on the clock
+    begin = recordTimingSpan(TIMING_STAGE_UNPACK, TIMING_CALLING_THREAD, begin);
     
-    //syncronise
-    if(pthread_join(*threads,NULL)){
-        LOGE("ERROR -> pthread_join() the threads weren't stuck back together");
-    }
+    //partition the toning across the worker pool
+    struct thread_data sepia_data;
+    sepia_data.r = r;
+    sepia_data.g = g;
+    sepia_data.b = b;
+    sepia_data.image_size = target->width*target->height;
     
-    #ifdef TIMEIT
-        //off the clock
-        end = clock();
-        time_spent = (double)(end - begin) / CLOCKS_PER_SEC;
-        
-        //print the time taken
-        char my_string[22];
-        sprintf(my_string,"%18.4f",time_spent);
-        LOGE("****************************************");
-        LOGE("Time taken to compute Sepia Tone values:");
-        LOGE(my_string);
-        LOGE("****************************************");
-
-        //saving global timeStamp to return
-        timeStamp = time_spent;
+    //returns once every worker is done, so the write back can't race them
+    WorkerPool::GetShared()->ParallelFor(sepia_data.image_size,
+                                         doThreadGruntwork,
+                                         (void*)&sepia_data);
     
-    #endif
+    //off the clock
+    int64_t end = recordTimingSpan(TIMING_STAGE_KERNEL, TIMING_CALLING_THREAD, begin);
+    elapsed = timingSeconds(begin, end);
     
     //write image pixels back from vectors
     i=0; //pixel Position
@@ -903,15 +492,26 @@ void applySepiaToneWithDirectPixelManipulationsAndPthreadsForSMP(IplImage* targe
             i++;
         }
     }
+    
+    recordTimingSpan(TIMING_STAGE_REPACK, TIMING_CALLING_THREAD, end);
+    
+#ifdef TIMEIT
+    logTimeTaken("compute Sepia Tone values", elapsed);
+#endif
+    
+    return elapsed;
 }
 
-void applySepiaToneWithDirectPixelManipulations(IplImage* target){
+float applySepiaToneWithDirectPixelManipulations(IplImage* target){
+    float elapsed = 0;
 
     //allocate vectors
     int *b = new int[target->height*target->width];
     int *g = new int[target->height*target->width];
     int *r = new int[target->height*target->width];
     
+    int64_t begin = timingNow();
+    
     //collect image pixels into vectors
     int i=0; //pixel Position
     for( int y=0; y<target->height; y++ ){
@@ -929,13 +529,8 @@ void applySepiaToneWithDirectPixelManipulations(IplImage* target){
     }
     
     
-#ifdef TIMEIT
     //on the clock
-    clock_t begin, end;
-    double time_spent;
-    //gettimeofday()
-    begin = clock();
-#endif
+    begin = recordTimingSpan(TIMING_STAGE_UNPACK, TIMING_CALLING_THREAD, begin);
     
     //do sepia processing
     
@@ -982,23 +577,9 @@ void applySepiaToneWithDirectPixelManipulations(IplImage* target){
         
     }
     
-#ifdef TIMEIT
     //off the clock
-    end = clock();
-    time_spent = (double)(end - begin) / CLOCKS_PER_SEC;
-    
-    //print the time taken
-    char my_string[22];
-    sprintf(my_string,"%18.4f",time_spent);
-    LOGE("****************************************");
-    LOGE("Time taken to compute Sepia Tone values:");
-    LOGE(my_string);
-    LOGE("****************************************");
-    
-    //saving global timeStamp to return
-    timeStamp = time_spent;
-    
-#endif
+    int64_t end = recordTimingSpan(TIMING_STAGE_KERNEL, TIMING_CALLING_THREAD, begin);
+    elapsed = timingSeconds(begin, end);
     
     //write image pixels back from vectors
     i=0; //pixel Position
@@ -1015,18 +596,61 @@ void applySepiaToneWithDirectPixelManipulations(IplImage* target){
             i++;
         }
     }
+    
+    recordTimingSpan(TIMING_STAGE_REPACK, TIMING_CALLING_THREAD, end);
+    
+#ifdef TIMEIT
+    logTimeTaken("compute Sepia Tone values", elapsed);
+#endif
+    
+    return elapsed;
+}
+
+
+//true if a 4 channel image holds android Bitmap pixels (R,G,B,A in memory)
+//rather than the BGRA opencv would normally use, see lockBitmapAsImage
+bool isRGBAImage(IplImage* image){
+    return image->nChannels == 4 && strncmp(image->channelSeq, "RGBA", 4) == 0;
+}
+
+//single pass over the interleaved rows, no planar copies (see SepiaEngine.h)
+float applySepiaToneFused(IplImage* target){
+    float elapsed = 0;
+    
+    if (target->depth != IPL_DEPTH_8U ||
+        (target->nChannels != 3 && target->nChannels != 4)) {
+        LOGE("ERROR -> applySepiaToneFused() expects an 8 bit BGR or RGBA image");
+        return applySepiaTone(target);
+    }
+    
+    //on the clock
+    int64_t begin = timingNow();
+    
+    if (target->nChannels == 4) {
+        sepiaToneImage4((uint8_t*)target->imageData, target->widthStep,
+                        target->width, target->height, isRGBAImage(target));
+    }else{
+        sepiaToneImage((uint8_t*)target->imageData, target->widthStep,
+                       target->width, target->height);
+    }
+    
+    //off the clock
+    int64_t end = recordTimingSpan(TIMING_STAGE_KERNEL, TIMING_CALLING_THREAD, begin);
+    elapsed = timingSeconds(begin, end);
+    
+#ifdef TIMEIT
+    logTimeTaken("compute Sepia Tone values", elapsed);
+#endif
+    
+    return elapsed;
 }
 
 
-void applySepiaTone(IplImage* target){
+float applySepiaTone(IplImage* target){
+    float elapsed = 0;
     
-    #ifdef TIMEIT
-        //on the clock
-        clock_t begin, end;
-        double time_spent;
-        
-        begin = clock();
-    #endif
+    //on the clock
+    int64_t begin = timingNow();
     
     for (int ix=0; ix<target->width; ix++) {
         for (int iy=0; iy<target->height; iy++) {
@@ -1048,22 +672,15 @@ void applySepiaTone(IplImage* target){
         }
     }
     
-    #ifdef TIMEIT
-        //off the clock
-        end = clock();
-        time_spent = (double)(end - begin) / CLOCKS_PER_SEC;
-        
-        //print the time taken
-        char my_string[22];
-        sprintf(my_string,"%18.4f",time_spent);
-        LOGE("****************************************");
-        LOGE("Time taken to compute Sepia Tone values:");
-        LOGE(my_string);
-        LOGE("****************************************");
-        
-        //saving global timeStamp to return
-        timeStamp = time_spent;
-    #endif
+    //off the clock
+    int64_t end = recordTimingSpan(TIMING_STAGE_KERNEL, TIMING_CALLING_THREAD, begin);
+    elapsed = timingSeconds(begin, end);
+    
+#ifdef TIMEIT
+    logTimeTaken("compute Sepia Tone values", elapsed);
+#endif
+    
+    return elapsed;
 }
 
 void overlayImage(IplImage* target, IplImage* source, int x, int y) {
@@ -1121,6 +738,216 @@ IplImage* drawRectangleOnImageWithColourAndFilled(CvRect featureRect, IplImage*i
  * End of public feature detection functions
  */
 
+
+/*
+ * Effects, these all take 8 bit images with 3 (BGR) or 4 (BGRA, or RGBA when
+ * isRGBAImage) channels so java's pixels can be worked on where they are
+ */
+
+//mirror the left half onto the right then erode and dilate, in place.
+//Both are single passes shared out across the worker pool, see FunhouseEngine.h
+void applyFunhouse(IplImage* frame){
+    
+    bool erode = true;
+	bool dilate = true;
+	bool mirror = true;
+    
+    if(mirror)
+        mirrorImage((uint8_t*)frame->imageData, frame->widthStep, frame->width, frame->height, frame->nChannels);
+    
+    if(erode || dilate)
+        erodeDilateImage((uint8_t*)frame->imageData, frame->widthStep, frame->width, frame->height,
+                         frame->nChannels, erode ? FUNHOUSE_ERODE_RADIUS : 0, dilate ? FUNHOUSE_DILATE_RADIUS : 0);
+}
+
+//colour dodge of the inverted image over a blurred copy, the result goes in
+//gray (8 bit, 1 channel, same size as img) and img is left alone. Grey,
+//blur and dodge all happen in one pass, see SketchEngine.h
+void applySketchbook(IplImage* img, IplImage* gray){
+    
+    if (img->depth != IPL_DEPTH_8U || (img->nChannels != 3 && img->nChannels != 4)) {
+        LOGE("ERROR -> applySketchbook() expects an 8 bit BGR or RGBA image");
+        return;
+    }
+    
+    sketchImage((uint8_t*)img->imageData, img->widthStep, img->nChannels,
+                (uint8_t*)gray->imageData, gray->widthStep, 1,
+                img->width, img->height, isRGBAImage(img));
+}
+
+//grey (weighted towards blue, as it always has been) written back into every
+//colour channel, alpha is left alone. One pass, see GrayscaleEngine.h
+void applyGrayscale(IplImage* target){
+    
+    if (target->depth != IPL_DEPTH_8U || (target->nChannels != 3 && target->nChannels != 4)) {
+        LOGE("ERROR -> applyGrayscale() expects an 8 bit BGR or RGBA image");
+        return;
+    }
+    
+    grayscaleImage((uint8_t*)target->imageData, target->widthStep, target->nChannels,
+                   (uint8_t*)target->imageData, target->widthStep, target->nChannels,
+                   target->width, target->height, isRGBAImage(target));
+}
+
+//neon edges over a darkened grey copy of source, written to target (8 bit BGR,
+//same size as source). sourceGrey is a 1 channel scratch image, inner and
+//outer are the NEONISING_COLOURS of the strongest and faintest edges
+void applyNeonisingWithScratch(IplImage* source, IplImage* target, IplImage* sourceGrey,
+                               int inner, int outer){
+    
+    if (source->depth != IPL_DEPTH_8U || (source->nChannels != 3 && source->nChannels != 4) ||
+        target->nChannels != 3) {
+        LOGE("ERROR -> applyNeonisingWithScratch() expects an 8 bit image with 3 or 4 channels and a BGR target");
+        return;
+    }
+    
+    neonisingImage((uint8_t*)source->imageData, source->widthStep, source->nChannels,
+                   (uint8_t*)sourceGrey->imageData, sourceGrey->widthStep,
+                   (uint8_t*)target->imageData, target->widthStep,
+                   source->width, source->height, isRGBAImage(source), inner, outer);
+}
+
+
+//run one of the EFFECT_* effects on an image that has to stay where it is,
+//sketchbook's grey result is spread back over the colour channels
+bool applyEffectInPlace(IplImage* image, int effect){
+    
+    if (image->depth != IPL_DEPTH_8U || (image->nChannels != 3 && image->nChannels != 4)) {
+        LOGE("ERROR -> applyEffectInPlace() expects an 8 bit image with 3 or 4 channels");
+        return false;
+    }
+    
+    switch (effect) {
+        case EFFECT_SEPIA:
+            applySepiaToneFused(image);
+            return true;
+            
+        case EFFECT_GRAYSCALE:
+            applyGrayscale(image);
+            return true;
+            
+        case EFFECT_SKETCHBOOK: {
+            IplImage* gray = cvCreateImage(cvGetSize(image), IPL_DEPTH_8U, 1);
+            applySketchbook(image, gray);
+            if (image->nChannels == 4) {
+                //keep the alpha channel as it was
+                IplImage* a = cvCreateImage(cvGetSize(image), IPL_DEPTH_8U, 1);
+                cvSplit(image, 0, 0, 0, a);
+                cvMerge(gray, gray, gray, a, image);
+                cvReleaseImage(&a);
+            }else{
+                cvCvtColor(gray, image, CV_GRAY2BGR);
+            }
+            cvReleaseImage(&gray);
+            return true;
+        }
+            
+        case EFFECT_FUNHOUSE:
+            applyFunhouse(image);
+            return true;
+            
+        default:
+            LOGE("ERROR -> applyEffectInPlace() doesn't know that effect");
+            return false;
+    }
+}
+
+
+/*
+ * The effects as filter graph nodes (see FilterGraph.h), every node keeps
+ * the frame in the layout it came in except neonising, which always leaves
+ * 8 bit BGR behind
+ */
+
+static void grayscaleRowNode(IplImage* image, uint8_t* row, void* params){
+    grayscaleRow(row, image->nChannels, row, image->nChannels, image->width, isRGBAImage(image));
+}
+
+static void sepiaToneRowNode(IplImage* image, uint8_t* row, void* params){
+    if (image->nChannels == 4)
+        sepiaToneRow4(row, image->width, isRGBAImage(image));
+    else
+        sepiaToneRow(row, image->width);
+}
+
+static void mirrorRowNode(IplImage* image, uint8_t* row, void* params){
+    mirrorRow(row, image->width, image->nChannels);
+}
+
+static void erodeDilateImageNode(IplImage* src, IplImage* dst, FilterGraph* graph, void* params){
+    if (src != dst)
+        cvCopy(src, dst);
+    
+    erodeDilateImage((uint8_t*)dst->imageData, dst->widthStep, dst->width, dst->height,
+                     dst->nChannels, FUNHOUSE_ERODE_RADIUS, FUNHOUSE_DILATE_RADIUS);
+}
+
+static void sketchbookImageNode(IplImage* src, IplImage* dst, FilterGraph* graph, void* params){
+    ImagePool* pool = graph->GetPool();
+    IplImage* gray = pool->Acquire(cvGetSize(src), IPL_DEPTH_8U, 1);
+    
+    //the sketch reads the rows around the one it writes, so it can't go
+    //straight back over the frame
+    applySketchbook(src, gray);
+    
+    if (dst->nChannels == 4) {
+        //keep the alpha channel as it was
+        IplImage* a = pool->Acquire(cvGetSize(src), IPL_DEPTH_8U, 1);
+        cvSplit(dst, 0, 0, 0, a);
+        cvMerge(gray, gray, gray, a, dst);
+        pool->Release(a);
+    }else{
+        cvCvtColor(gray, dst, CV_GRAY2BGR);
+    }
+    
+    pool->Release(gray);
+}
+
+//params holds the two neon colours, inner*NEONISING_COLOURS + outer, picked
+//once when the node is added so they don't flicker from frame to frame
+static void neonisingImageNode(IplImage* src, IplImage* dst, FilterGraph* graph, void* params){
+    ImagePool* pool = graph->GetPool();
+    IplImage* sourceGrey = pool->Acquire(cvGetSize(src), IPL_DEPTH_8U, 1);
+    int colours = (int)(intptr_t)params;
+    
+    applyNeonisingWithScratch(src, dst, sourceGrey, colours / NEONISING_COLOURS, colours % NEONISING_COLOURS);
+    
+    pool->Release(sourceGrey);
+}
+
+//append the nodes for one of the EFFECT_* effects, false if there's no such
+//effect or the graph is full
+bool addEffectToGraph(FilterGraph* graph, int effect){
+    switch (effect) {
+        case EFFECT_SEPIA:
+            return graph->AddRowNode("sepia", sepiaToneRowNode, 0);
+            
+        case EFFECT_GRAYSCALE:
+            return graph->AddRowNode("grayscale", grayscaleRowNode, 0);
+            
+        case EFFECT_SKETCHBOOK:
+            //7x7 gaussian
+            return graph->AddImageNode("sketchbook", sketchbookImageNode, 0, 0, 3);
+            
+        case EFFECT_FUNHOUSE:
+            //two 3x3 erosions then one 3x3 dilation, in one pass
+            return graph->AddRowNode("mirror", mirrorRowNode, 0) &&
+                   graph->AddImageNode("erode+dilate", erodeDilateImageNode, 0, 0,
+                                       FUNHOUSE_ERODE_RADIUS + FUNHOUSE_DILATE_RADIUS);
+            
+        case EFFECT_NEONISE: {
+            //the histogram needs the lot
+            int colours = (rand() % NEONISING_COLOURS)*NEONISING_COLOURS + rand() % NEONISING_COLOURS;
+            return graph->AddImageNode("neonising", neonisingImageNode, (void*)(intptr_t)colours, 3,
+                                       FILTER_NODE_WHOLE_FRAME);
+        }
+            
+        default:
+            LOGE("ERROR -> addEffectToGraph() doesn't know that effect");
+            return false;
+    }
+}
+
 #ifndef ANDROID
 void setWorkingDir(char* wd){
     pwd = wd;
@@ -1131,50 +958,155 @@ void setWorkingDir(char* wd){
  * Now for android stuff
  */
 #ifdef ANDROID
-JNIEXPORT
-jboolean
-JNICALL
-Java_org_openparallel_imagethresh_ImageThreshActivity_doChainOfImageProcessingOperations(JNIEnv* env,
-                                                                                        jobject thiz){
-    processingFinished = false;
+static void createDefaultContext(){
+    defaultContext = new ProcessingContext();
+}
+
+static ProcessingContext* getDefaultContext(){
+    pthread_once(&defaultContextOnce, createDefaultContext);
+    return defaultContext;
+}
+
+//run the context's filter chain over its source image
+static bool runFilterChain(ProcessingContext* context){
+    context->SetFinished(false);
     //uncomment different versions of sepia toning operations to see how they perform.
     
     //original with OpenCV
-    //applySepiaTone(m_sourceImage);
+    //applySepiaTone(context->GetSourceImage());
     
     //with direct pixel manipulations
-    //applySepiaToneWithDirectPixelManipulations(m_sourceImage);
+    //applySepiaToneWithDirectPixelManipulations(context->GetSourceImage());
     
     //with direct pixel manipulations and pthreads
-    //applySepiaToneWithDirectPixelManipulationsAndPthreadsForSMP(m_sourceImage);
+    //applySepiaToneWithDirectPixelManipulationsAndPthreadsForSMP(context->GetSourceImage());
     
     //with direct pixel manipulation and Ne10 vector operations
-    //applySepiaToneWithDirectPixelManipulationsAndNe10(m_sourceImage);
+    //applySepiaToneWithDirectPixelManipulationsAndNe10(context->GetSourceImage());
 
     //with ne10 and SMP (pthreads)
-    //applySepiaToneWithDirectPixelManipulationsAndNe10AndPthreadsForSMP(m_sourceImage);
+    //applySepiaToneWithDirectPixelManipulationsAndNe10AndPthreadsForSMP(context->GetSourceImage());
 
     //with neon
-    //applySepiaToneWithDirectPixelManipulationsAndNeonSSE(m_sourceImage);
+    //applySepiaToneWithDirectPixelManipulationsAndNeonSSE(context->GetSourceImage());
     
     //with neon and SMP
-    applySepiaToneWithDirectPixelManipulationsAndNeonSSEAndPthreadsForSMP(m_sourceImage);
-
+    //applySepiaToneWithDirectPixelManipulationsAndNeonSSEAndPthreadsForSMP(context->GetSourceImage());
+    
+    //fused single pass on the interleaved image and SMP, the vector kernel
+    //(neon/ssse3/avx2/scalar) is picked at runtime, see setFilterBackend
+    //applySepiaToneFused(context->GetSourceImage());
+    
+    //the whole chain set by setFilterChain (just sepia until then) in one go,
+    //pointwise effects are fused and the buffers between effects are pooled
+    FilterGraph* chain = context->GetFilterChain();
+    if (chain == 0) {
+        chain = new FilterGraph();
+        addEffectToGraph(chain, EFFECT_SEPIA);
+        context->SetFilterChain(chain);
+    }
+    
+    IplImage* source = context->GetSourceImage();
+    if (source == 0 || source->depth != IPL_DEPTH_8U ||
+        (source->nChannels != 3 && source->nChannels != 4)) {
+        LOGE("Error filter chains need an 8 bit colour source image.");
+        context->SetFinished(true);
+        return false;
+    }
+    
+    //on the clock
+    int64_t begin = timingNow();
+    
+    IplImage* result = chain->Run(source);
+    
+    //a node changed the format, keep the old frame around for next time
+    if (result != source) {
+        chain->GetPool()->Release(context->TakeSourceImage());
+        context->SetSourceImage(result);
+    }
     
-    processingFinished = true;
+    //off the clock
+    int64_t end = recordTimingSpan(TIMING_STAGE_KERNEL, TIMING_CALLING_THREAD, begin);
+    context->SetTimeStamp(timingSeconds(begin, end));
+    
+#ifdef TIMEIT
+    logTimeTaken("run the filter chain", context->GetTimeStamp());
+#endif
+    
+    context->SetFinished(true);
     return true;
     
 }
 
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_doChainOfImageProcessingOperations(JNIEnv* env,
+                                                                                        jobject thiz){
+    return runFilterChain(getDefaultContext());
+}
+
+// Build a chain of the effects (EFFECT_* in order) in a java int array.
+// Returns 0 if any of them are unknown.
+static FilterGraph* buildFilterChain(JNIEnv* env, jintArray effects)
+{
+    int count = env->GetArrayLength(effects);
+    int *effect = env->GetIntArrayElements(effects, 0);
+    if (effect == 0) {
+        LOGE("Error getting int array of effects.");
+        return 0;
+    }
+    
+    FilterGraph* chain = new FilterGraph();
+    bool built = true;
+    
+    for (int i = 0; i < count && built; i++) {
+        built = addEffectToGraph(chain, effect[i]);
+    }
+    
+    env->ReleaseIntArrayElements(effects, effect, JNI_ABORT);
+    
+    if (!built) {
+        delete chain;
+        return 0;
+    }
+    
+    return chain;
+}
+
+// Set the effects runFilterChain runs for a context. Returns false, leaving
+// the old chain alone, if any of them are unknown.
+static bool setFilterChainFromArray(JNIEnv* env, ProcessingContext* context, jintArray effects)
+{
+    FilterGraph* chain = buildFilterChain(env, effects);
+    if (chain == 0)
+        return false;
+    
+    context->SetFilterChain(chain);
+    
+    return true;
+}
+
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_setFilterChain(JNIEnv* env,
+                                                                     jobject thiz,
+                                                                     jintArray effects)
+{
+    return setFilterChainFromArray(env, getDefaultContext(), effects);
+}
+
 JNIEXPORT
 jfloat
 JNICALL
 Java_org_openparallel_imagethresh_ImageThreshActivity_STWithOpenCV(JNIEnv* env,
                                                                    jobject thiz){
     //original with OpenCV
-    applySepiaTone(m_sourceImage);
+    ProcessingContext* context = getDefaultContext();
+    context->SetTimeStamp(applySepiaTone(context->GetSourceImage()));
     
-    return timeStamp;
+    return context->GetTimeStamp();
 }
 
 JNIEXPORT
@@ -1184,9 +1116,10 @@ Java_org_openparallel_imagethresh_ImageThreshActivity_STWithManualManips(JNIEnv*
                                                                          jobject thiz){
     
     //with direct pixel manipulations
-    applySepiaToneWithDirectPixelManipulations(m_sourceImage);
+    ProcessingContext* context = getDefaultContext();
+    context->SetTimeStamp(applySepiaToneWithDirectPixelManipulations(context->GetSourceImage()));
     
-    return timeStamp;
+    return context->GetTimeStamp();
 }
 
 JNIEXPORT
@@ -1196,9 +1129,10 @@ Java_org_openparallel_imagethresh_ImageThreshActivity_STWithManualManipsAndSMP(J
                                                                                    jobject thiz){
     
     //with direct pixel manipulations and pthreads
-    applySepiaToneWithDirectPixelManipulationsAndPthreadsForSMP(m_sourceImage);
+    ProcessingContext* context = getDefaultContext();
+    context->SetTimeStamp(applySepiaToneWithDirectPixelManipulationsAndPthreadsForSMP(context->GetSourceImage()));
     
-    return timeStamp;
+    return context->GetTimeStamp();
 }
 
 JNIEXPORT
@@ -1208,9 +1142,10 @@ Java_org_openparallel_imagethresh_ImageThreshActivity_STWithNeTen(JNIEnv* env,
                                                                      jobject thiz){
     
     //with direct pixel manipulation and Ne10 vector operations
-    applySepiaToneWithDirectPixelManipulationsAndNe10(m_sourceImage);
+    ProcessingContext* context = getDefaultContext();
+    context->SetTimeStamp(applySepiaToneWithDirectPixelManipulationsAndNe10(context->GetSourceImage()));
     
-    return timeStamp;
+    return context->GetTimeStamp();
 }
 
 JNIEXPORT
@@ -1220,9 +1155,10 @@ Java_org_openparallel_imagethresh_ImageThreshActivity_STWithNeTenAndSMP(JNIEnv*
                                                                        jobject thiz){
     
     //with ne10 and SMP (pthreads)
-    applySepiaToneWithDirectPixelManipulationsAndNe10AndPthreadsForSMP(m_sourceImage);
+    ProcessingContext* context = getDefaultContext();
+    context->SetTimeStamp(applySepiaToneWithDirectPixelManipulationsAndNe10AndPthreadsForSMP(context->GetSourceImage()));
     
-    return timeStamp;
+    return context->GetTimeStamp();
 }
 
 JNIEXPORT
@@ -1231,10 +1167,21 @@ JNICALL
 Java_org_openparallel_imagethresh_ImageThreshActivity_STWithNeon(JNIEnv* env,
                                                                  jobject thiz){
     
-    //with neon
-    applySepiaToneWithDirectPixelManipulationsAndNeonSSE(m_sourceImage);
+#if defined(HAVE_NEON)
+    if (isFilterBackendSupported(FILTER_BACKEND_NEON)) {
+        //with neon
+        ProcessingContext* context = getDefaultContext();
+        context->SetTimeStamp(applySepiaToneWithDirectPixelManipulationsAndNeonSSE(context->GetSourceImage()));
+        
+        return context->GetTimeStamp();
+    }
+#endif
     
-    return timeStamp;
+    LOGE("neon isn't available on this device, using direct pixel manipulations");
+    ProcessingContext* context = getDefaultContext();
+    context->SetTimeStamp(applySepiaToneWithDirectPixelManipulations(context->GetSourceImage()));
+    
+    return context->GetTimeStamp();
 }
 
 JNIEXPORT
@@ -1243,10 +1190,40 @@ JNICALL
 Java_org_openparallel_imagethresh_ImageThreshActivity_STWithNeonAndSMP(JNIEnv* env,
                                                                        jobject thiz){
     
-    //with neon and SMP
-    applySepiaToneWithDirectPixelManipulationsAndNeonSSEAndPthreadsForSMP(m_sourceImage);
+#if defined(HAVE_NEON)
+    if (isFilterBackendSupported(FILTER_BACKEND_NEON)) {
+        //with neon and SMP
+        ProcessingContext* context = getDefaultContext();
+        context->SetTimeStamp(applySepiaToneWithDirectPixelManipulationsAndNeonSSEAndPthreadsForSMP(context->GetSourceImage()));
+        
+        return context->GetTimeStamp();
+    }
+#endif
     
-    return timeStamp;
+    LOGE("neon isn't available on this device, using direct pixel manipulations and SMP");
+    ProcessingContext* context = getDefaultContext();
+    context->SetTimeStamp(applySepiaToneWithDirectPixelManipulationsAndPthreadsForSMP(context->GetSourceImage()));
+    
+    return context->GetTimeStamp();
+}
+
+// Force the vector backend the filters run on (FILTER_BACKEND_* in
+// FilterBackend.h, -1 for auto). Returns false if the device can't run it.
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_setFilterBackend(JNIEnv* env,
+                                                                       jobject thiz,
+                                                                       jint backend){
+    return setFilterBackend(backend);
+}
+
+JNIEXPORT
+jstring
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_getFilterBackendName(JNIEnv* env,
+                                                                           jobject thiz){
+    return env->NewStringUTF(getFilterBackendName(getFilterBackend()));
 }
 
 //end of new functions
@@ -1257,51 +1234,19 @@ JNICALL
 Java_org_openparallel_imagethresh_ImageThreshActivity_applyFunhouseEffect(JNIEnv* env,
                                                                             jobject thiz){
     
-    processingFinished = false;
-    
-    bool erode = true;
-	bool circle = false;
-	bool dilate = true;
-	bool mirror = true;
-    
+    ProcessingContext* context = getDefaultContext();
+    context->SetFinished(false);
     
-    // Get one frame
-    IplImage* frame = cvCloneImage(m_sourceImage);
-    cvReleaseImage(&m_sourceImage);
-        
-    if( !frame ) {
+    if( !context->GetSourceImage() ) {
         return true;
     }
     
-    if(mirror) {
-        int halfFrame = frame->width/2;
-        int frameBytes = frame->width*3-1;
-        for(int i = 0; i < frame->height; i++) {
-            int offset = i*frame->width*3;
-            for(int j = 0; j < halfFrame; j++) {
-                int jBytes = offset+frameBytes-(j*3);
-                int ojBytes = offset+(j*3);
-                frame->imageData[jBytes-2] = frame->imageData[ojBytes];
-                frame->imageData[jBytes-1] = frame->imageData[ojBytes+1];
-                frame->imageData[jBytes] = frame->imageData[ojBytes+2];
-            }
-        }
-    }
-        
-    if(erode)
-        cvErode(frame,frame,0,2);
-    if(circle)
-        cvCircle(frame, cvPoint(100,100), 20, cvScalar(0,255,0), 1);
-    if(dilate)
-        cvDilate(frame,frame);
-        
-    m_sourceImage = cvCloneImage(frame);
-    
-    cvReleaseImage(&frame);
+    //works in place, so no need to clone the frame in and out any more
+    applyFunhouse(context->GetSourceImage());
     
-	processingFinished = true;
+	context->SetFinished(true);
     
-    return processingFinished;
+    return context->HasFinished();
 }
 
 
@@ -1311,80 +1256,22 @@ JNICALL
 Java_org_openparallel_imagethresh_ImageThreshActivity_applySketchbookEffect(JNIEnv* env,
                                                                                          jobject thiz){
     
-    processingFinished = false;
+    ProcessingContext* context = getDefaultContext();
+    ImagePool* pool = context->GetPool();
+    IplImage* source = context->GetSourceImage();
     
-    int col_1, row_1;
-    uchar b_1, g_1, r_1, b_2, g_2, r_2, b_d, g_d, r_d;
-
-    IplImage* img = cvCloneImage(m_sourceImage);
-    cvReleaseImage( &m_sourceImage );
+    context->SetFinished(false);
     
-    IplImage* img1 = cvCreateImage( cvSize( img->width,img->height ), img->depth, img->nChannels);
-    IplImage* img2 = cvCreateImage( cvSize( img->width,img->height ), img->depth, img->nChannels);
-    IplImage* dst = cvCreateImage( cvSize( img->width,img->height ), img->depth, img->nChannels);
-    IplImage* gray= cvCreateImage(cvGetSize(img), img->depth, 1);
-
-    cvNot(img, img1);
-    //   cvSmooth(img1, img2, CV_BLUR, 25,25,0,0);
-    cvSmooth(img, img2, CV_GAUSSIAN, 7, 7, 0, 0); // last fix :)
-
-    for( row_1 = 0; row_1 < img1->height; row_1++ )
-    {
-        for ( col_1 = 0; col_1 < img1->width; col_1++ )
-        {
-            b_1 = CV_IMAGE_ELEM( img1, uchar, row_1, col_1 * 3 );
-            g_1 = CV_IMAGE_ELEM( img1, uchar, row_1, col_1 * 3 + 1 );
-            r_1 = CV_IMAGE_ELEM( img1, uchar, row_1, col_1 * 3 + 2 );
-            
-            b_2 = CV_IMAGE_ELEM( img2, uchar, row_1, col_1 * 3 );
-            g_2 = CV_IMAGE_ELEM( img2, uchar, row_1, col_1 * 3 + 1 );
-            r_2 = CV_IMAGE_ELEM( img2, uchar, row_1, col_1 * 3 + 2 );
-            
-            //            b_d = b_1 + b_2;
-            //            g_d = g_1 + g_2;
-            //            r_d = r_1 + r_2;
-            
-//            b_d = min(255, b_1 + b_2);
-//            g_d = min(255, g_1 + g_2);
-//            r_d = min(255, r_1 + r_2);
-//            
-            if (b_1+b_2 < 255) {
-                b_d = 255;
-            }else{
-                b_d = b_1+b_2;
-            }
-            
-            if (g_1+g_2 < 255) {
-                g_d = 255;
-            }else{
-                g_d = g_1+g_2;
-            }
-            
-            if (r_1+r_2 < 255) {
-                r_d = 255;
-            }else{
-                r_d = r_1+r_2;
-            }
-            
-            
-            dst->imageData[img1->widthStep * row_1 + col_1* 3] = b_d;
-            dst->imageData[img1->widthStep * row_1 + col_1 * 3 + 1] = g_d;
-            dst->imageData[img1->widthStep * row_1 + col_1 * 3 + 2] = r_d;
-        }
-    }
-    cvCvtColor(dst, gray, CV_BGR2GRAY);
-
-    m_sourceImage = cvCloneImage(gray);
+    IplImage* gray = pool->Acquire(cvGetSize(source), source->depth, 1);
     
-    cvReleaseImage( &img );
-    cvReleaseImage( &img1 ); // Yes, you must release all the allocated memory.
-    cvReleaseImage( &img2 );
-    cvReleaseImage( &dst );
-    cvReleaseImage( &gray);
+    applySketchbook(source, gray);
     
-    processingFinished = true;
+    //the grey result becomes the source image
+    context->SetSourceImage(pool->Detach(gray));
     
-    return processingFinished;
+    context->SetFinished(true);
+    
+    return context->HasFinished();
 }
 
 
@@ -1394,336 +1281,27 @@ JNICALL
 Java_org_openparallel_imagethresh_ImageThreshActivity_applyNeonising(JNIEnv* env,
                                                                             jobject thiz){
     
-    processingFinished = false;
-    
-    
-    IplImage* sourceGrey = cvCreateImage(cvGetSize(m_sourceImage), IPL_DEPTH_8U, 1);
-    IplImage* sobelised = cvCreateImage(cvGetSize(m_sourceImage), IPL_DEPTH_8U, 1);
-    IplImage* threshed = cvCreateImage(cvGetSize(m_sourceImage), IPL_DEPTH_8U, 1);
-    IplImage* equalised = cvCreateImage(cvGetSize(m_sourceImage), IPL_DEPTH_8U, 1);
-    
-    cvCvtColor(m_sourceImage, sourceGrey, CV_BGR2GRAY);
+    ProcessingContext* context = getDefaultContext();
+    ImagePool* pool = context->GetPool();
+    IplImage* source = context->GetSourceImage();
     
-    cvReleaseImage(&m_sourceImage);
-//    //get grayscale
-//    IplImage* r = cvCreateImage( cvGetSize(source), IPL_DEPTH_8U, 1 ); 
-//    IplImage* g = cvCreateImage( cvGetSize(source), IPL_DEPTH_8U, 1 ); 
-//    IplImage* b = cvCreateImage( cvGetSize(source), IPL_DEPTH_8U, 1 );
-//    
-//    
-//    // Split image onto the color planes. 
-//    cvSplit( source, b, g, r, NULL );
-//    
-//    cvAddWeighted( r, 1./3., g, 1./3., 0.0, sourceGrey ); 
-//    cvAddWeighted( sourceGrey, 2./3., b, 1./3., 0.0, sourceGrey );
-//    
-//    cvReleaseImage(&r);
-//    cvReleaseImage(&b);
-//    cvReleaseImage(&g);
+    context->SetFinished(false);
     
     
-
-    //equalise histogram
-    cvEqualizeHist(sourceGrey, equalised);
+    IplImage* sourceGrey = pool->Acquire(cvGetSize(source), IPL_DEPTH_8U, 1);
+    IplImage* target = pool->Acquire(cvGetSize(source), IPL_DEPTH_8U, 3);
     
-    double minVal, maxVal;
-    cvMinMaxLoc(equalised, &minVal, &maxVal, NULL, NULL, NULL); //find minimum and maximum intensities
+    //new colours every time for stills
+    applyNeonisingWithScratch(source, target, sourceGrey,
+                              rand() % NEONISING_COLOURS, rand() % NEONISING_COLOURS);
     
-    m_sourceImage = cvCreateImage(cvGetSize(sourceGrey), 8, 3);
-    cvMerge(sourceGrey, sourceGrey, sourceGrey, NULL, m_sourceImage);
+    context->SetSourceImage(pool->Detach(target));
     
-#ifdef EighteesStyle
-    int stepSize = 0;
-    //int stepSize = 2;
+    pool->Release(sourceGrey);
     
-    for (int j=0; j < 10; j+=stepSize) {
+    context->SetFinished(true);
     
-        cvThreshold(equalised, threshed, (maxVal*(j*0.1)), (maxVal*((j+stepSize)*0.1)), CV_THRESH_BINARY);
-            
-        //apply neon ;)
-        CvMemStorage* contour_storage = cvCreateMemStorage(0);
-        CvSeq* contours = NULL;
-        
-        int numContours = cvFindContours(threshed, contour_storage, &contours, sizeof(CvContour),
-                                         CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE, cvPoint(0,0));
-        
-        //if no contours were found return early
-        if(numContours  < 1){
-            processingFinished = true;
-            
-            return processingFinished;
-        }
-        
-        //list of Neon Light Colours 
-        //
-        //rgb       %   %   %
-        //---------------------
-        //turquise  0   255 255
-        //lemon     255 255 0
-        //spring    0   255 0
-        //magenta   255 0   255
-        //lime      128 255 0
-        //tangerine 255 128 0
-        
-        
-        
-        int insChoice = rand()%5;
-        int outsChoice = rand()%5;
-        
-        CvScalar ins;
-        CvScalar outs;
-        
-        switch (insChoice) {
-            case 0:
-                ins = CV_RGB(0,255,255);
-                break;
-            case 1:
-                ins = CV_RGB(255,255,0);
-                break;
-            case 2:
-                ins = CV_RGB(0,255,0);
-                break;
-            case 3:
-                ins = CV_RGB(255,0,255);
-                break;
-            case 4:
-                ins = CV_RGB(128,255,0);
-                break;
-            case 5:
-                ins = CV_RGB(255,128,0);
-                break;
-            default:
-                break;
-        }
-        
-        switch (outsChoice) {
-            case 0:
-                outs = CV_RGB(0,255,255);
-                break;
-            case 1:
-                outs = CV_RGB(255,255,0);
-                break;
-            case 2:
-                outs = CV_RGB(0,255,0);
-                break;
-            case 3:
-                outs = CV_RGB(255,0,255);
-                break;
-            case 4:
-                outs = CV_RGB(128,255,0);
-                break;
-            case 5:
-                outs = CV_RGB(255,128,0);
-                break;
-            default:
-                break;
-        }
-        
-        for( CvSeq* c = contours; c != NULL; c = c->h_next ){
-            cvDrawContours(m_sourceImage, c, ins, outs, 1, 25, 8);
-        }
-        
-        cvReleaseMemStorage(&contour_storage);
-        
-    }
-    
-#else
-    
-    
-     
-     //LOGE("Maxval is -> %f", maxVal);
-     
-     //now we have time for binary thesholding
-     //cvAdaptiveThreshold(equalised,threshed,maxVal,CV_ADAPTIVE_THRESH_MEAN_C, CV_THRESH_TRUNC, 50);
-     
-     //get the top 40%
-     cvThreshold(equalised, threshed, (maxVal*0.6), (maxVal*1.0), CV_THRESH_BINARY);
-     
-     //perform an Closing morphology operation
-     IplConvKernel* ellipse = cvCreateStructuringElementEx(5,5,0,0,CV_SHAPE_ELLIPSE,NULL);
-     
-     
-     cvMorphologyEx(threshed, threshed, NULL, ellipse, CV_MOP_CLOSE, 1);
-     cvMorphologyEx(threshed, threshed, NULL, ellipse, CV_MOP_CLOSE, 1);
-     cvMorphologyEx(threshed, threshed, NULL, ellipse, CV_MOP_CLOSE, 1);
-     
-     //    cvErode(threshed,threshed, ellipse,1);
-     //    cvDilate(threshed,threshed, ellipse,1);
-     
-     for (int i = 0; i < 3; i++) {
-         cvSmooth(threshed, threshed, CV_GAUSSIAN,3,3);
-         cvThreshold(threshed, threshed, 1, 255, CV_THRESH_BINARY);
-     }
-     
-     //    
-     //    cvMorphologyEx(threshed, threshed, NULL, ellipse, CV_MOP_CLOSE, 1);
-     //    cvMorphologyEx(threshed, threshed, NULL, ellipse, CV_MOP_CLOSE, 1);
-     //    cvMorphologyEx(threshed, threshed, NULL, ellipse, CV_MOP_CLOSE, 1);
-     //    
-     
-     //cvDilate(threshed,threshed, ellipse,5);
-     
-     //cvMorphologyEx(threshed, threshed, NULL, ellipse, CV_MOP_OPEN, 4);
-     //    int numberOfMorphs = 4;
-     
-     //    for (int i = 0; i < numberOfMorphs; i++) {
-     //for every 1 closing operation do 2 iterations of opening (really remove all fine features)
-     //        cvMorphologyEx(threshed, threshed, NULL, ellipse, CV_MOP_CLOSE, 4);
-     
-     //cvMorphologyEx(threshed, threshed, NULL, ellipse, CV_MOP_OPEN, 1);
-     //    }
-     
-    
-    //    m_sourceImage = cvCloneImage(threshed);
-    //    processingFinished = true;
-    //    return processingFinished;
-    //    /*
-    
-    
-    //apply neon ;)
-    CvMemStorage* contour_storage = cvCreateMemStorage(0);
-    CvSeq* contours = NULL;
-    
-    int numContours = cvFindContours(threshed, contour_storage, &contours, sizeof(CvContour),
-                                     CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE, cvPoint(0,0));
-    
-    //if no contours were found return early
-    if(numContours  < 1){
-        processingFinished = true;
-        
-        return processingFinished;
-    }
-    
-    //list of Neon Light Colours 
-    //
-    //rgb       %   %   %
-    //---------------------
-    //turquise  0   255 255
-    //lemon     255 255 0
-    //spring    0   255 0
-    //magenta   255 0   255
-    //lime      128 255 0
-    //tangerine 255 128 0
-    
-    
-    
-    int insChoice = rand()%5;
-    int outsChoice = rand()%5;
-    
-    CvScalar ins;
-    CvScalar outs;
-    
-    switch (insChoice) {
-        case 0:
-            ins = CV_RGB(0,255,255);
-            break;
-        case 1:
-            ins = CV_RGB(255,255,0);
-            break;
-        case 2:
-            ins = CV_RGB(0,255,0);
-            break;
-        case 3:
-            ins = CV_RGB(255,0,255);
-            break;
-        case 4:
-            ins = CV_RGB(128,255,0);
-            break;
-        case 5:
-            ins = CV_RGB(255,128,0);
-            break;
-        default:
-            break;
-    }
-    
-    switch (outsChoice) {
-        case 0:
-            outs = CV_RGB(0,255,255);
-            break;
-        case 1:
-            outs = CV_RGB(255,255,0);
-            break;
-        case 2:
-            outs = CV_RGB(0,255,0);
-            break;
-        case 3:
-            outs = CV_RGB(255,0,255);
-            break;
-        case 4:
-            outs = CV_RGB(128,255,0);
-            break;
-        case 5:
-            outs = CV_RGB(255,128,0);
-            break;
-        default:
-            break;
-    }
-    
-    for( CvSeq* c = contours; c != NULL; c = c->h_next ){
-        cvDrawContours(m_sourceImage, c, ins, outs, 1, 25, 8);
-    }
-    
-    cvReleaseMemStorage(&contour_storage);
-    
-#endif
-    
-    cvReleaseImage(&sourceGrey);
-    cvReleaseImage(&sobelised);
-    cvReleaseImage(&threshed);
-    cvReleaseImage(&equalised);
-    
-    /*
-     
-     CvSeq* first_contour = NULL;
-     
-     int Nc = cvFindContours(
-     img_edge,
-     storage,
-     &first_contour,
-     sizeof(CvContour),
-     CV_RETR_LIST );
-     
-     int n=0;
-     printf( "Total Contours Detected: %d\n", Nc );
-     CvScalar red = CV_RGB(250,0,0);
-     CvScalar blue = CV_RGB(0,0,250);
-     
-     for( CvSeq* c=first_contour; c!=NULL; c=c->h_next ){
-     cvCvtColor( img_8uc1, img_8uc3, CV_GRAY2BGR );
-     cvDrawContours(
-     img_8uc3,
-     c,
-     red,		// Red
-     blue,		// Blue
-     1,			// Vary max_level and compare results
-     2,
-     8 );
-     printf( "Contour #%dn", n );
-     cvShowImage( "Contours 2", img_8uc3 );
-     printf( " %d elements:\n", c->total );
-     for( int i=0; itotal; ++i ){
-     CvPoint* p = CV_GET_SEQ_ELEM( CvPoint, c, i );
-     printf(" (%d,%d)\n", p->x, p->y );
-     }
-     cvWaitKey();
-     n++;
-     }
-
-     
-     */
-    
-    //IplImage* convolved = cvCreateImage(cvGetSize(opImage), IPL_DEPTH_8U, 3);
-        
-    //m_sourceImage = cvCloneImage(source);
-    //m_sourceImage = cvCreateImage(cvGetSize(opImage), IPL_DEPTH_8U, 3);
-    //cvConvertScaleAbs(result, m_sourceImage, 1,0);
-    //cvReleaseImage(&source);
-    //cvReleaseImage(&convolved);
-    //cvReleaseImage(&opImage);
-    
-    processingFinished = true;
-    
-    return processingFinished;
+    return context->HasFinished();
 }
 
 
@@ -1747,37 +1325,8 @@ void
 JNICALL
 Java_org_openparallel_imagethresh_ImageThreshActivity_doGrayscaleTransform(JNIEnv* env,
                                                                            jobject thiz){
-
-    IplImage* r = cvCreateImage( cvGetSize(m_sourceImage), IPL_DEPTH_8U, 1 ); 
-    IplImage* g = cvCreateImage( cvGetSize(m_sourceImage), IPL_DEPTH_8U, 1 ); 
-    IplImage* b = cvCreateImage( cvGetSize(m_sourceImage), IPL_DEPTH_8U, 1 );
-    
-    
-    // Split image onto the color planes. 
-    cvSplit( m_sourceImage, b, g, r, NULL );
-    
-    // Temporary storage
-    IplImage* s = cvCreateImage(cvGetSize(m_sourceImage), IPL_DEPTH_8U, 1 );
-    
-    // Release the source image
-    if (m_sourceImage) {
-		cvReleaseImage(&m_sourceImage);
-		m_sourceImage = 0;
-	}
     
-    // Add equally weighted rgb values. 
-    cvAddWeighted( r, 1./3., g, 1./3., 0.0, s ); 
-    cvAddWeighted( s, 2./3., b, 1./3., 0.0, s );
-    
-    // Merge the 4 channel to an BGRA image
-    m_sourceImage = cvCreateImage(cvGetSize(s), 8, 3);
-    
-    cvMerge(s, s, s, NULL, m_sourceImage);
-    
-    cvReleaseImage(&r); 
-    cvReleaseImage(&g); 
-    cvReleaseImage(&b); 
-    cvReleaseImage(&s);
+    applyGrayscale(getDefaultContext()->GetSourceImage());
     
     return;
 }
@@ -1855,27 +1404,319 @@ IplImage* getIplImageFromIntArray(JNIEnv* env, jintArray array_data,
 }
 
 
-// Generate and return a boolean array from the source image.
-// Return 0 if a failure occurs or if the source image is undefined.
+// Point an IplImage header at 4 channel pixels owned by someone else. The header
+// lives on the caller's stack and must never be cvReleaseImage'd, that would
+// free the pixels out from under their owner.
+void wrapPixelsAsImage(void* pixels, int width, int height, int stride, bool rgba,
+                       IplImage* header){
+    cvInitImageHeader(header, cvSize(width, height), IPL_DEPTH_8U, 4);
+    cvSetData(header, pixels, stride);
+    if (rgba)
+        memcpy(header->channelSeq, "RGBA", 4);
+}
+
+
+// Lock an android Bitmap and point an IplImage header straight at its pixels,
+// nothing is copied. The header is tagged "RGBA" since that's the bitmap's byte
+// order. Returns false with nothing locked unless the bitmap is ARGB_8888.
+// It is the responsibility of the caller to AndroidBitmap_unlockPixels it.
+bool lockBitmapAsImage(JNIEnv* env, jobject bitmap, IplImage* header){
+    AndroidBitmapInfo info;
+    void* pixels = 0;
+    
+    if (AndroidBitmap_getInfo(env, bitmap, &info) != ANDROID_BITMAP_RESULT_SUCCESS) {
+        LOGE("Error getting the bitmap info.");
+        return false;
+    }
+    
+    if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        LOGE("Error bitmap has to be ARGB_8888.");
+        return false;
+    }
+    
+    if (AndroidBitmap_lockPixels(env, bitmap, &pixels) != ANDROID_BITMAP_RESULT_SUCCESS || pixels == 0) {
+        LOGE("Error locking the bitmap pixels.");
+        return false;
+    }
+    
+    wrapPixelsAsImage(pixels, info.width, info.height, info.stride, true, header);
+    
+    return true;
+}
+
+
+// Set the source image from a Bitmap in a single conversion pass, rather than
+// getPixels into an int array and repacking that. The source image is reused
+// if it's already the right size.
+static bool setSourceImageFromBitmap(JNIEnv* env, ProcessingContext* context, jobject bitmap)
+{
+    IplImage header;
+    int64_t begin = timingNow();
+    
+    if (!lockBitmapAsImage(env, bitmap, &header)) {
+        LOGE("Error source image could not be created.");
+        return false;
+    }
+    
+    cvCvtColor(&header, context->PrepareSourceImage(cvGetSize(&header), 3), CV_RGBA2BGR);
+    
+    AndroidBitmap_unlockPixels(env, bitmap);
+    recordTimingSpan(TIMING_STAGE_UNPACK, TIMING_CALLING_THREAD, begin);
+    
+    return true;
+}
+
 JNIEXPORT
-jbyteArray
+jboolean
 JNICALL
-Java_org_openparallel_imagethresh_ImageThreshActivity_getSourceImage(JNIEnv* env,
-                                                                     jobject thiz)
+Java_org_openparallel_imagethresh_ImageThreshActivity_setSourceBitmap(JNIEnv* env,
+                                                                      jobject thiz,
+                                                                      jobject bitmap)
+{
+    return setSourceImageFromBitmap(env, getDefaultContext(), bitmap);
+}
+
+
+// Write the source image straight into a Bitmap of the same size, skipping the
+// BMP encode (and java's decode) getSourceImage goes through.
+static bool copySourceImageToBitmap(JNIEnv* env, ProcessingContext* context, jobject bitmap)
+{
+    IplImage* source = context->GetSourceImage();
+    
+    if (source == 0) {
+        LOGE("Error source image was not set.");
+        return false;
+    }
+    
+    IplImage header;
+    int64_t begin = timingNow();
+    
+    if (!lockBitmapAsImage(env, bitmap, &header))
+        return false;
+    
+    bool copied = true;
+    
+    if (header.width != source->width || header.height != source->height) {
+        LOGE("Error bitmap isn't the same size as the source image.");
+        copied = false;
+    }else{
+        //the sketchbook effect leaves a grey image behind, the packer takes either
+        packImageToArgb((uint8_t*)source->imageData, source->widthStep, source->nChannels,
+                        (uint8_t*)header.imageData, header.widthStep,
+                        source->width, source->height, true);
+    }
+    
+    AndroidBitmap_unlockPixels(env, bitmap);
+    recordTimingSpan(TIMING_STAGE_ENCODE, TIMING_CALLING_THREAD, begin);
+    
+    return copied;
+}
+
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_getSourceBitmap(JNIEnv* env,
+                                                                      jobject thiz,
+                                                                      jobject bitmap)
+{
+    return copySourceImageToBitmap(env, getDefaultContext(), bitmap);
+}
+
+
+// Write the source image into an int[] of width*height 0xAARRGGBB pixels, ready
+// for Bitmap.setPixels or createBitmap, again without going through a BMP.
+static bool copySourceImageToPixels(JNIEnv* env, ProcessingContext* context, jintArray pixels)
+{
+    IplImage* source = context->GetSourceImage();
+    
+    if (source == 0) {
+        LOGE("Error source image was not set.");
+        return false;
+    }
+    
+    if (pixels == 0 || env->GetArrayLength(pixels) < source->width*source->height) {
+        LOGE("Error pixel array is smaller than the source image.");
+        return false;
+    }
+    
+    int64_t begin = timingNow();
+    
+    //critical rather than GetIntArrayElements, which is allowed to hand back a
+    //copy. Nothing below calls back into java while it's held
+    uint8_t* dst = (uint8_t*)env->GetPrimitiveArrayCritical(pixels, 0);
+    if (dst == 0) {
+        LOGE("Error getting int array of pixels.");
+        return false;
+    }
+    
+    //a java int is B,G,R,A in memory on every cpu android runs on
+    packImageToArgb((uint8_t*)source->imageData, source->widthStep, source->nChannels,
+                    dst, source->width*4, source->width, source->height, false);
+    
+    env->ReleasePrimitiveArrayCritical(pixels, dst, 0);
+    recordTimingSpan(TIMING_STAGE_ENCODE, TIMING_CALLING_THREAD, begin);
+    
+    return true;
+}
+
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_getSourcePixels(JNIEnv* env,
+                                                                      jobject thiz,
+                                                                      jintArray pixels)
+{
+    return copySourceImageToPixels(env, getDefaultContext(), pixels);
+}
+
+
+// Sepia tone a Bitmap in place, its pixels are never copied out of java.
+JNIEXPORT
+jfloat
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_STWithBitmap(JNIEnv* env,
+                                                                   jobject thiz,
+                                                                   jobject bitmap)
+{
+    IplImage header;
+    
+    if (!lockBitmapAsImage(env, bitmap, &header))
+        return -1;
+    
+    float timeStamp = applySepiaToneFused(&header);
+    
+    AndroidBitmap_unlockPixels(env, bitmap);
+    
+    return timeStamp;
+}
+
+
+// Run one of the EFFECT_* effects on a Bitmap in place.
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_applyEffectToBitmap(JNIEnv* env,
+                                                                          jobject thiz,
+                                                                          jobject bitmap,
+                                                                          jint effect)
+{
+    IplImage header;
+    
+    if (!lockBitmapAsImage(env, bitmap, &header))
+        return false;
+    
+    bool applied = applyEffectInPlace(&header, effect);
+    
+    AndroidBitmap_unlockPixels(env, bitmap);
+    
+    return applied;
+}
+
+
+// Allocate a frame of width*height 4 channel pixels natively and hand it to java
+// as a direct ByteBuffer, so java can fill it (Bitmap.copyPixelsToBuffer, camera
+// frames...) and we can work on it without either side copying.
+// Has to go back through freePixelBuffer.
+JNIEXPORT
+jobject
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_allocPixelBuffer(JNIEnv* env,
+                                                                       jobject thiz,
+                                                                       jint width,
+                                                                       jint height)
+{
+    if (width <= 0 || height <= 0) {
+        LOGE("Error pixel buffer has to have a size.");
+        return 0;
+    }
+    
+    jlong size = (jlong)width*height*4;
+    
+    //cvAlloc keeps it aligned for the vector kernels
+    void* pixels = cvAlloc((size_t)size);
+    if (pixels == 0) {
+        LOGE("Unable to allocate a pixel buffer.");
+        return 0;
+    }
+    
+    return env->NewDirectByteBuffer(pixels, size);
+}
+
+
+JNIEXPORT
+void
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_freePixelBuffer(JNIEnv* env,
+                                                                      jobject thiz,
+                                                                      jobject buffer)
+{
+    void* pixels = env->GetDirectBufferAddress(buffer);
+    
+    if (pixels)
+        cvFree(&pixels);
+}
+
+
+// Run one of the EFFECT_* effects in place on the 4 channel pixels in a direct
+// ByteBuffer (from allocPixelBuffer or ByteBuffer.allocateDirect). stride is in
+// bytes, 0 for tightly packed rows. rgba is the byte order of Bitmap pixels,
+// otherwise they're taken to be BGRA.
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_applyEffectToBuffer(JNIEnv* env,
+                                                                          jobject thiz,
+                                                                          jobject buffer,
+                                                                          jint width,
+                                                                          jint height,
+                                                                          jint stride,
+                                                                          jboolean rgba,
+                                                                          jint effect)
+{
+    void* pixels = env->GetDirectBufferAddress(buffer);
+    if (pixels == 0) {
+        LOGE("Error pixel buffer isn't a direct ByteBuffer.");
+        return false;
+    }
+    
+    if (stride == 0)
+        stride = width*4;
+    
+    if (width <= 0 || height <= 0 || stride < width*4 ||
+        env->GetDirectBufferCapacity(buffer) < (jlong)stride*(height-1) + width*4) {
+        LOGE("Error pixel buffer is too small for the frame.");
+        return false;
+    }
+    
+    IplImage header;
+    wrapPixelsAsImage(pixels, width, height, stride, rgba, &header);
+    
+    return applyEffectInPlace(&header, effect);
+}
+
+
+// Generate and return a boolean array from the source image.
+// Return 0 if a failure occurs or if the source image is undefined.
+static jbyteArray getSourceImageAsBmp(JNIEnv* env, ProcessingContext* context)
 {
+    IplImage* source = context->GetSourceImage();
     
-	if (m_sourceImage == 0) {
+	if (source == 0) {
 		LOGE("Error source image was not set.");
 		return 0;
 	}
 	
 	CvMat stub;
-    CvMat *mat_image = cvGetMat(m_sourceImage, &stub);
+    CvMat *mat_image = cvGetMat(source, &stub);
     int channels = CV_MAT_CN( mat_image->type );
     int ipl_depth = cvCvToIplDepth(mat_image->type);
     
-	WLNonFileByteStream *strm = new WLNonFileByteStream();
-    loadImageBytes(mat_image->data.ptr, mat_image->step, mat_image->width,
+    int64_t begin = timingNow();
+    
+    //the context keeps its stream, so after the first frame encoding is just copying
+	WLNonFileByteStream *strm = context->GetByteStream();
+    //widthStep, cvGetMat gives a one row image a step of 0
+    loadImageBytes(mat_image->data.ptr, source->widthStep, mat_image->width,
                    mat_image->height, ipl_depth, channels, strm);
 	
 	int imageSize = strm->GetSize();
@@ -1898,13 +1739,39 @@ Java_org_openparallel_imagethresh_ImageThreshActivity_getSourceImage(JNIEnv* env
     env->SetByteArrayRegion(res_array, 0, imageSize, (jbyte*)strm->GetByte());
     
 	strm->Close();
-	//SAFE_DELETE(strm);
+    recordTimingSpan(TIMING_STAGE_ENCODE, TIMING_CALLING_THREAD, begin);
 	
 	return res_array;
     
 }
 
+JNIEXPORT
+jbyteArray
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_getSourceImage(JNIEnv* env,
+                                                                     jobject thiz)
+{
+    return getSourceImageAsBmp(env, getDefaultContext());
+}
+
 // Set the source image and return true if successful or false otherwise.
+static bool setSourceImageFromArray(JNIEnv* env, ProcessingContext* context, jintArray photo_data,
+                                    jint width, jint height)
+{
+	int64_t begin = timingNow();
+	IplImage* image = getIplImageFromIntArray(env, photo_data, width, height);
+	if (image == 0) {
+		LOGE("Error source image could not be created.");
+		return false;
+	}
+	recordTimingSpan(TIMING_STAGE_UNPACK, TIMING_CALLING_THREAD, begin);
+	
+	//the old one goes back to the context's pool
+	context->SetSourceImage(image);
+	
+	return true;
+}
+
 JNIEXPORT
 jboolean
 JNICALL
@@ -1914,22 +1781,7 @@ Java_org_openparallel_imagethresh_ImageThreshActivity_setSourceImage(JNIEnv* env
                                                                      jint width,
                                                                      jint height)
 {	
-        
-	// Release the image if it hasn't already been released.
-	if (m_sourceImage) {
-		cvReleaseImage(&m_sourceImage);
-		m_sourceImage = 0;
-	}
-	
-	m_sourceImage = getIplImageFromIntArray(env, photo_data, width, height);
-	if (m_sourceImage == 0) {
-		LOGE("Error source image could not be created.");
-		return false;
-	}
-	
-	return true;
-
-#endif
+	return setSourceImageFromArray(env, getDefaultContext(), photo_data, width, height);
 }
 
 JNIEXPORT
@@ -1937,7 +1789,305 @@ jboolean
 JNICALL
 Java_org_openparallel_imagethresh_ImageThreshActivity_imageProcessingHasFinished(JNIEnv* env,
                                                                                  jobject thiz){
-    return processingFinished;
+    return getDefaultContext()->HasFinished();
+}
+
+// Make a context of its own for a session (a photo, or a stream of frames) so
+// it can be processed on its own thread alongside any others. The handle is
+// opaque to java and has to go back through destroyProcessingContext, though
+// jobs still queued for it keep it alive until they're done.
+JNIEXPORT
+jlong
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_createProcessingContext(JNIEnv* env,
+                                                                              jobject thiz){
+    return (jlong)(intptr_t)new ProcessingContext();
+}
+
+JNIEXPORT
+void
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_destroyProcessingContext(JNIEnv* env,
+                                                                               jobject thiz,
+                                                                               jlong context){
+    if (context)
+        ((ProcessingContext*)(intptr_t)context)->Release();
+}
+
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_setContextSourceImage(JNIEnv* env,
+                                                                            jobject thiz,
+                                                                            jlong context,
+                                                                            jintArray photo_data,
+                                                                            jint width,
+                                                                            jint height){
+    return setSourceImageFromArray(env, (ProcessingContext*)(intptr_t)context, photo_data, width, height);
+}
+
+JNIEXPORT
+jbyteArray
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_getContextSourceImage(JNIEnv* env,
+                                                                            jobject thiz,
+                                                                            jlong context){
+    return getSourceImageAsBmp(env, (ProcessingContext*)(intptr_t)context);
+}
+
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_setContextSourceBitmap(JNIEnv* env,
+                                                                             jobject thiz,
+                                                                             jlong context,
+                                                                             jobject bitmap){
+    return setSourceImageFromBitmap(env, (ProcessingContext*)(intptr_t)context, bitmap);
+}
+
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_getContextSourceBitmap(JNIEnv* env,
+                                                                             jobject thiz,
+                                                                             jlong context,
+                                                                             jobject bitmap){
+    return copySourceImageToBitmap(env, (ProcessingContext*)(intptr_t)context, bitmap);
+}
+
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_getContextSourcePixels(JNIEnv* env,
+                                                                             jobject thiz,
+                                                                             jlong context,
+                                                                             jintArray pixels){
+    return copySourceImageToPixels(env, (ProcessingContext*)(intptr_t)context, pixels);
+}
+
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_setContextFilterChain(JNIEnv* env,
+                                                                            jobject thiz,
+                                                                            jlong context,
+                                                                            jintArray effects){
+    return setFilterChainFromArray(env, (ProcessingContext*)(intptr_t)context, effects);
+}
+
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_runContextFilterChain(JNIEnv* env,
+                                                                            jobject thiz,
+                                                                            jlong context){
+    return runFilterChain((ProcessingContext*)(intptr_t)context);
+}
+
+JNIEXPORT
+jfloat
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_getContextTimeStamp(JNIEnv* env,
+                                                                          jobject thiz,
+                                                                          jlong context){
+    return ((ProcessingContext*)(intptr_t)context)->GetTimeStamp();
+}
+
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_contextProcessingHasFinished(JNIEnv* env,
+                                                                                   jobject thiz,
+                                                                                   jlong context){
+    return ((ProcessingContext*)(intptr_t)context)->HasFinished();
+}
+
+// Copy the most recent timing spans (see StageTimer.h) into spans, 4 longs each:
+// stage, worker (-1 for the calling thread), start and duration in nanoseconds.
+// Oldest first, returns how many there were.
+JNIEXPORT
+jint
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_getTimingSpans(JNIEnv* env,
+                                                                     jobject thiz,
+                                                                     jlongArray spans){
+    if (spans == 0)
+        return 0;
+    
+    struct timing_span copied[TIMING_RING_SIZE];
+    int count = copyTimingSpans(copied, env->GetArrayLength(spans)/4);
+    
+    jlong flat[TIMING_RING_SIZE*4];
+    for (int i = 0; i < count; i++) {
+        flat[i*4+0] = copied[i].stage;
+        flat[i*4+1] = copied[i].worker;
+        flat[i*4+2] = copied[i].start;
+        flat[i*4+3] = copied[i].duration;
+    }
+    env->SetLongArrayRegion(spans, 0, count*4, flat);
+    
+    return count;
+}
+
+JNIEXPORT
+void
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_clearTimingSpans(JNIEnv* env,
+                                                                       jobject thiz){
+    clearTimingSpans();
+}
+
+struct processing_job
+{
+    //a reference of the job's own, see releaseProcessingJob
+    ProcessingContext *context;
+    //global refs, either can be 0
+    jobject bitmap;
+    jobject listener;
+    //swapped in as the context's chain when the job runs, 0 to keep its own
+    FilterGraph *chain;
+    float timeStamp;
+};
+
+static void releaseProcessingJob(JNIEnv* env, struct processing_job* job){
+    if (env && job->bitmap)
+        env->DeleteGlobalRef(job->bitmap);
+    if (env && job->listener)
+        env->DeleteGlobalRef(job->listener);
+    
+    delete job->chain;
+    job->context->Release();
+    delete job;
+}
+
+//runs on the job queue's thread
+static bool runProcessingJob(JNIEnv* env, void* arg){
+    struct processing_job *my_data = (struct processing_job *) arg;
+    ProcessingContext *context = my_data->context;
+    
+    //jobs run in the order they came in, so the chain changes exactly when
+    //the caller asked for it to
+    if (my_data->chain) {
+        context->SetFilterChain(my_data->chain);
+        my_data->chain = 0;
+    }
+    
+    if (my_data->bitmap) {
+        if (env == 0 || !setSourceImageFromBitmap(env, context, my_data->bitmap))
+            return false;
+    }
+    
+    if (!runFilterChain(context))
+        return false;
+    
+    my_data->timeStamp = context->GetTimeStamp();
+    
+    //the result goes back into the bitmap it came from
+    if (my_data->bitmap)
+        return copySourceImageToBitmap(env, context, my_data->bitmap);
+    
+    return true;
+}
+
+//tell java the job is done, on the job queue's thread (attached to the VM)
+static void finishProcessingJob(JNIEnv* env, int job, bool succeeded, void* arg){
+    struct processing_job *my_data = (struct processing_job *) arg;
+    
+    if (env && my_data->listener) {
+        jclass clazz = env->GetObjectClass(my_data->listener);
+        jmethodID mid = env->GetMethodID(clazz, "onProcessingFinished", "(IZF)V");
+        
+        if (mid) {
+            env->CallVoidMethod(my_data->listener, mid, (jint)job, (jboolean)succeeded,
+                                (jfloat)my_data->timeStamp);
+        }
+        
+        //nothing up the stack to catch it, so don't let it take the queue down
+        if (env->ExceptionCheck()) {
+            LOGE("Error onProcessingFinished threw an exception.");
+            env->ExceptionClear();
+        }
+        
+        env->DeleteLocalRef(clazz);
+    }
+    
+    releaseProcessingJob(env, my_data);
+}
+
+// Queue a frame to go through a filter chain without waiting for it. bitmap
+// (ARGB_8888, or null to use the context's source image) is processed in place,
+// and java mustn't touch it until the job is done. effects replaces the
+// context's chain, or is null to keep it. context is 0 for the default one.
+//
+// With a listener its onProcessingFinished(int job, boolean succeeded, float
+// timeStamp) is called on the queue's thread when the job is done, otherwise
+// the id that's returned is a future for processingJobHasFinished and
+// waitForProcessingJob. Futures don't have to be waited on: once all the
+// queue's slots are taken the oldest finished one is dropped to make room, and
+// a dropped job counts as finished (and as failed to waitForProcessingJob).
+// Returns -1 if the job couldn't be queued.
+JNIEXPORT
+jint
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_submitProcessingJob(JNIEnv* env,
+                                                                          jobject thiz,
+                                                                          jlong context,
+                                                                          jobject bitmap,
+                                                                          jintArray effects,
+                                                                          jobject listener){
+    JavaVM* vm = 0;
+    if (env->GetJavaVM(&vm) != JNI_OK) {
+        LOGE("Error getting the java VM.");
+        return -1;
+    }
+    
+    struct processing_job *job = new processing_job;
+    job->context = context ? (ProcessingContext*)(intptr_t)context : getDefaultContext();
+    job->context->Retain();
+    job->bitmap = bitmap ? env->NewGlobalRef(bitmap) : 0;
+    job->listener = listener ? env->NewGlobalRef(listener) : 0;
+    job->chain = 0;
+    job->timeStamp = 0;
+    
+    if (effects && (job->chain = buildFilterChain(env, effects)) == 0) {
+        releaseProcessingJob(env, job);
+        return -1;
+    }
+    
+    int id = JobQueue::GetShared(vm)->Submit(runProcessingJob, finishProcessingJob, job,
+                                             listener == 0);
+    if (id < 0) {
+        LOGE("Error the job queue is full.");
+        releaseProcessingJob(env, job);
+    }
+    
+    return id;
+}
+
+// Block until a job submitted without a listener is done, returning whether it
+// worked. Each job can only be waited on once.
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_waitForProcessingJob(JNIEnv* env,
+                                                                           jobject thiz,
+                                                                           jint job){
+    JavaVM* vm = 0;
+    env->GetJavaVM(&vm);
+    
+    return JobQueue::GetShared(vm)->Wait(job);
+}
+
+JNIEXPORT
+jboolean
+JNICALL
+Java_org_openparallel_imagethresh_ImageThreshActivity_processingJobHasFinished(JNIEnv* env,
+                                                                               jobject thiz,
+                                                                               jint job){
+    JavaVM* vm = 0;
+    env->GetJavaVM(&vm);
+    
+    return JobQueue::GetShared(vm)->HasFinished(job);
 }
 
 
@@ -1946,30 +2096,25 @@ Java_org_openparallel_imagethresh_ImageThreshActivity_stringFromJNI(JNIEnv* env,
     //initialise the random seed for neonise functions (used to pick NEON colours)
     srand(time(NULL)); 
     
-    #ifdef USINGNEON
     //do a little bit of simple float arithmetric (vector by scalar)
-    //if it runs, and computes the correct result... we know it works!
+    //if it runs, and computes the correct result... we know Ne10 works!
     
-    float* src = new float[1];
+    float src[1];
     src[0] = 1.5f;
-    float* dest = new float[1];
+    float dest[1];
     addc_float_c(dest, src, 1.0f, 1);
     
-    if (dest[0] == 2.5f) {
-        free(src);
-        free(dest);
-        return env->NewStringUTF("Hello from JNI! (ps... neon can compute floats too!)");
-    }
-    delete(src);
-    delete(dest);
+    char message[128];
+    sprintf(message, "Hello from JNI! (filters are running on the %s backend%s)",
+            getFilterBackendName(getFilterBackend()),
+            dest[0] == 2.5f ? "" : ", but Ne10 can't compute floats :(");
     
-    return env->NewStringUTF("Hello from JNI! (but... neon can't compute floats :( )");
-    #else
-    return env->NewStringUTF("Hello from JNI! (but... neon isn't being used )");
-    #endif
+    return env->NewStringUTF(message);
     
 }
 
+#endif
+
 
 /*
  * End of android specific stuff
@@ -6,8 +6,10 @@
 //  Copyright (c) 2012 OpenParallel.com all rights reserved.
 //
 
-#define USINGNEON
+//bench/ builds with -DNO_TIMEIT so the banners don't get in the way of its table
+#ifndef NO_TIMEIT
 #define TIMEIT
+#endif
 
 #ifndef FaceIt_FaceDetection_h
 #define FaceIt_FaceDetection_h
@@ -16,24 +18,52 @@
 #include <string.h>
 #include <time.h>
 #include <pthread.h>
-#include <arm_neon.h>
-
+#include "WorkerPool.h"
+#include "FilterBackend.h"
+#include "SepiaEngine.h"
+#include "PackEngine.h"
+#include "GrayscaleEngine.h"
+#include "SketchEngine.h"
+#include "FunhouseEngine.h"
+#include "NeonisingEngine.h"
+#include "StageTimer.h"
+#include "FilterGraph.h"
+
+//cxtypes.h (through FilterGraph.h) has its own
+#ifndef MIN
 #define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+#ifndef MAX
 #define MAX(a,b) (((a)>(b))?(a):(b))
+#endif
 //#define MIN(a,b) (b ^ ((a ^ b) & -(a < b)))
 //#define MAX(a,b) (a ^ ((a ^ b) & -(a < b)))
 
 #ifndef ANDROID
 
-#include <opencv/cv.h>
-#include <opencv/highgui.h>
+//host builds (see bench/) use the same bundled opencv as the app
+#include <stdio.h>
+#include "cv.h"
+#include "cxcore.h"
+
+#define LOGV(...) ((void)0)
+#define LOGE(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
 
 #endif
 
+//Ne10 library (only the portable _c routines are called directly, the neon
+//kernels are picked at runtime through FilterBackend)
+#include "inc/NE10_c.h"
+#include "inc/NE10_types.h"
+#include "inc/NE10_asm.h"
+#include "inc/NE10_neon.h"
+#include "inc/NE10.h"
+
 #ifdef ANDROID
 
 #include <jni.h>
 #include <android/log.h>
+#include <android/bitmap.h>
 
 #include "cv.h"
 #include "cxcore.h"
@@ -43,15 +73,8 @@
 #include "utils.h"
 #include "WLNonFileByteStream.h"
 #include "grfmt_bmp.h"
-
-//neon & Ne10 libraries
-#ifdef USINGNEON
-    #include "inc/NE10_c.h"
-    #include "inc/NE10_types.h"
-    #include "inc/NE10_asm.h"
-    #include "inc/NE10_neon.h"
-    #include "inc/NE10.h"
-#endif
+#include "ProcessingContext.h"
+#include "JobQueue.h"
 
 #define LOGV(...) __android_log_print(ANDROID_LOG_SILENT, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
@@ -71,10 +94,6 @@
 // CV Objects
 static const char* fmtSignBmp = "BM";
 
-IplImage *m_sourceImage = 0;
-
-float timeStamp;
-
 
 
 #ifdef __cplusplus
@@ -117,6 +136,18 @@ extern "C" {
     Java_org_openparallel_imagethresh_ImageThreshActivity_STWithNeonAndSMP(JNIEnv* env,
                                                                        jobject thiz);
     
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_setFilterBackend(JNIEnv* env,
+                                                                       jobject thiz,
+                                                                       jint backend);
+    JNIEXPORT
+    jstring
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_getFilterBackendName(JNIEnv* env,
+                                                                           jobject thiz);
+    
     
     //old ones
     
@@ -155,6 +186,13 @@ extern "C" {
     Java_org_openparallel_imagethresh_ImageThreshActivity_doChainOfImageProcessingOperations(JNIEnv* env,
                                                                                              jobject thiz);
     
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_setFilterChain(JNIEnv* env,
+                                                                         jobject thiz,
+                                                                         jintArray effects);
+    
     JNIEXPORT
     jbyteArray
     JNICALL
@@ -170,6 +208,192 @@ extern "C" {
                                                                          jint width,
                                                                          jint height);
     
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_setSourceBitmap(JNIEnv* env,
+                                                                          jobject thiz,
+                                                                          jobject bitmap);
+    
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_getSourceBitmap(JNIEnv* env,
+                                                                          jobject thiz,
+                                                                          jobject bitmap);
+    
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_getSourcePixels(JNIEnv* env,
+                                                                          jobject thiz,
+                                                                          jintArray pixels);
+    
+    JNIEXPORT
+    jfloat
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_STWithBitmap(JNIEnv* env,
+                                                                       jobject thiz,
+                                                                       jobject bitmap);
+    
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_applyEffectToBitmap(JNIEnv* env,
+                                                                              jobject thiz,
+                                                                              jobject bitmap,
+                                                                              jint effect);
+    
+    JNIEXPORT
+    jobject
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_allocPixelBuffer(JNIEnv* env,
+                                                                           jobject thiz,
+                                                                           jint width,
+                                                                           jint height);
+    
+    JNIEXPORT
+    void
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_freePixelBuffer(JNIEnv* env,
+                                                                          jobject thiz,
+                                                                          jobject buffer);
+    
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_applyEffectToBuffer(JNIEnv* env,
+                                                                              jobject thiz,
+                                                                              jobject buffer,
+                                                                              jint width,
+                                                                              jint height,
+                                                                              jint stride,
+                                                                              jboolean rgba,
+                                                                              jint effect);
+    
+    //per session contexts, see ProcessingContext.h
+    JNIEXPORT
+    jlong
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_createProcessingContext(JNIEnv* env,
+                                                                                  jobject thiz);
+    
+    JNIEXPORT
+    void
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_destroyProcessingContext(JNIEnv* env,
+                                                                                   jobject thiz,
+                                                                                   jlong context);
+    
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_setContextSourceImage(JNIEnv* env,
+                                                                                jobject thiz,
+                                                                                jlong context,
+                                                                                jintArray photo_data,
+                                                                                jint width,
+                                                                                jint height);
+    
+    JNIEXPORT
+    jbyteArray
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_getContextSourceImage(JNIEnv* env,
+                                                                                jobject thiz,
+                                                                                jlong context);
+    
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_setContextSourceBitmap(JNIEnv* env,
+                                                                                 jobject thiz,
+                                                                                 jlong context,
+                                                                                 jobject bitmap);
+    
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_getContextSourceBitmap(JNIEnv* env,
+                                                                                 jobject thiz,
+                                                                                 jlong context,
+                                                                                 jobject bitmap);
+    
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_getContextSourcePixels(JNIEnv* env,
+                                                                                 jobject thiz,
+                                                                                 jlong context,
+                                                                                 jintArray pixels);
+    
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_setContextFilterChain(JNIEnv* env,
+                                                                                jobject thiz,
+                                                                                jlong context,
+                                                                                jintArray effects);
+    
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_runContextFilterChain(JNIEnv* env,
+                                                                                jobject thiz,
+                                                                                jlong context);
+    
+    JNIEXPORT
+    jfloat
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_getContextTimeStamp(JNIEnv* env,
+                                                                              jobject thiz,
+                                                                              jlong context);
+    
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_contextProcessingHasFinished(JNIEnv* env,
+                                                                                       jobject thiz,
+                                                                                       jlong context);
+    
+    //wall clock spans per stage, see StageTimer.h
+    JNIEXPORT
+    jint
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_getTimingSpans(JNIEnv* env,
+                                                                         jobject thiz,
+                                                                         jlongArray spans);
+    
+    JNIEXPORT
+    void
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_clearTimingSpans(JNIEnv* env,
+                                                                           jobject thiz);
+    
+    //asynchronous jobs, see JobQueue.h
+    JNIEXPORT
+    jint
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_submitProcessingJob(JNIEnv* env,
+                                                                              jobject thiz,
+                                                                              jlong context,
+                                                                              jobject bitmap,
+                                                                              jintArray effects,
+                                                                              jobject listener);
+    
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_waitForProcessingJob(JNIEnv* env,
+                                                                               jobject thiz,
+                                                                               jint job);
+    
+    JNIEXPORT
+    jboolean
+    JNICALL
+    Java_org_openparallel_imagethresh_ImageThreshActivity_processingJobHasFinished(JNIEnv* env,
+                                                                                   jobject thiz,
+                                                                                   jint job);
+    
     JNIEXPORT
     jboolean
     JNICALL
@@ -214,7 +438,6 @@ void loadImageBytes(const uchar* data,
                     WLNonFileByteStream* m_strm) {
     
     int fileStep = (width*channels + 3) & -4;
-    uchar zeropad[] = "\0\0\0\0";
     char log_str[100];
     
     
@@ -257,14 +480,9 @@ void loadImageBytes(const uchar* data,
         m_strm->PutBytes( palette, sizeof(palette));
     }
     
+    // bmp rows go bottom up, so start at the last one and step backwards
     width *= channels;
-    data += step*(height - 1);
-    for( ; height--; data -= step )
-    {
-        m_strm->PutBytes( data, width );
-        if( fileStep > width )
-            m_strm->PutBytes( zeropad, fileStep - width );
-    }
+    m_strm->PutRows( data + step*(height - 1), -step, width, height, fileStep - width );
 }
 
 
@@ -400,7 +618,39 @@ void Log(char* message, bool errorFlag);
  */
 
 
-void applySepiaTone(IplImage* target);
+//the sepia variants return the seconds spent toning (0 unless TIMEIT)
+float applySepiaTone(IplImage* target);
+float applySepiaToneWithDirectPixelManipulations(IplImage* target);
+float applySepiaToneWithDirectPixelManipulationsAndPthreadsForSMP(IplImage* target);
+float applySepiaToneWithDirectPixelManipulationsAndNe10(IplImage* target);
+float applySepiaToneWithDirectPixelManipulationsAndNe10AndPthreadsForSMP(IplImage* target);
+float applySepiaToneFused(IplImage* target);
+
+//effects that can run on java's pixels in place (see applyEffectInPlace),
+//keep in step with the EFFECT_* constants in ImageThreshActivity
+enum {
+    EFFECT_SEPIA = 0,
+    EFFECT_GRAYSCALE,
+    EFFECT_SKETCHBOOK,
+    EFFECT_FUNHOUSE,
+    //only in filter chains, it always leaves 8 bit BGR behind
+    EFFECT_NEONISE
+};
+
+bool isRGBAImage(IplImage* image);
+void applyFunhouse(IplImage* frame);
+void applySketchbook(IplImage* img, IplImage* gray);
+void applyGrayscale(IplImage* target);
+void applyNeonisingWithScratch(IplImage* source, IplImage* target, IplImage* sourceGrey,
+                               int inner, int outer);
+bool applyEffectInPlace(IplImage* image, int effect);
+bool addEffectToGraph(FilterGraph* graph, int effect);
+
+//in ImageProcessorNeon.cpp, only built when HAVE_NEON is
+#if defined(HAVE_NEON)
+float applySepiaToneWithDirectPixelManipulationsAndNeonSSE(IplImage* target);
+float applySepiaToneWithDirectPixelManipulationsAndNeonSSEAndPthreadsForSMP(IplImage* target);
+#endif
 
 
 #endif
\ No newline at end of file
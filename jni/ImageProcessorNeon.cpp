@@ -0,0 +1,290 @@
+//
+//  ImageProcessorNeon.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+// The hand written neon sepia variants behind the STWithNeon* buttons.
+// Built with -mfpu=neon on armeabi-v7a only (see Android.mk), ImageProcessor
+// checks FilterBackend for neon on the device before calling into here.
+
+#define TIMEIT
+
+#if defined(HAVE_NEON)
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <arm_neon.h>
+#include <android/log.h>
+
+#include "cxcore.h"
+#include "WorkerPool.h"
+#include "StageTimer.h"
+
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOG_TAG "Captain's Log"
+
+uint8x8_t vdiv3_u8(uint8x8_t in){
+    //widen in
+    uint16x8_t tmp = vmovl_u8(in);
+
+    //q = (n >> 2) + (n >> 4)   ~ q = n * 0.0101 (approx.)
+    uint16x8_t quo = vshrq_n_u16(tmp, 2);
+    quo = vaddq_u16(quo, vshrq_n_u16(tmp, 4));
+    
+    //q = q + (q >> 4)          ~ q = n * 0.01010101
+    quo = vaddq_u16(quo, vshrq_n_u16(quo, 4));
+    //q = q + (q >> 8)          ~ q = n * 0.0101010101010101
+    quo = vaddq_u16(quo, vshrq_n_u16(quo, 8));
+    
+    // r = n - q*3
+    uint16x8_t rem = vsubq_u16(tmp,vmulq_n_u16(quo,3));
+    
+    // return q + (6*r >> 4)
+    tmp = vaddq_u16(quo, vshrq_n_u16(vmulq_n_u16(rem,6),4));
+    
+    //shorten
+    in  = vmovn_u16(tmp);
+    return in;
+}
+
+//tone one block of 8 pixels held in the planar vectors
+static inline void sepiaToneBlockNeon(uint8_t *rptr, uint8_t *gptr, uint8_t *bptr){
+    uint8x8_t rfac = vdup_n_u8 (40);
+    uint8x8_t gfac = vdup_n_u8 (20);
+    uint8x8_t bfac = vdup_n_u8 (20);
+    
+    uint8x8_t imin = vdup_n_u8 (0);
+    uint8x8_t imax = vdup_n_u8 (255);
+    
+    //get values for this block
+    uint8x8_t red = vld1_u8(rptr);
+    uint8x8_t grn = vld1_u8(gptr);
+    uint8x8_t blu = vld1_u8(bptr);
+    //intensity vector
+    uint8x8_t ins;
+    
+    //average the channel intensity
+    red = vdiv3_u8(red);
+    grn = vdiv3_u8(grn);
+    blu = vdiv3_u8(blu);
+    
+    //add all channels together
+    ins = vadd_u8(blu,vadd_u8(red,grn));
+    
+    //add sepia weights
+    blu = vqsub_u8(ins, bfac);
+    grn = vqadd_u8(ins, gfac);
+    red = vqadd_u8(ins, rfac);
+    
+    //do boundary checks
+    blu = vmax_u8(blu, imin);
+    red = vmin_u8(red, imax);
+    grn = vmin_u8(grn, imax);
+    
+    //set values for this block
+    vst1_u8(rptr, red);
+    vst1_u8(gptr, grn);
+    vst1_u8(bptr, blu);
+}
+
+//tone pixels [startPoint, stopPoint) of the planar vectors, any length
+static void sepiaTonePlanesNeon(uint8_t *r, uint8_t *g, uint8_t *b, int startPoint, int stopPoint){
+    int j = startPoint;
+    
+    for (; j+8 <= stopPoint; j+=8){
+        sepiaToneBlockNeon(r+j, g+j, b+j);
+    }
+    
+    //the last (less than 8) pixels go through the same vector code via a
+    //padded copy, so we never read or write past the end of our share
+    int tail = stopPoint - j;
+    if (tail > 0) {
+        uint8_t rtail[8] = {0}, gtail[8] = {0}, btail[8] = {0};
+        memcpy(rtail, r+j, tail);
+        memcpy(gtail, g+j, tail);
+        memcpy(btail, b+j, tail);
+        
+        sepiaToneBlockNeon(rtail, gtail, btail);
+        
+        memcpy(r+j, rtail, tail);
+        memcpy(g+j, gtail, tail);
+        memcpy(b+j, btail, tail);
+    }
+}
+
+struct thread_data_neon
+{
+    int width;
+    uint8_t *r;
+    uint8_t *g;
+    uint8_t *b;
+};
+
+
+
+//start and stop are rows, handed out evenly by the worker pool
+void doThreadGruntworkNeon(void*threadarg, int startRow, int stopRow, int worker){
+    
+    struct thread_data_neon *my_data;
+    
+    my_data = (struct thread_data_neon *) threadarg;
+    int64_t begin = timingNow();
+    
+    //but do work on your share of the image
+    int startPoint = startRow * my_data->width;
+    int stopPoint = stopRow * my_data->width;
+    
+    sepiaTonePlanesNeon(my_data->r, my_data->g, my_data->b, startPoint, stopPoint);
+    
+    recordTimingSpan(TIMING_STAGE_KERNEL, worker, begin);
+}
+
+float applySepiaToneWithDirectPixelManipulationsAndNeonSSEAndPthreadsForSMP(IplImage* target){
+    float elapsed = 0;
+    
+    //allocate vectors
+    uint8_t *b = new uint8_t[target->height*target->width];
+    uint8_t *g = new uint8_t[target->height*target->width];
+    uint8_t *r = new uint8_t[target->height*target->width];
+    
+    
+    int64_t begin = timingNow();
+    
+    //collect image pixels into vectors
+    int i=0; //pixel Position
+    for( int y=0; y<target->height; y++ ){
+        uchar* ptr = (uchar*) (
+                               target->imageData + y * target->widthStep
+                               );
+        
+        for( int x=0; x<target->width; x++ ) {
+            b[i] = ptr[3*x+0];
+            g[i] = ptr[3*x+1];
+            r[i] = ptr[3*x+2];
+            
+            i++;
+        }
+    }
+    
+    
+    //on the clock
+    begin = recordTimingSpan(TIMING_STAGE_UNPACK, TIMING_CALLING_THREAD, begin);
+    
+    
+    //partition the toning across the worker pool (in whole rows)
+    struct thread_data_neon sepia_data;
+    sepia_data.r = r;
+    sepia_data.g = g;
+    sepia_data.b = b;
+    sepia_data.width = target->width;
+    
+    //returns once every worker is done, so the write back can't race them
+    WorkerPool::GetShared()->ParallelFor(target->height,
+                                         doThreadGruntworkNeon,
+                                         (void*)&sepia_data);
+
+    
+    
+    //off the clock
+    int64_t end = recordTimingSpan(TIMING_STAGE_KERNEL, TIMING_CALLING_THREAD, begin);
+    elapsed = timingSeconds(begin, end);
+    
+    //write image pixels back from vectors
+    i=0; //pixel Position
+    for( int y=0; y<target->height; y++ ){
+        uchar* ptr = (uchar*) (
+                               target->imageData + y * target->widthStep
+                               );
+        
+        for( int x=0; x<target->width; x++ ) {
+            ptr[3*x+0] = b[i];
+            ptr[3*x+1] = g[i];
+            ptr[3*x+2] = r[i];
+            
+            i++;
+        }
+    }
+    
+    recordTimingSpan(TIMING_STAGE_REPACK, TIMING_CALLING_THREAD, end);
+    
+#ifdef TIMEIT
+    logTimeTaken("compute Sepia Tone values", elapsed);
+#endif
+    
+    delete[] b;
+    delete[] g;
+    delete[] r;
+    
+    return elapsed;
+}
+
+
+float applySepiaToneWithDirectPixelManipulationsAndNeonSSE(IplImage* target){
+    float elapsed = 0;
+    
+    //allocate vectors
+    uint8_t *b = new uint8_t[target->height*target->width];
+    uint8_t *g = new uint8_t[target->height*target->width];
+    uint8_t *r = new uint8_t[target->height*target->width];
+    
+    int64_t begin = timingNow();
+    
+    //collect image pixels into vectors
+    int i=0; //pixel Position
+    for( int y=0; y<target->height; y++ ){
+        uchar* ptr = (uchar*) (
+                               target->imageData + y * target->widthStep
+                               );
+        
+        for( int x=0; x<target->width; x++ ) {
+            b[i] = ptr[3*x+0];
+            g[i] = ptr[3*x+1];
+            r[i] = ptr[3*x+2];
+            
+            i++;
+        }
+    }
+    
+    
+    //on the clock
+    begin = recordTimingSpan(TIMING_STAGE_UNPACK, TIMING_CALLING_THREAD, begin);
+    
+    sepiaTonePlanesNeon(r, g, b, 0, target->width*target->height);
+    
+    //off the clock
+    int64_t end = recordTimingSpan(TIMING_STAGE_KERNEL, TIMING_CALLING_THREAD, begin);
+    elapsed = timingSeconds(begin, end);
+    
+    //write image pixels back from vectors
+    i=0; //pixel Position
+    for( int y=0; y<target->height; y++ ){
+        uchar* ptr = (uchar*) (
+                               target->imageData + y * target->widthStep
+                               );
+        
+        for( int x=0; x<target->width; x++ ) {
+            ptr[3*x+0] = b[i];
+            ptr[3*x+1] = g[i];
+            ptr[3*x+2] = r[i];
+            
+            i++;
+        }
+    }
+    
+    recordTimingSpan(TIMING_STAGE_REPACK, TIMING_CALLING_THREAD, end);
+    
+#ifdef TIMEIT
+    logTimeTaken("compute Sepia Tone values", elapsed);
+#endif
+    
+    delete[] b;
+    delete[] g;
+    delete[] r;
+    
+    return elapsed;
+}
+
+#endif
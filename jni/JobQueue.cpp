@@ -0,0 +1,209 @@
+//
+//  JobQueue.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#include "JobQueue.h"
+
+#include <string.h>
+
+/*
+ * Private variables
+ */
+
+static JobQueue* sharedQueue = 0;
+static pthread_mutex_t sharedQueueLock = PTHREAD_MUTEX_INITIALIZER;
+
+///////////////////////////// JobQueue /////////////////////////////////////
+
+JobQueue::JobQueue(JavaVM* vm)
+{
+    m_vm = vm;
+    m_nextId = 0;
+    m_shutdown = false;
+    memset(m_entries, 0, sizeof(m_entries));
+
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_jobAvailable, NULL);
+    pthread_cond_init(&m_jobDone, NULL);
+
+    m_running = pthread_create(&m_thread, NULL, QueueMain, (void*)this) == 0;
+}
+
+
+JobQueue::~JobQueue()
+{
+    pthread_mutex_lock(&m_lock);
+    m_shutdown = true;
+    pthread_cond_broadcast(&m_jobAvailable);
+    pthread_mutex_unlock(&m_lock);
+
+    if (m_running)
+        pthread_join(m_thread, NULL);
+
+    pthread_cond_destroy(&m_jobDone);
+    pthread_cond_destroy(&m_jobAvailable);
+    pthread_mutex_destroy(&m_lock);
+}
+
+
+JobQueue* JobQueue::GetShared(JavaVM* vm)
+{
+    pthread_mutex_lock(&sharedQueueLock);
+    if (sharedQueue == 0)
+        sharedQueue = new JobQueue(vm);
+    pthread_mutex_unlock(&sharedQueueLock);
+
+    return sharedQueue;
+}
+
+
+struct job_queue_entry* JobQueue::FindEntry(int job)
+{
+    for (int i = 0; i < JOB_QUEUE_MAX_JOBS; i++) {
+        if (m_entries[i].state != JOB_FREE && m_entries[i].id == job)
+            return &m_entries[i];
+    }
+
+    return 0;
+}
+
+
+struct job_queue_entry* JobQueue::NextQueued()
+{
+    struct job_queue_entry* next = 0;
+
+    //ids only go up, so the lowest one queued was submitted first
+    for (int i = 0; i < JOB_QUEUE_MAX_JOBS; i++) {
+        if (m_entries[i].state == JOB_QUEUED && (!next || m_entries[i].id < next->id))
+            next = &m_entries[i];
+    }
+
+    return next;
+}
+
+
+int JobQueue::Submit(JobFunction run, JobCompletion done, void* arg, bool keepResult)
+{
+    if (!run || !m_running)
+        return -1;
+
+    int id = -1;
+
+    pthread_mutex_lock(&m_lock);
+    struct job_queue_entry* entry = 0;
+
+    for (int i = 0; i < JOB_QUEUE_MAX_JOBS && !entry; i++) {
+        if (m_entries[i].state == JOB_FREE)
+            entry = &m_entries[i];
+    }
+
+    //full up, so drop the oldest result nobody has come for. Futures that are
+    //only ever polled with HasFinished would otherwise hold on to their slots
+    for (int i = 0; i < JOB_QUEUE_MAX_JOBS && !entry; i++) {
+        struct job_queue_entry* candidate = &m_entries[i];
+
+        if (candidate->state == JOB_DONE && !candidate->collecting &&
+            (!entry || candidate->id < entry->id))
+            entry = candidate;
+    }
+
+    if (entry) {
+        //ids stay positive so -1 can mean failure
+        id = m_nextId;
+        m_nextId = (m_nextId + 1) & 0x7fffffff;
+        entry->id = id;
+        entry->state = JOB_QUEUED;
+        entry->succeeded = false;
+        entry->keepResult = keepResult;
+        entry->collecting = false;
+        entry->run = run;
+        entry->done = done;
+        entry->arg = arg;
+
+        pthread_cond_signal(&m_jobAvailable);
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    return id;
+}
+
+
+bool JobQueue::Wait(int job)
+{
+    bool succeeded = false;
+
+    pthread_mutex_lock(&m_lock);
+    struct job_queue_entry* entry = FindEntry(job);
+
+    if (entry && entry->keepResult && !entry->collecting) {
+        entry->collecting = true;
+        while (entry->state != JOB_DONE)
+            pthread_cond_wait(&m_jobDone, &m_lock);
+
+        succeeded = entry->succeeded;
+        entry->collecting = false;
+        entry->state = JOB_FREE;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    return succeeded;
+}
+
+
+bool JobQueue::HasFinished(int job)
+{
+    pthread_mutex_lock(&m_lock);
+    struct job_queue_entry* entry = FindEntry(job);
+    bool finished = !entry || entry->state == JOB_DONE;
+    pthread_mutex_unlock(&m_lock);
+
+    return finished;
+}
+
+
+void* JobQueue::QueueMain(void* arg)
+{
+    JobQueue* queue = (JobQueue*)arg;
+    JNIEnv* env = 0;
+
+    //callbacks land on this thread, so java has to know about it
+    if (queue->m_vm && queue->m_vm->AttachCurrentThread(&env, NULL) != JNI_OK)
+        env = 0;
+
+    pthread_mutex_lock(&queue->m_lock);
+    for (;;) {
+        struct job_queue_entry* entry;
+
+        while ((entry = queue->NextQueued()) == 0 && !queue->m_shutdown)
+            pthread_cond_wait(&queue->m_jobAvailable, &queue->m_lock);
+
+        if (entry == 0)
+            break;
+
+        entry->state = JOB_RUNNING;
+        int id = entry->id;
+        JobFunction run = entry->run;
+        JobCompletion done = entry->done;
+        void* jobArg = entry->arg;
+        pthread_mutex_unlock(&queue->m_lock);
+
+        bool succeeded = run(env, jobArg);
+
+        if (done)
+            done(env, id, succeeded, jobArg);
+
+        pthread_mutex_lock(&queue->m_lock);
+        entry->succeeded = succeeded;
+        entry->state = entry->keepResult ? JOB_DONE : JOB_FREE;
+        pthread_cond_broadcast(&queue->m_jobDone);
+    }
+    pthread_mutex_unlock(&queue->m_lock);
+
+    if (env)
+        queue->m_vm->DetachCurrentThread();
+
+    return NULL;
+}
@@ -0,0 +1,97 @@
+//
+//  JobQueue.h
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#ifndef FaceIt_JobQueue_h
+#define FaceIt_JobQueue_h
+
+#include <pthread.h>
+#include <jni.h>
+
+//the most jobs that can be queued, running or waiting to be collected at once
+#define JOB_QUEUE_MAX_JOBS 32
+
+//does the work, on the queue's thread. env belongs to that thread
+typedef bool (*JobFunction)(JNIEnv* env, void* arg);
+
+//called on the queue's thread once the job is done, whether it worked or
+//not, to report back and clean up arg
+typedef void (*JobCompletion)(JNIEnv* env, int job, bool succeeded, void* arg);
+
+enum {
+    JOB_FREE = 0,
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_DONE
+};
+
+struct job_queue_entry
+{
+    int             id;
+    int             state;
+    bool            succeeded;
+    //keep the entry around after it's done until Wait collects it (or the
+    //queue fills up and needs the slot, see Submit)
+    bool            keepResult;
+    //a Wait is blocked on it, so it mustn't be handed to another job
+    bool            collecting;
+    JobFunction     run;
+    JobCompletion   done;
+    void*           arg;
+};
+
+/*
+ * Runs jobs one after the other, in the order they were submitted, on a
+ * thread of its own that is attached to the java VM. Submit never waits on
+ * the work, so the UI thread can hand over frame after frame and carry on
+ * capturing and drawing while the queue gets through them.
+ *
+ * Each job gets an id back from Submit. Either the completion function
+ * reports the result (a java callback), or the id is kept as a future that
+ * can be checked with HasFinished and collected with Wait. Kept results are
+ * only held on to while there's room: when every slot is taken the oldest
+ * one nobody has collected is dropped to make space for the new job.
+ */
+class JobQueue {
+public:
+    JobQueue(JavaVM* vm);
+    ~JobQueue();
+
+    //the job's id, or -1 if every slot is queued, running or being waited on
+    //(or there's no thread to run it). A full queue reuses the slot of the
+    //oldest kept job that is done, which then counts as collected
+    int     Submit(JobFunction run, JobCompletion done, void* arg, bool keepResult);
+
+    //block until the job is done and collect it, returning whether it worked.
+    //False straight away for jobs that aren't kept, were already collected (or
+    //dropped to make room) or that another Wait is already on
+    bool    Wait(int job);
+
+    //true once the job has run (or if there's no such job any more)
+    bool    HasFinished(int job);
+
+    //the queue the JNI calls submit to, made on first use
+    static JobQueue*    GetShared(JavaVM* vm);
+
+protected:
+    static void*    QueueMain(void* arg);
+    struct job_queue_entry* FindEntry(int job);
+    struct job_queue_entry* NextQueued();
+
+    JavaVM*         m_vm;
+    pthread_t       m_thread;
+    bool            m_running;
+
+    pthread_mutex_t m_lock;
+    pthread_cond_t  m_jobAvailable;
+    pthread_cond_t  m_jobDone;
+
+    int             m_nextId;
+    bool            m_shutdown;
+    struct job_queue_entry m_entries[JOB_QUEUE_MAX_JOBS];
+};
+
+#endif
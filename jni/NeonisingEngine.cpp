@@ -0,0 +1,260 @@
+//
+//  NeonisingEngine.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#include "NeonisingEngine.h"
+#include "GrayscaleEngine.h"
+#include "FilterBackend.h"
+#include "WorkerPool.h"
+#include "StageTimer.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NEONISING_SOBEL_ROWS    3
+
+/*
+ * Private variables
+ */
+
+//list of Neon Light Colours, as BGR
+//
+//rgb       %   %   %
+//---------------------
+//turquise  0   255 255
+//lemon     255 255 0
+//spring    0   255 0
+//magenta   255 0   255
+//lime      128 255 0
+//tangerine 255 128 0
+static const uint8_t neonColours[NEONISING_COLOURS][3] = {
+    {255, 255, 0},
+    {0, 255, 255},
+    {0, 255, 0},
+    {255, 0, 255},
+    {0, 255, 128},
+    {0, 128, 255}
+};
+
+/*
+ * Private kernels
+ */
+
+//scalar version, also used to finish off the last few pixels of each row
+static inline void sobelMagnitudePixels(const uint8_t* const* rows, uint8_t* dst, int start, int width){
+    for (int x = start; x < width; x++) {
+        int gx = (rows[0][x+1] + 2*rows[1][x+1] + rows[2][x+1]) -
+                 (rows[0][x-1] + 2*rows[1][x-1] + rows[2][x-1]);
+        int gy = (rows[2][x-1] + 2*rows[2][x] + rows[2][x+1]) -
+                 (rows[0][x-1] + 2*rows[0][x] + rows[0][x+1]);
+        int mag = ((gx < 0 ? -gx : gx) + (gy < 0 ? -gy : gy)) >> NEONISING_SOBEL_SHIFT;
+
+        dst[x] = (uint8_t)(mag > 255 ? 255 : mag);
+    }
+}
+
+struct thread_data_neonising
+{
+    SobelMagnitudeKernel sobelRow;
+    const uint8_t *src;
+    int srcStep;
+    int srcChannels;
+    uint8_t *grey;
+    int greyStep;
+    uint8_t *dst;
+    int dstStep;
+    int width;
+    int height;
+    bool rgba;
+    int bands;
+    //one per band, added up between the passes
+    uint32_t (*histograms)[256];
+    uint8_t equalise[256];
+    //edge colours by magnitude, only from NEONISING_EDGE_THRESHOLD up
+    uint8_t palette[256][3];
+};
+
+static inline int bandStart(struct thread_data_neonising* my_data, int band){
+    return (int)((long long)band*my_data->height/my_data->bands);
+}
+
+//first pass: the grey plane and a histogram of each band
+static void doThreadGruntworkNeonisingGrey(void*threadarg, int startBand, int stopBand, int worker){
+    struct thread_data_neonising *my_data = (struct thread_data_neonising *) threadarg;
+    int64_t begin = timingNow();
+    int width = my_data->width;
+
+    for (int band = startBand; band < stopBand; band++) {
+        uint32_t* histogram = my_data->histograms[band];
+        memset(histogram, 0, 256*sizeof(uint32_t));
+
+        for (int y = bandStart(my_data, band); y < bandStart(my_data, band+1); y++) {
+            uint8_t* grey = my_data->grey + y*my_data->greyStep;
+
+            grayscaleRow(my_data->src + y*my_data->srcStep, my_data->srcChannels, grey, 1,
+                         width, my_data->rgba);
+
+            for (int x = 0; x < width; x++)
+                histogram[grey[x]]++;
+        }
+    }
+
+    recordTimingSpan(TIMING_STAGE_KERNEL, worker, begin);
+}
+
+//equalised grey of row y (clamped to the image) into its slot in the ring,
+//with the edge pixels repeated one either side for the sobel
+static inline uint8_t* equalisedRowInto(struct thread_data_neonising* my_data, uint8_t* ring, int y){
+    int width = my_data->width;
+    uint8_t* slot = ring + ((y + 1) % NEONISING_SOBEL_ROWS)*(width + 2) + 1;
+    int row = y < 0 ? 0 : (y >= my_data->height ? my_data->height-1 : y);
+    const uint8_t* grey = my_data->grey + row*my_data->greyStep;
+
+    for (int x = 0; x < width; x++)
+        slot[x] = my_data->equalise[grey[x]];
+
+    slot[-1] = slot[0];
+    slot[width] = slot[width-1];
+    return slot;
+}
+
+//second pass: equalise, sobel and colour in, a row at a time
+static void doThreadGruntworkNeonisingEdges(void*threadarg, int startRow, int stopRow, int worker){
+    struct thread_data_neonising *my_data = (struct thread_data_neonising *) threadarg;
+    int64_t begin = timingNow();
+    int width = my_data->width;
+
+    //the last 3 equalised rows and the magnitude of the middle one
+    uint8_t* ring = (uint8_t*)malloc(NEONISING_SOBEL_ROWS*(width + 2) + width);
+    uint8_t* magnitude = ring + NEONISING_SOBEL_ROWS*(width + 2);
+
+    if (ring == 0)
+        return;
+
+    //the row above the band, shared with the band before so worked out again here
+    equalisedRowInto(my_data, ring, startRow - 1);
+    equalisedRowInto(my_data, ring, startRow);
+
+    for (int y = startRow; y < stopRow; y++) {
+        equalisedRowInto(my_data, ring, y + 1);
+
+        const uint8_t* rows[NEONISING_SOBEL_ROWS];
+        for (int k = 0; k < NEONISING_SOBEL_ROWS; k++)
+            rows[k] = ring + ((y + k) % NEONISING_SOBEL_ROWS)*(width + 2) + 1;
+
+        int x = my_data->sobelRow ? my_data->sobelRow(rows, magnitude, width) : 0;
+        sobelMagnitudePixels(rows, magnitude, x, width);
+
+        const uint8_t* equalised = rows[1];
+        uint8_t* dst = my_data->dst + y*my_data->dstStep;
+
+        for (x = 0; x < width; x++, dst += 3) {
+            uint8_t mag = magnitude[x];
+
+            if (mag >= NEONISING_EDGE_THRESHOLD) {
+                dst[0] = my_data->palette[mag][0];
+                dst[1] = my_data->palette[mag][1];
+                dst[2] = my_data->palette[mag][2];
+            }else{
+                dst[0] = dst[1] = dst[2] = equalised[x] >> NEONISING_BACKGROUND_SHIFT;
+            }
+        }
+    }
+
+    free(ring);
+
+    recordTimingSpan(TIMING_STAGE_KERNEL, worker, begin);
+}
+
+/*
+ * Private functions
+ */
+
+//the table cvEqualizeHist builds: the share of the image at or below each
+//level, stretched over 0-255. Same float scale and round to even as it uses,
+//so the levels come out identical
+static void buildEqualiseTable(struct thread_data_neonising* my_data){
+    float scale = 255.f/(my_data->width*my_data->height);
+    int sum = 0;
+
+    for (int i = 0; i < 256; i++) {
+        for (int band = 0; band < my_data->bands; band++)
+            sum += my_data->histograms[band][i];
+
+        my_data->equalise[i] = (uint8_t)lrintf(sum*scale);
+    }
+
+    my_data->equalise[0] = 0;
+}
+
+//outer at the threshold up to inner at full strength
+static void buildPalette(struct thread_data_neonising* my_data, int inner, int outer){
+    const uint8_t* in = neonisingColour(inner);
+    const uint8_t* out = neonisingColour(outer);
+    int span = 255 - NEONISING_EDGE_THRESHOLD;
+
+    memset(my_data->palette, 0, sizeof(my_data->palette));
+
+    for (int mag = NEONISING_EDGE_THRESHOLD; mag < 256; mag++) {
+        int t = mag - NEONISING_EDGE_THRESHOLD;
+
+        for (int c = 0; c < 3; c++)
+            my_data->palette[mag][c] = (uint8_t)((out[c]*(span - t) + in[c]*t + span/2)/span);
+    }
+}
+
+/*
+ * Public functions
+ */
+
+const uint8_t* neonisingColour(int colour){
+    if (colour < 0 || colour >= NEONISING_COLOURS)
+        colour = NEONISING_TURQUOISE;
+
+    return neonColours[colour];
+}
+
+void neonisingImage(const uint8_t* src, int srcStep, int srcChannels,
+                    uint8_t* grey, int greyStep, uint8_t* dst, int dstStep,
+                    int width, int height, bool rgba, int inner, int outer){
+    struct thread_data_neonising neonising_data;
+    //look the kernel up once so a backend switch can't land mid frame
+    neonising_data.sobelRow = getFilterKernels()->sobelMagnitudeRow;
+    neonising_data.src = src;
+    neonising_data.srcStep = srcStep;
+    neonising_data.srcChannels = srcChannels;
+    neonising_data.grey = grey;
+    neonising_data.greyStep = greyStep;
+    neonising_data.dst = dst;
+    neonising_data.dstStep = dstStep;
+    neonising_data.width = width;
+    neonising_data.height = height;
+    neonising_data.rgba = rgba;
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    //a band per worker, each with its own histogram so they never share a count
+    int bands = WorkerPool::GetShared()->GetActiveWorkers();
+    if (bands > height)
+        bands = height;
+    if (bands < 1)
+        bands = 1;
+    neonising_data.bands = bands;
+
+    neonising_data.histograms = (uint32_t (*)[256])malloc(bands*256*sizeof(uint32_t));
+    if (neonising_data.histograms == 0)
+        return;
+
+    WorkerPool::GetShared()->ParallelFor(bands, doThreadGruntworkNeonisingGrey, (void*)&neonising_data);
+
+    buildEqualiseTable(&neonising_data);
+    buildPalette(&neonising_data, inner, outer);
+    free(neonising_data.histograms);
+
+    WorkerPool::GetShared()->ParallelFor(height, doThreadGruntworkNeonisingEdges, (void*)&neonising_data);
+}
@@ -0,0 +1,60 @@
+//
+//  NeonisingEngine.h
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#ifndef FaceIt_NeonisingEngine_h
+#define FaceIt_NeonisingEngine_h
+
+#include <stdint.h>
+
+/*
+ * The neonising effect: the edges of the picture lit up in neon colours over
+ * a darkened grey copy of it.
+ *
+ * Two passes over the frame, each one split into bands across the worker pool:
+ *
+ *   1. the grey of every pixel (see GrayscaleEngine.h) into a 1 channel plane,
+ *      with a histogram per band on the side. The bands' histograms are added
+ *      up into an equalisation table, the same one cvEqualizeHist would use.
+ *   2. each band keeps the last 3 equalised grey rows in a ring, takes the
+ *      3x3 sobel magnitude
+ *        mag = (|gx| + |gy|) >> NEONISING_SOBEL_SHIFT, saturated to 255
+ *      of the middle one and looks every pixel up in a palette: edges (mag at
+ *      least NEONISING_EDGE_THRESHOLD) go from the outer colour on faint
+ *      edges to the inner colour on the strongest ones, everything else is
+ *      the equalised grey at a quarter brightness.
+ *
+ * Equalising first means the one threshold works for dark and bright frames
+ * alike. Edge pixels are repeated past the border for the sobel.
+ */
+
+#define NEONISING_SOBEL_SHIFT       2
+#define NEONISING_EDGE_THRESHOLD    40
+#define NEONISING_BACKGROUND_SHIFT  2
+
+//the neon light colours the palette is picked from
+enum {
+    NEONISING_TURQUOISE = 0,
+    NEONISING_LEMON,
+    NEONISING_SPRING,
+    NEONISING_MAGENTA,
+    NEONISING_LIME,
+    NEONISING_TANGERINE,
+    NEONISING_COLOURS
+};
+
+//one of the NEONISING_COLOURS as BGR
+const uint8_t* neonisingColour(int colour);
+
+//neonise a whole image. src is 3 or 4 channels (rgba is the byte order, see
+//GrayscaleEngine.h), grey is a width x height 1 channel scratch plane and
+//dst is 3 channel BGR, which can't be src. inner and outer are
+//NEONISING_COLOURS for the strongest and the faintest edges
+void neonisingImage(const uint8_t* src, int srcStep, int srcChannels,
+                    uint8_t* grey, int greyStep, uint8_t* dst, int dstStep,
+                    int width, int height, bool rgba, int inner, int outer);
+
+#endif
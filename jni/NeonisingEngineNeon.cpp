@@ -0,0 +1,42 @@
+//
+//  NeonisingEngineNeon.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+// Built with -mfpu=neon on armeabi-v7a only (see Android.mk), and only ever
+// reached through FilterBackend once cpufeatures has seen neon on the device.
+
+#include "FilterBackend.h"
+#include "NeonisingEngine.h"
+
+#if defined(HAVE_NEON) && defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+//8 pixels a go off unaligned loads either side. The sums are widened to 16
+//bits with vaddl/vshll, and vqshrn does the shift and the saturation at once
+int sobelMagnitudeRowNeon(const uint8_t* const* rows, uint8_t* dst, int width){
+    int x = 0;
+    for (; x <= width - 8; x += 8) {
+        uint8x8_t a0 = vld1_u8(rows[0]+x-1), b0 = vld1_u8(rows[0]+x), c0 = vld1_u8(rows[0]+x+1);
+        uint8x8_t a1 = vld1_u8(rows[1]+x-1), c1 = vld1_u8(rows[1]+x+1);
+        uint8x8_t a2 = vld1_u8(rows[2]+x-1), b2 = vld1_u8(rows[2]+x), c2 = vld1_u8(rows[2]+x+1);
+
+        uint16x8_t right = vaddq_u16(vaddl_u8(c0, c2), vshll_n_u8(c1, 1));
+        uint16x8_t left = vaddq_u16(vaddl_u8(a0, a2), vshll_n_u8(a1, 1));
+        uint16x8_t below = vaddq_u16(vaddl_u8(a2, c2), vshll_n_u8(b2, 1));
+        uint16x8_t above = vaddq_u16(vaddl_u8(a0, c0), vshll_n_u8(b0, 1));
+
+        int16x8_t gx = vsubq_s16(vreinterpretq_s16_u16(right), vreinterpretq_s16_u16(left));
+        int16x8_t gy = vsubq_s16(vreinterpretq_s16_u16(below), vreinterpretq_s16_u16(above));
+        uint16x8_t mag = vaddq_u16(vreinterpretq_u16_s16(vabsq_s16(gx)),
+                                   vreinterpretq_u16_s16(vabsq_s16(gy)));
+
+        vst1_u8(dst+x, vqshrn_n_u16(mag, NEONISING_SOBEL_SHIFT));
+    }
+    return x;
+}
+
+#endif
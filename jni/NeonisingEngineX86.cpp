@@ -0,0 +1,65 @@
+//
+//  NeonisingEngineX86.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+// Built for its instruction set with a target attribute like SepiaEngineX86.cpp,
+// pabsw is the only ssse3 instruction in it. avx2 inherits it from FilterBackend.
+
+#include "FilterBackend.h"
+#include "NeonisingEngine.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+//|gx| + |gy| of 8 pixels, already widened to 16 bits. a, b and c are the
+//pixels left of, under and right of each one, in the rows above (0), on (1)
+//and below (2). The most it can come to is 2040, so 16 bits is plenty
+__attribute__((target("ssse3")))
+static inline __m128i sobel8(__m128i a0, __m128i b0, __m128i c0, __m128i a1, __m128i c1,
+                             __m128i a2, __m128i b2, __m128i c2){
+    __m128i right = _mm_add_epi16(_mm_add_epi16(c0, c2), _mm_add_epi16(c1, c1));
+    __m128i left = _mm_add_epi16(_mm_add_epi16(a0, a2), _mm_add_epi16(a1, a1));
+    __m128i below = _mm_add_epi16(_mm_add_epi16(a2, c2), _mm_add_epi16(b2, b2));
+    __m128i above = _mm_add_epi16(_mm_add_epi16(a0, c0), _mm_add_epi16(b0, b0));
+
+    __m128i mag = _mm_add_epi16(_mm_abs_epi16(_mm_sub_epi16(right, left)),
+                                _mm_abs_epi16(_mm_sub_epi16(below, above)));
+
+    return _mm_srli_epi16(mag, NEONISING_SOBEL_SHIFT);
+}
+
+//16 pixels a go off unaligned loads either side, packus does the saturation
+__attribute__((target("ssse3")))
+int sobelMagnitudeRowSSSE3(const uint8_t* const* rows, uint8_t* dst, int width){
+    const __m128i zero = _mm_setzero_si128();
+
+    int x = 0;
+    for (; x <= width - 16; x += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(rows[0]+x-1));
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(rows[0]+x));
+        __m128i c0 = _mm_loadu_si128((const __m128i*)(rows[0]+x+1));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(rows[1]+x-1));
+        __m128i c1 = _mm_loadu_si128((const __m128i*)(rows[1]+x+1));
+        __m128i a2 = _mm_loadu_si128((const __m128i*)(rows[2]+x-1));
+        __m128i b2 = _mm_loadu_si128((const __m128i*)(rows[2]+x));
+        __m128i c2 = _mm_loadu_si128((const __m128i*)(rows[2]+x+1));
+
+        __m128i lo = sobel8(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero),
+                            _mm_unpacklo_epi8(c0, zero), _mm_unpacklo_epi8(a1, zero),
+                            _mm_unpacklo_epi8(c1, zero), _mm_unpacklo_epi8(a2, zero),
+                            _mm_unpacklo_epi8(b2, zero), _mm_unpacklo_epi8(c2, zero));
+        __m128i hi = sobel8(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero),
+                            _mm_unpackhi_epi8(c0, zero), _mm_unpackhi_epi8(a1, zero),
+                            _mm_unpackhi_epi8(c1, zero), _mm_unpackhi_epi8(a2, zero),
+                            _mm_unpackhi_epi8(b2, zero), _mm_unpackhi_epi8(c2, zero));
+
+        _mm_storeu_si128((__m128i*)(dst+x), _mm_packus_epi16(lo, hi));
+    }
+    return x;
+}
+
+#endif
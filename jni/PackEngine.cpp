@@ -0,0 +1,99 @@
+//
+//  PackEngine.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#include "PackEngine.h"
+#include "FilterBackend.h"
+#include "WorkerPool.h"
+
+/*
+ * Private kernels
+ */
+
+//scalar version, also used to finish off the last few pixels of each row
+static inline void packPixels(const uint8_t* src, uint8_t* dst, int count, int b, int r){
+    for (int x = 0; x < count; x++) {
+        dst[b] = src[0];
+        dst[1] = src[1];
+        dst[r] = src[2];
+        dst[3] = 255;
+
+        src += 3;
+        dst += 4;
+    }
+}
+
+//grey goes into all three colour channels, so byte order doesn't matter
+static inline void packGreyPixels(const uint8_t* src, uint8_t* dst, int count){
+    for (int x = 0; x < count; x++) {
+        dst[0] = dst[1] = dst[2] = src[x];
+        dst[3] = 255;
+
+        dst += 4;
+    }
+}
+
+static inline void packRowWith(PackRowKernel kernel, const uint8_t* src, int channels,
+                               uint8_t* dst, int width, bool rgba){
+    if (channels == 1) {
+        packGreyPixels(src, dst, width);
+        return;
+    }
+
+    int x = 0;
+
+    //vector kernel for this backend, if it has one
+    if (kernel)
+        x = kernel(src, dst, width, rgba);
+
+    //whatever is left over after the last full vector
+    packPixels(src + x*3, dst + x*4, width - x, rgba ? 2 : 0, rgba ? 0 : 2);
+}
+
+struct thread_data_pack
+{
+    PackRowKernel kernel;
+    const uint8_t *src;
+    int srcStep;
+    int channels;
+    uint8_t *dst;
+    int dstStep;
+    int width;
+    bool rgba;
+};
+
+static void doThreadGruntworkPack(void*threadarg, int startRow, int stopRow, int worker){
+    struct thread_data_pack *my_data = (struct thread_data_pack *) threadarg;
+
+    for (int y = startRow; y < stopRow; y++) {
+        packRowWith(my_data->kernel, my_data->src + y*my_data->srcStep, my_data->channels,
+                    my_data->dst + y*my_data->dstStep, my_data->width, my_data->rgba);
+    }
+}
+
+/*
+ * Public functions
+ */
+
+void packRowToArgb(const uint8_t* src, int channels, uint8_t* dst, int width, bool rgba){
+    packRowWith(getFilterKernels()->packArgbRow, src, channels, dst, width, rgba);
+}
+
+void packImageToArgb(const uint8_t* src, int srcStep, int channels,
+                     uint8_t* dst, int dstStep, int width, int height, bool rgba){
+    struct thread_data_pack pack_data;
+    //look the kernel up once so a backend switch can't land mid frame
+    pack_data.kernel = getFilterKernels()->packArgbRow;
+    pack_data.src = src;
+    pack_data.srcStep = srcStep;
+    pack_data.channels = channels;
+    pack_data.dst = dst;
+    pack_data.dstStep = dstStep;
+    pack_data.width = width;
+    pack_data.rgba = rgba;
+
+    WorkerPool::GetShared()->ParallelFor(height, doThreadGruntworkPack, (void*)&pack_data);
+}
@@ -0,0 +1,30 @@
+//
+//  PackEngine.h
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#ifndef FaceIt_PackEngine_h
+#define FaceIt_PackEngine_h
+
+#include <stdint.h>
+
+/*
+ * Packing the 8 bit BGR (or grey) images the filters leave behind into the 32
+ * bit pixels java draws, so a result can go straight into an int[] or a
+ * Bitmap instead of being BMP encoded here and decoded again on the java side.
+ *
+ * Alpha always comes out 255. rgba picks the byte order of the output:
+ * R,G,B,A in memory is an android Bitmap (ARGB_8888), otherwise it's B,G,R,A,
+ * which is what a java int of 0xAARRGGBB looks like on a little endian cpu.
+ */
+
+//pack a single row of width pixels, channels is 3 (BGR) or 1 (grey)
+void packRowToArgb(const uint8_t* src, int channels, uint8_t* dst, int width, bool rgba);
+
+//pack a whole image, with the rows shared out across the worker pool
+void packImageToArgb(const uint8_t* src, int srcStep, int channels,
+                     uint8_t* dst, int dstStep, int width, int height, bool rgba);
+
+#endif
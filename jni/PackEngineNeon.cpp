@@ -0,0 +1,43 @@
+//
+//  PackEngineNeon.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+// Built with -mfpu=neon on armeabi-v7a only (see Android.mk), and only ever
+// reached through FilterBackend once cpufeatures has seen neon on the device.
+
+#include "FilterBackend.h"
+
+#if defined(HAVE_NEON) && defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+//16 pixels a go, vld3 splits the channels and vst4 puts them back with alpha
+int packArgbRowNeon(const uint8_t* src, uint8_t* dst, int width, bool rgba){
+    uint8x16x4_t out;
+    out.val[3] = vdupq_n_u8(255);
+
+    int x = 0;
+    for (; x <= width - 16; x += 16) {
+        uint8x16x3_t bgr = vld3q_u8(src);
+
+        //constant indices keep everything in q registers
+        if (rgba) {
+            out.val[0] = bgr.val[2];
+            out.val[2] = bgr.val[0];
+        }else{
+            out.val[0] = bgr.val[0];
+            out.val[2] = bgr.val[2];
+        }
+        out.val[1] = bgr.val[1];
+
+        vst4q_u8(dst, out);
+        src += 48;
+        dst += 64;
+    }
+    return x;
+}
+
+#endif
@@ -0,0 +1,50 @@
+//
+//  PackEngineX86.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+// Built for its instruction set with a target attribute like SepiaEngineX86.cpp.
+// There's no avx2 version, the pack is bound by the stores and FilterBackend
+// hands avx2 the ssse3 kernel.
+
+#include "FilterBackend.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+//16 pixels a go. Each 12 byte group of 4 source pixels is lined up at the
+//start of a register with palignr, then one pshufb spreads it out to 16 bytes
+__attribute__((target("ssse3")))
+int packArgbRowSSSE3(const uint8_t* src, uint8_t* dst, int width, bool rgba){
+    const __m128i spread = rgba ?
+        _mm_setr_epi8( 2, 1, 0,-1, 5, 4, 3,-1, 8, 7, 6,-1,11,10, 9,-1) :
+        _mm_setr_epi8( 0, 1, 2,-1, 3, 4, 5,-1, 6, 7, 8,-1, 9,10,11,-1);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+
+    int x = 0;
+    for (; x <= width - 16; x += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(src));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(src+16));
+        __m128i a2 = _mm_loadu_si128((const __m128i*)(src+32));
+
+        //source bytes 0, 12, 24 and 36 onwards
+        __m128i p0 = a0;
+        __m128i p1 = _mm_alignr_epi8(a1, a0, 12);
+        __m128i p2 = _mm_alignr_epi8(a2, a1, 8);
+        __m128i p3 = _mm_srli_si128(a2, 4);
+
+        _mm_storeu_si128((__m128i*)(dst),    _mm_or_si128(_mm_shuffle_epi8(p0, spread), alpha));
+        _mm_storeu_si128((__m128i*)(dst+16), _mm_or_si128(_mm_shuffle_epi8(p1, spread), alpha));
+        _mm_storeu_si128((__m128i*)(dst+32), _mm_or_si128(_mm_shuffle_epi8(p2, spread), alpha));
+        _mm_storeu_si128((__m128i*)(dst+48), _mm_or_si128(_mm_shuffle_epi8(p3, spread), alpha));
+
+        src += 48;
+        dst += 64;
+    }
+    return x;
+}
+
+#endif
@@ -0,0 +1,132 @@
+//
+//  ProcessingContext.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#include "ProcessingContext.h"
+
+///////////////////////////// ProcessingContext ////////////////////////////
+
+ProcessingContext::ProcessingContext()
+{
+    m_refCount = 1;
+    m_sourceImage = 0;
+    m_filterChain = 0;
+    m_timeStamp = 0;
+    m_finished = 0;
+}
+
+
+ProcessingContext::~ProcessingContext()
+{
+    if (m_sourceImage)
+        cvReleaseImage(&m_sourceImage);
+
+    delete m_filterChain;
+}
+
+
+void ProcessingContext::Retain()
+{
+    __sync_fetch_and_add(&m_refCount, 1);
+}
+
+
+void ProcessingContext::Release()
+{
+    if (__sync_sub_and_fetch(&m_refCount, 1) == 0)
+        delete this;
+}
+
+
+IplImage* ProcessingContext::GetSourceImage()
+{
+    return m_sourceImage;
+}
+
+
+void ProcessingContext::SetSourceImage(IplImage* image)
+{
+    if (m_sourceImage == image)
+        return;
+
+    m_pool.Release(m_sourceImage);
+    m_sourceImage = image;
+}
+
+
+IplImage* ProcessingContext::TakeSourceImage()
+{
+    IplImage* image = m_sourceImage;
+    m_sourceImage = 0;
+
+    return image;
+}
+
+
+IplImage* ProcessingContext::PrepareSourceImage(CvSize size, int channels)
+{
+    if (m_sourceImage && m_sourceImage->width == size.width && m_sourceImage->height == size.height &&
+        m_sourceImage->depth == IPL_DEPTH_8U && m_sourceImage->nChannels == channels)
+        return m_sourceImage;
+
+    SetSourceImage(m_pool.Detach(m_pool.Acquire(size, IPL_DEPTH_8U, channels)));
+
+    return m_sourceImage;
+}
+
+
+FilterGraph* ProcessingContext::GetFilterChain()
+{
+    return m_filterChain;
+}
+
+
+void ProcessingContext::SetFilterChain(FilterGraph* chain)
+{
+    if (m_filterChain == chain)
+        return;
+
+    delete m_filterChain;
+    m_filterChain = chain;
+}
+
+
+ImagePool* ProcessingContext::GetPool()
+{
+    return &m_pool;
+}
+
+
+WLNonFileByteStream* ProcessingContext::GetByteStream()
+{
+    return &m_byteStream;
+}
+
+
+float ProcessingContext::GetTimeStamp()
+{
+    return m_timeStamp;
+}
+
+
+void ProcessingContext::SetTimeStamp(float timeStamp)
+{
+    m_timeStamp = timeStamp;
+}
+
+
+bool ProcessingContext::HasFinished()
+{
+    //full barriers both ways, so whoever sees it finished also sees the result
+    return __sync_fetch_and_add(&m_finished, 0) != 0;
+}
+
+
+void ProcessingContext::SetFinished(bool finished)
+{
+    __sync_synchronize();
+    __sync_lock_test_and_set(&m_finished, finished ? 1 : 0);
+}
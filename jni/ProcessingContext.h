@@ -0,0 +1,79 @@
+//
+//  ProcessingContext.h
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#ifndef FaceIt_ProcessingContext_h
+#define FaceIt_ProcessingContext_h
+
+#include "cxcore.h"
+#include "ImagePool.h"
+#include "FilterGraph.h"
+#include "WLNonFileByteStream.h"
+
+/*
+ * Everything one run through the pipeline works on: the source image, the
+ * filter chain it goes through, scratch images for the effects and how long
+ * the last run took. Java holds on to one per session (see
+ * createProcessingContext), so several photos or frames can be processed at
+ * once on different threads without sharing any state.
+ *
+ * A context isn't locked, so only one thread should use it at a time.
+ * Apart from HasFinished, Retain and Release, which can be called from anywhere.
+ *
+ * It's reference counted, as queued jobs keep using it after java has let go:
+ * it starts with one reference and goes when Release drops the last.
+ */
+class ProcessingContext {
+public:
+    ProcessingContext();
+
+    void        Retain();
+    void        Release();
+
+    IplImage*   GetSourceImage();
+
+    //the context takes ownership of image, the old source image goes back to
+    //the pool so the next frame of the same size doesn't have to allocate
+    void        SetSourceImage(IplImage* image);
+
+    //hand the source image over to the caller, leaving the context without one
+    IplImage*   TakeSourceImage();
+
+    //a source image of this size and number of channels to write into,
+    //reusing the current one if it already fits
+    IplImage*   PrepareSourceImage(CvSize size, int channels);
+
+    //0 until SetFilterChain, which takes ownership of chain
+    FilterGraph* GetFilterChain();
+    void        SetFilterChain(FilterGraph* chain);
+
+    //scratch images for effects run outside the filter chain
+    ImagePool*  GetPool();
+
+    //where getSourceImage encodes the bmp, it keeps its buffer between frames
+    WLNonFileByteStream* GetByteStream();
+
+    //seconds the last timed operation took
+    float       GetTimeStamp();
+    void        SetTimeStamp(float timeStamp);
+
+    bool        HasFinished();
+    void        SetFinished(bool finished);
+
+protected:
+    //only through Release
+    ~ProcessingContext();
+
+    volatile int    m_refCount;
+    IplImage*       m_sourceImage;
+    FilterGraph*    m_filterChain;
+    ImagePool       m_pool;
+    WLNonFileByteStream m_byteStream;
+    float           m_timeStamp;
+    volatile int    m_finished;
+};
+
+#endif
@@ -0,0 +1,134 @@
+//
+//  SepiaEngine.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#include "SepiaEngine.h"
+#include "FilterBackend.h"
+#include "WorkerPool.h"
+#include "StageTimer.h"
+
+/*
+ * Private kernels
+ */
+
+//scalar version, also used to finish off the last few pixels of each row
+static inline void sepiaTonePixels(uint8_t* ptr, int count){
+    for (int x = 0; x < count; x++) {
+        int p = (ptr[0] + ptr[1] + ptr[2])/3;
+
+        ptr[0] = (uint8_t)(p < 20 ? 0 : p-20);
+        ptr[1] = (uint8_t)(p > 235 ? 255 : p+20);
+        ptr[2] = (uint8_t)(p > 215 ? 255 : p+40);
+
+        ptr += 3;
+    }
+}
+
+//4 channel version, blue and red are at b and r so either byte order works
+static inline void sepiaTonePixels4(uint8_t* ptr, int count, int b, int r){
+    for (int x = 0; x < count; x++) {
+        int p = (ptr[0] + ptr[1] + ptr[2])/3;
+
+        ptr[b] = (uint8_t)(p < 20 ? 0 : p-20);
+        ptr[1] = (uint8_t)(p > 235 ? 255 : p+20);
+        ptr[r] = (uint8_t)(p > 215 ? 255 : p+40);
+
+        ptr += 4;
+    }
+}
+
+static inline void sepiaToneRowWith(SepiaRowKernel kernel, uint8_t* row, int width){
+    int x = 0;
+
+    //vector kernel for this backend, if it has one
+    if (kernel)
+        x = kernel(row, width);
+
+    //whatever is left over after the last full vector
+    sepiaTonePixels(row + x*3, width - x);
+}
+
+struct thread_data_sepia
+{
+    SepiaRowKernel kernel;
+    uint8_t *data;
+    int step;
+    int width;
+};
+
+static void doThreadGruntworkSepia(void*threadarg, int startRow, int stopRow, int worker){
+    struct thread_data_sepia *my_data = (struct thread_data_sepia *) threadarg;
+    int64_t begin = timingNow();
+
+    for (int y = startRow; y < stopRow; y++) {
+        sepiaToneRowWith(my_data->kernel, my_data->data + y*my_data->step, my_data->width);
+    }
+
+    recordTimingSpan(TIMING_STAGE_KERNEL, worker, begin);
+}
+
+struct thread_data_sepia4
+{
+    uint8_t *data;
+    int step;
+    int width;
+    int b;
+    int r;
+};
+
+static void doThreadGruntworkSepia4(void*threadarg, int startRow, int stopRow, int worker){
+    struct thread_data_sepia4 *my_data = (struct thread_data_sepia4 *) threadarg;
+    int64_t begin = timingNow();
+
+    for (int y = startRow; y < stopRow; y++) {
+        sepiaTonePixels4(my_data->data + y*my_data->step, my_data->width, my_data->b, my_data->r);
+    }
+
+    recordTimingSpan(TIMING_STAGE_KERNEL, worker, begin);
+}
+
+/*
+ * Public functions
+ */
+
+void sepiaToneRow(uint8_t* row, int width){
+    sepiaToneRowWith(getFilterKernels()->sepiaToneRow, row, width);
+}
+
+void sepiaToneRow4(uint8_t* row, int width, bool rgba){
+    sepiaTonePixels4(row, width, rgba ? 2 : 0, rgba ? 0 : 2);
+}
+
+void sepiaToneRows(uint8_t* data, int step, int width, int startRow, int stopRow){
+    SepiaRowKernel kernel = getFilterKernels()->sepiaToneRow;
+
+    for (int y = startRow; y < stopRow; y++) {
+        sepiaToneRowWith(kernel, data + y*step, width);
+    }
+}
+
+void sepiaToneImage(uint8_t* data, int step, int width, int height){
+    struct thread_data_sepia sepia_data;
+    //look the kernel up once so a backend switch can't land mid frame
+    sepia_data.kernel = getFilterKernels()->sepiaToneRow;
+    sepia_data.data = data;
+    sepia_data.step = step;
+    sepia_data.width = width;
+
+    //hand out whole rows so every worker streams its own contiguous band
+    WorkerPool::GetShared()->ParallelFor(height, doThreadGruntworkSepia, (void*)&sepia_data);
+}
+
+void sepiaToneImage4(uint8_t* data, int step, int width, int height, bool rgba){
+    struct thread_data_sepia4 sepia_data;
+    sepia_data.data = data;
+    sepia_data.step = step;
+    sepia_data.width = width;
+    sepia_data.b = rgba ? 2 : 0;
+    sepia_data.r = rgba ? 0 : 2;
+
+    WorkerPool::GetShared()->ParallelFor(height, doThreadGruntworkSepia4, (void*)&sepia_data);
+}
@@ -0,0 +1,41 @@
+//
+//  SepiaEngine.h
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#ifndef FaceIt_SepiaEngine_h
+#define FaceIt_SepiaEngine_h
+
+#include <stdint.h>
+
+/*
+ * Single pass sepia toning straight on interleaved 8 bit BGR rows.
+ * Nothing is deinterleaved into scratch planes, every pixel is read once and
+ * written once, and rows are walked with the image step so padded
+ * (widthStep != width*3) images work as is.
+ *
+ * The result matches applySepiaToneWithDirectPixelManipulations exactly:
+ *   p = (b+g+r)/3
+ *   b = max(p-20, 0), g = min(p+20, 255), r = min(p+40, 255)
+ */
+
+//tone a single row of width pixels in place
+void sepiaToneRow(uint8_t* row, int width);
+
+//tone a single row of width 4 channel pixels in place, see sepiaToneImage4
+void sepiaToneRow4(uint8_t* row, int width, bool rgba);
+
+//tone rows [startRow, stopRow) of an image in place on the calling thread
+void sepiaToneRows(uint8_t* data, int step, int width, int startRow, int stopRow);
+
+//tone a whole image in place, with the rows shared out across the worker pool
+void sepiaToneImage(uint8_t* data, int step, int width, int height);
+
+//same again for 4 channel pixels, alpha is left alone. rgba is the byte order
+//of an android Bitmap (ARGB_8888 in java, R,G,B,A in memory), otherwise the
+//pixels are BGRA like a 4 channel IplImage
+void sepiaToneImage4(uint8_t* data, int step, int width, int height, bool rgba);
+
+#endif
@@ -0,0 +1,52 @@
+//
+//  SepiaEngineNeon.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+// Built with -mfpu=neon on armeabi-v7a only (see Android.mk), and only ever
+// reached through FilterBackend once cpufeatures has seen neon on the device.
+
+#include "FilterBackend.h"
+
+#if defined(HAVE_NEON) && defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+//16 pixels a go, vld3/vst3 do the (de)interleaving for free
+int sepiaToneRowNeon(uint8_t* row, int width){
+    uint8x16_t bfac = vdupq_n_u8(20);
+    uint8x16_t gfac = vdupq_n_u8(20);
+    uint8x16_t rfac = vdupq_n_u8(40);
+
+    int x = 0;
+    for (; x <= width - 16; x += 16) {
+        uint8x16x3_t bgr = vld3q_u8(row);
+
+        //widen and add all channels together
+        uint16x8_t sumLo = vaddw_u8(vaddl_u8(vget_low_u8(bgr.val[0]), vget_low_u8(bgr.val[1])),
+                                    vget_low_u8(bgr.val[2]));
+        uint16x8_t sumHi = vaddw_u8(vaddl_u8(vget_high_u8(bgr.val[0]), vget_high_u8(bgr.val[1])),
+                                    vget_high_u8(bgr.val[2]));
+
+        //divide by 3 -> (sum*21846) >> 16, exact for every sum up to 3*255
+        uint16x4_t q0 = vshrn_n_u32(vmull_n_u16(vget_low_u16(sumLo), 21846), 16);
+        uint16x4_t q1 = vshrn_n_u32(vmull_n_u16(vget_high_u16(sumLo), 21846), 16);
+        uint16x4_t q2 = vshrn_n_u32(vmull_n_u16(vget_low_u16(sumHi), 21846), 16);
+        uint16x4_t q3 = vshrn_n_u32(vmull_n_u16(vget_high_u16(sumHi), 21846), 16);
+        uint8x16_t ins = vcombine_u8(vmovn_u16(vcombine_u16(q0, q1)),
+                                     vmovn_u16(vcombine_u16(q2, q3)));
+
+        //add sepia weights, saturation does the boundary checks
+        bgr.val[0] = vqsubq_u8(ins, bfac);
+        bgr.val[1] = vqaddq_u8(ins, gfac);
+        bgr.val[2] = vqaddq_u8(ins, rfac);
+
+        vst3q_u8(row, bgr);
+        row += 48;
+    }
+    return x;
+}
+
+#endif
@@ -0,0 +1,169 @@
+//
+//  SepiaEngineX86.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+// Each kernel is compiled for its own instruction set with a target attribute,
+// so the rest of the library stays baseline x86 and FilterBackend decides at
+// runtime which of these the cpu can take.
+
+#include "FilterBackend.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+//16 pixels (3 registers) a go, pshufb does the (de)interleaving
+__attribute__((target("ssse3")))
+int sepiaToneRowSSSE3(uint8_t* row, int width){
+    //gather each channel out of the three loaded registers
+    const __m128i b0 = _mm_setr_epi8( 0, 3, 6, 9,12,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+    const __m128i b1 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1, 2, 5, 8,11,14,-1,-1,-1,-1,-1);
+    const __m128i b2 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 1, 4, 7,10,13);
+    const __m128i g0 = _mm_setr_epi8( 1, 4, 7,10,13,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+    const __m128i g1 = _mm_setr_epi8(-1,-1,-1,-1,-1, 0, 3, 6, 9,12,15,-1,-1,-1,-1,-1);
+    const __m128i g2 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 2, 5, 8,11,14);
+    const __m128i r0 = _mm_setr_epi8( 2, 5, 8,11,14,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+    const __m128i r1 = _mm_setr_epi8(-1,-1,-1,-1,-1, 1, 4, 7,10,13,-1,-1,-1,-1,-1,-1);
+    const __m128i r2 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 3, 6, 9,12,15);
+
+    //every output channel is the same intensity plus or minus a constant, so
+    //spread the intensity back out 3 times and tone every byte at once
+    const __m128i spread0 = _mm_setr_epi8( 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    const __m128i spread1 = _mm_setr_epi8( 5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9,10,10);
+    const __m128i spread2 = _mm_setr_epi8(10,11,11,11,12,12,12,13,13,13,14,14,14,15,15,15);
+
+    //per byte sepia weights for the b,g,r,b,g,r,... pattern of each register
+    const __m128i add0 = _mm_setr_epi8( 0,20,40, 0,20,40, 0,20,40, 0,20,40, 0,20,40, 0);
+    const __m128i add1 = _mm_setr_epi8(20,40, 0,20,40, 0,20,40, 0,20,40, 0,20,40, 0,20);
+    const __m128i add2 = _mm_setr_epi8(40, 0,20,40, 0,20,40, 0,20,40, 0,20,40, 0,20,40);
+    const __m128i sub0 = _mm_setr_epi8(20, 0, 0,20, 0, 0,20, 0, 0,20, 0, 0,20, 0, 0,20);
+    const __m128i sub1 = _mm_setr_epi8( 0, 0,20, 0, 0,20, 0, 0,20, 0, 0,20, 0, 0,20, 0);
+    const __m128i sub2 = _mm_setr_epi8( 0,20, 0, 0,20, 0, 0,20, 0, 0,20, 0, 0,20, 0, 0);
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i third = _mm_set1_epi16((short)0xAAAB);
+
+    int x = 0;
+    for (; x <= width - 16; x += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(row));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(row+16));
+        __m128i a2 = _mm_loadu_si128((const __m128i*)(row+32));
+
+        __m128i blu = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, b0), _mm_shuffle_epi8(a1, b1)),
+                                   _mm_shuffle_epi8(a2, b2));
+        __m128i grn = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, g0), _mm_shuffle_epi8(a1, g1)),
+                                   _mm_shuffle_epi8(a2, g2));
+        __m128i red = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, r0), _mm_shuffle_epi8(a1, r1)),
+                                   _mm_shuffle_epi8(a2, r2));
+
+        //widen and add all channels together
+        __m128i sumLo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(blu, zero),
+                                                    _mm_unpacklo_epi8(grn, zero)),
+                                      _mm_unpacklo_epi8(red, zero));
+        __m128i sumHi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(blu, zero),
+                                                    _mm_unpackhi_epi8(grn, zero)),
+                                      _mm_unpackhi_epi8(red, zero));
+
+        //divide by 3 -> (sum*0xAAAB) >> 17, exact for any 16 bit sum
+        sumLo = _mm_srli_epi16(_mm_mulhi_epu16(sumLo, third), 1);
+        sumHi = _mm_srli_epi16(_mm_mulhi_epu16(sumHi, third), 1);
+        __m128i ins = _mm_packus_epi16(sumLo, sumHi);
+
+        //add sepia weights, saturation does the boundary checks
+        a0 = _mm_subs_epu8(_mm_adds_epu8(_mm_shuffle_epi8(ins, spread0), add0), sub0);
+        a1 = _mm_subs_epu8(_mm_adds_epu8(_mm_shuffle_epi8(ins, spread1), add1), sub1);
+        a2 = _mm_subs_epu8(_mm_adds_epu8(_mm_shuffle_epi8(ins, spread2), add2), sub2);
+
+        _mm_storeu_si128((__m128i*)(row), a0);
+        _mm_storeu_si128((__m128i*)(row+16), a1);
+        _mm_storeu_si128((__m128i*)(row+32), a2);
+        row += 48;
+    }
+    return x;
+}
+
+//32 pixels a go, two 48 byte blocks side by side in the two 128 bit lanes.
+//pshufb can't cross lanes, so each lane is just the ssse3 kernel above
+__attribute__((target("avx2")))
+int sepiaToneRowAVX2(uint8_t* row, int width){
+    #define LANES(a) _mm256_broadcastsi128_si256(a)
+    const __m256i b0 = LANES(_mm_setr_epi8( 0, 3, 6, 9,12,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1));
+    const __m256i b1 = LANES(_mm_setr_epi8(-1,-1,-1,-1,-1,-1, 2, 5, 8,11,14,-1,-1,-1,-1,-1));
+    const __m256i b2 = LANES(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 1, 4, 7,10,13));
+    const __m256i g0 = LANES(_mm_setr_epi8( 1, 4, 7,10,13,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1));
+    const __m256i g1 = LANES(_mm_setr_epi8(-1,-1,-1,-1,-1, 0, 3, 6, 9,12,15,-1,-1,-1,-1,-1));
+    const __m256i g2 = LANES(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 2, 5, 8,11,14));
+    const __m256i r0 = LANES(_mm_setr_epi8( 2, 5, 8,11,14,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1));
+    const __m256i r1 = LANES(_mm_setr_epi8(-1,-1,-1,-1,-1, 1, 4, 7,10,13,-1,-1,-1,-1,-1,-1));
+    const __m256i r2 = LANES(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 3, 6, 9,12,15));
+
+    const __m256i spread0 = LANES(_mm_setr_epi8( 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5));
+    const __m256i spread1 = LANES(_mm_setr_epi8( 5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9,10,10));
+    const __m256i spread2 = LANES(_mm_setr_epi8(10,11,11,11,12,12,12,13,13,13,14,14,14,15,15,15));
+
+    const __m256i add0 = LANES(_mm_setr_epi8( 0,20,40, 0,20,40, 0,20,40, 0,20,40, 0,20,40, 0));
+    const __m256i add1 = LANES(_mm_setr_epi8(20,40, 0,20,40, 0,20,40, 0,20,40, 0,20,40, 0,20));
+    const __m256i add2 = LANES(_mm_setr_epi8(40, 0,20,40, 0,20,40, 0,20,40, 0,20,40, 0,20,40));
+    const __m256i sub0 = LANES(_mm_setr_epi8(20, 0, 0,20, 0, 0,20, 0, 0,20, 0, 0,20, 0, 0,20));
+    const __m256i sub1 = LANES(_mm_setr_epi8( 0, 0,20, 0, 0,20, 0, 0,20, 0, 0,20, 0, 0,20, 0));
+    const __m256i sub2 = LANES(_mm_setr_epi8( 0,20, 0, 0,20, 0, 0,20, 0, 0,20, 0, 0,20, 0, 0));
+    #undef LANES
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i third = _mm256_set1_epi16((short)0xAAAB);
+
+    int x = 0;
+    for (; x <= width - 32; x += 32) {
+        //pixels 0-15 in the low lane, 16-31 in the high lane
+        __m256i a0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(row))),
+                                             _mm_loadu_si128((const __m128i*)(row+48)), 1);
+        __m256i a1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(row+16))),
+                                             _mm_loadu_si128((const __m128i*)(row+64)), 1);
+        __m256i a2 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(row+32))),
+                                             _mm_loadu_si128((const __m128i*)(row+80)), 1);
+
+        __m256i blu = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a0, b0), _mm256_shuffle_epi8(a1, b1)),
+                                      _mm256_shuffle_epi8(a2, b2));
+        __m256i grn = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a0, g0), _mm256_shuffle_epi8(a1, g1)),
+                                      _mm256_shuffle_epi8(a2, g2));
+        __m256i red = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a0, r0), _mm256_shuffle_epi8(a1, r1)),
+                                      _mm256_shuffle_epi8(a2, r2));
+
+        //widen and add all channels together (unpack stays inside each lane)
+        __m256i sumLo = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(blu, zero),
+                                                          _mm256_unpacklo_epi8(grn, zero)),
+                                         _mm256_unpacklo_epi8(red, zero));
+        __m256i sumHi = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(blu, zero),
+                                                          _mm256_unpackhi_epi8(grn, zero)),
+                                         _mm256_unpackhi_epi8(red, zero));
+
+        //divide by 3 -> (sum*0xAAAB) >> 17, exact for any 16 bit sum
+        sumLo = _mm256_srli_epi16(_mm256_mulhi_epu16(sumLo, third), 1);
+        sumHi = _mm256_srli_epi16(_mm256_mulhi_epu16(sumHi, third), 1);
+        __m256i ins = _mm256_packus_epi16(sumLo, sumHi);
+
+        //add sepia weights, saturation does the boundary checks
+        a0 = _mm256_subs_epu8(_mm256_adds_epu8(_mm256_shuffle_epi8(ins, spread0), add0), sub0);
+        a1 = _mm256_subs_epu8(_mm256_adds_epu8(_mm256_shuffle_epi8(ins, spread1), add1), sub1);
+        a2 = _mm256_subs_epu8(_mm256_adds_epu8(_mm256_shuffle_epi8(ins, spread2), add2), sub2);
+
+        _mm_storeu_si128((__m128i*)(row),    _mm256_castsi256_si128(a0));
+        _mm_storeu_si128((__m128i*)(row+16), _mm256_castsi256_si128(a1));
+        _mm_storeu_si128((__m128i*)(row+32), _mm256_castsi256_si128(a2));
+        _mm_storeu_si128((__m128i*)(row+48), _mm256_extracti128_si256(a0, 1));
+        _mm_storeu_si128((__m128i*)(row+64), _mm256_extracti128_si256(a1, 1));
+        _mm_storeu_si128((__m128i*)(row+80), _mm256_extracti128_si256(a2, 1));
+        row += 96;
+    }
+
+    //one more 16 pixel block if it fits
+    if (x <= width - 16)
+        x += sepiaToneRowSSSE3(row, 16);
+
+    return x;
+}
+
+#endif
@@ -0,0 +1,156 @@
+//
+//  SketchEngine.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#include "SketchEngine.h"
+#include "GrayscaleEngine.h"
+#include "FilterBackend.h"
+#include "WorkerPool.h"
+#include "StageTimer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SKETCH_BLUR_TAPS    (2*SKETCH_BLUR_RADIUS + 1)
+
+/*
+ * Private kernels
+ */
+
+//scalar versions, also used to finish off the last few pixels of each row
+static inline void sketchBlurColumnPixels(const uint8_t* const* rows, uint8_t* dst, int start, int width){
+    for (int x = start; x < width; x++) {
+        int sum = SKETCH_BLUR_W0*rows[3][x] +
+                  SKETCH_BLUR_W1*(rows[2][x] + rows[4][x]) +
+                  SKETCH_BLUR_W2*(rows[1][x] + rows[5][x]) +
+                  SKETCH_BLUR_W3*(rows[0][x] + rows[6][x]);
+
+        dst[x] = (uint8_t)((sum + 128) >> 8);
+    }
+}
+
+static inline void sketchDodgePixels(const uint8_t* blurred, const uint8_t* grey, uint8_t* dst,
+                                     int start, int width){
+    for (int x = start; x < width; x++) {
+        int sum = SKETCH_BLUR_W0*blurred[x] +
+                  SKETCH_BLUR_W1*(blurred[x-1] + blurred[x+1]) +
+                  SKETCH_BLUR_W2*(blurred[x-2] + blurred[x+2]) +
+                  SKETCH_BLUR_W3*(blurred[x-3] + blurred[x+3]);
+        int blur = (sum + 128) >> 8;
+
+        dst[x] = (uint8_t)(blur > grey[x] ? blur - grey[x] - 1 : 255);
+    }
+}
+
+struct thread_data_sketch
+{
+    SketchBlurKernel blurColumn;
+    SketchDodgeKernel dodgeRow;
+    const uint8_t *src;
+    int srcStep;
+    int srcChannels;
+    uint8_t *dst;
+    int dstStep;
+    int dstChannels;
+    int width;
+    int height;
+    bool rgba;
+};
+
+//grey of source row y (clamped to the image) into its slot in the ring
+static inline uint8_t* greyRowInto(struct thread_data_sketch* my_data, uint8_t* ring, int y){
+    uint8_t* slot = ring + ((y + SKETCH_BLUR_RADIUS) % SKETCH_BLUR_TAPS)*my_data->width;
+    int row = y < 0 ? 0 : (y >= my_data->height ? my_data->height-1 : y);
+
+    grayscaleRow(my_data->src + row*my_data->srcStep, my_data->srcChannels, slot, 1,
+                 my_data->width, my_data->rgba);
+    return slot;
+}
+
+static void doThreadGruntworkSketch(void*threadarg, int startRow, int stopRow, int worker){
+    struct thread_data_sketch *my_data = (struct thread_data_sketch *) threadarg;
+    int64_t begin = timingNow();
+    int width = my_data->width;
+
+    //the last 7 grey rows, the vertical blur of the current one (with the
+    //edge pixels repeated 3 either side) and the sketched row
+    uint8_t* ring = (uint8_t*)malloc(SKETCH_BLUR_TAPS*width + (width + 2*SKETCH_BLUR_RADIUS) + width);
+    uint8_t* blurred = ring + SKETCH_BLUR_TAPS*width + SKETCH_BLUR_RADIUS;
+    uint8_t* sketched = blurred + width + SKETCH_BLUR_RADIUS;
+
+    if (ring == 0)
+        return;
+
+    //rows above the band, shared with the band before so worked out again here
+    for (int y = startRow - SKETCH_BLUR_RADIUS; y < startRow + SKETCH_BLUR_RADIUS; y++)
+        greyRowInto(my_data, ring, y);
+
+    for (int y = startRow; y < stopRow; y++) {
+        greyRowInto(my_data, ring, y + SKETCH_BLUR_RADIUS);
+
+        const uint8_t* rows[SKETCH_BLUR_TAPS];
+        for (int k = 0; k < SKETCH_BLUR_TAPS; k++)
+            rows[k] = ring + ((y + k) % SKETCH_BLUR_TAPS)*width;
+
+        int x = my_data->blurColumn ? my_data->blurColumn(rows, blurred, width) : 0;
+        sketchBlurColumnPixels(rows, blurred, x, width);
+
+        for (int k = 1; k <= SKETCH_BLUR_RADIUS; k++) {
+            blurred[-k] = blurred[0];
+            blurred[width-1+k] = blurred[width-1];
+        }
+
+        const uint8_t* grey = rows[SKETCH_BLUR_RADIUS];
+        uint8_t* out = my_data->dstChannels == 1 ? my_data->dst + y*my_data->dstStep : sketched;
+
+        x = my_data->dodgeRow ? my_data->dodgeRow(blurred, grey, out, width) : 0;
+        sketchDodgePixels(blurred, grey, out, x, width);
+
+        if (out == sketched) {
+            //spread back over the colour channels, alpha comes from the source
+            const uint8_t* src = my_data->src + y*my_data->srcStep;
+            uint8_t* dst = my_data->dst + y*my_data->dstStep;
+            int cn = my_data->dstChannels;
+
+            for (x = 0; x < width; x++, src += cn, dst += cn) {
+                dst[0] = dst[1] = dst[2] = sketched[x];
+                if (cn == 4)
+                    dst[3] = src[3];
+            }
+        }
+    }
+
+    free(ring);
+
+    recordTimingSpan(TIMING_STAGE_KERNEL, worker, begin);
+}
+
+/*
+ * Public functions
+ */
+
+void sketchImage(const uint8_t* src, int srcStep, int srcChannels,
+                 uint8_t* dst, int dstStep, int dstChannels,
+                 int width, int height, bool rgba){
+    struct thread_data_sketch sketch_data;
+    //look the kernels up once so a backend switch can't land mid frame
+    sketch_data.blurColumn = getFilterKernels()->sketchBlurColumn;
+    sketch_data.dodgeRow = getFilterKernels()->sketchDodgeRow;
+    sketch_data.src = src;
+    sketch_data.srcStep = srcStep;
+    sketch_data.srcChannels = srcChannels;
+    sketch_data.dst = dst;
+    sketch_data.dstStep = dstStep;
+    sketch_data.dstChannels = dstChannels;
+    sketch_data.width = width;
+    sketch_data.height = height;
+    sketch_data.rgba = rgba;
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    WorkerPool::GetShared()->ParallelFor(height, doThreadGruntworkSketch, (void*)&sketch_data);
+}
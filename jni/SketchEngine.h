@@ -0,0 +1,46 @@
+//
+//  SketchEngine.h
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#ifndef FaceIt_SketchEngine_h
+#define FaceIt_SketchEngine_h
+
+#include <stdint.h>
+
+/*
+ * The sketchbook effect in one pass over the image: grey, blur and dodge.
+ *
+ * The grey is GrayscaleEngine's, weighted towards blue, not the CV_BGR2GRAY
+ * luminance the old sketch took at the end, so the look is a little different.
+ * Everything after the grey happens on the grey plane only. Each worker takes
+ * a band of rows and keeps the last 7 grey rows it made in a small ring, so
+ * no full size scratch image is needed. The blur is a 7x7 gaussian
+ * (sigma 1.4, what cvSmooth picks for 7x7) split into a vertical and a
+ * horizontal pass with 8 bit weights, with edge pixels repeated past the
+ * border.
+ *
+ * The dodge is the one the per channel loop always did, the inverted pixel
+ * added to the blurred one and wrapped to 8 bits unless it came to less than
+ * 255. That works out as
+ *   out = blur > grey ? blur - grey - 1 : 255
+ */
+
+//weights of the taps 0, 1, 2 and 3 pixels out from the centre, they add up to 256
+#define SKETCH_BLUR_W0  74
+#define SKETCH_BLUR_W1  57
+#define SKETCH_BLUR_W2  27
+#define SKETCH_BLUR_W3  7
+#define SKETCH_BLUR_RADIUS  3
+
+//sketch a whole image, with bands of rows shared out across the worker pool.
+//srcChannels is 3 or 4 (rgba is the byte order, see GrayscaleEngine.h),
+//dstChannels is 1 or the same as srcChannels, in which case the result is
+//written over the colour channels and alpha is copied across. dst can't be src
+void sketchImage(const uint8_t* src, int srcStep, int srcChannels,
+                 uint8_t* dst, int dstStep, int dstChannels,
+                 int width, int height, bool rgba);
+
+#endif
@@ -0,0 +1,60 @@
+//
+//  SketchEngineNeon.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+// Built with -mfpu=neon on armeabi-v7a only (see Android.mk), and only ever
+// reached through FilterBackend once cpufeatures has seen neon on the device.
+
+#include "FilterBackend.h"
+#include "SketchEngine.h"
+
+#if defined(HAVE_NEON) && defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+//7 taps over 8 pixels, vmlal keeps the sum in 16 bits and vrshrn rounds it
+static inline uint8x8_t vblur7_u8(uint8x8_t p0, uint8x8_t p1, uint8x8_t p2, uint8x8_t p3,
+                                  uint8x8_t p4, uint8x8_t p5, uint8x8_t p6){
+    uint16x8_t sum = vmull_u8(p3, vdup_n_u8(SKETCH_BLUR_W0));
+
+    sum = vmlal_u8(sum, p2, vdup_n_u8(SKETCH_BLUR_W1));
+    sum = vmlal_u8(sum, p4, vdup_n_u8(SKETCH_BLUR_W1));
+    sum = vmlal_u8(sum, p1, vdup_n_u8(SKETCH_BLUR_W2));
+    sum = vmlal_u8(sum, p5, vdup_n_u8(SKETCH_BLUR_W2));
+    sum = vmlal_u8(sum, p0, vdup_n_u8(SKETCH_BLUR_W3));
+    sum = vmlal_u8(sum, p6, vdup_n_u8(SKETCH_BLUR_W3));
+
+    return vrshrn_n_u16(sum, 8);
+}
+
+//vertical pass, 8 pixels of each of the 7 rows a go
+int sketchBlurColumnNeon(const uint8_t* const* rows, uint8_t* dst, int width){
+    int x = 0;
+    for (; x <= width - 8; x += 8) {
+        vst1_u8(dst+x, vblur7_u8(vld1_u8(rows[0]+x), vld1_u8(rows[1]+x), vld1_u8(rows[2]+x),
+                                 vld1_u8(rows[3]+x), vld1_u8(rows[4]+x), vld1_u8(rows[5]+x),
+                                 vld1_u8(rows[6]+x)));
+    }
+    return x;
+}
+
+//horizontal pass off unaligned loads either side, then the dodge, which is
+//just a saturating subtract and a wrapping one (0 - 1 comes out 255)
+int sketchDodgeRowNeon(const uint8_t* blurred, const uint8_t* grey, uint8_t* dst, int width){
+    const uint8x8_t one = vdup_n_u8(1);
+
+    int x = 0;
+    for (; x <= width - 8; x += 8) {
+        const uint8_t* p = blurred + x;
+        uint8x8_t b = vblur7_u8(vld1_u8(p-3), vld1_u8(p-2), vld1_u8(p-1), vld1_u8(p),
+                                vld1_u8(p+1), vld1_u8(p+2), vld1_u8(p+3));
+
+        vst1_u8(dst+x, vsub_u8(vqsub_u8(b, vld1_u8(grey+x)), one));
+    }
+    return x;
+}
+
+#endif
@@ -0,0 +1,90 @@
+//
+//  SketchEngineX86.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+// Built for its instruction set with a target attribute like SepiaEngineX86.cpp.
+// Nothing here needs more than sse2, but it sits in the ssse3 slot of
+// FilterBackend with the other kernels, and avx2 inherits it.
+
+#include "FilterBackend.h"
+#include "SketchEngine.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+//7 taps over 16 pixels, widened to 16 bits. The weights add up to 256, so the
+//sum fits with room for the rounding
+__attribute__((target("ssse3")))
+static inline __m128i blur7(__m128i p0, __m128i p1, __m128i p2, __m128i p3,
+                            __m128i p4, __m128i p5, __m128i p6){
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w0 = _mm_set1_epi16(SKETCH_BLUR_W0);
+    const __m128i w1 = _mm_set1_epi16(SKETCH_BLUR_W1);
+    const __m128i w2 = _mm_set1_epi16(SKETCH_BLUR_W2);
+    const __m128i w3 = _mm_set1_epi16(SKETCH_BLUR_W3);
+    const __m128i half = _mm_set1_epi16(128);
+
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(p3, zero), w0), half);
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(p3, zero), w0), half);
+
+    lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_add_epi16(_mm_unpacklo_epi8(p2, zero),
+                                                         _mm_unpacklo_epi8(p4, zero)), w1));
+    hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_add_epi16(_mm_unpackhi_epi8(p2, zero),
+                                                         _mm_unpackhi_epi8(p4, zero)), w1));
+    lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_add_epi16(_mm_unpacklo_epi8(p1, zero),
+                                                         _mm_unpacklo_epi8(p5, zero)), w2));
+    hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_add_epi16(_mm_unpackhi_epi8(p1, zero),
+                                                         _mm_unpackhi_epi8(p5, zero)), w2));
+    lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_add_epi16(_mm_unpacklo_epi8(p0, zero),
+                                                         _mm_unpacklo_epi8(p6, zero)), w3));
+    hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_add_epi16(_mm_unpackhi_epi8(p0, zero),
+                                                         _mm_unpackhi_epi8(p6, zero)), w3));
+
+    return _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+}
+
+//vertical pass, 16 pixels of each of the 7 rows a go
+__attribute__((target("ssse3")))
+int sketchBlurColumnSSSE3(const uint8_t* const* rows, uint8_t* dst, int width){
+    int x = 0;
+    for (; x <= width - 16; x += 16) {
+        __m128i b = blur7(_mm_loadu_si128((const __m128i*)(rows[0]+x)),
+                          _mm_loadu_si128((const __m128i*)(rows[1]+x)),
+                          _mm_loadu_si128((const __m128i*)(rows[2]+x)),
+                          _mm_loadu_si128((const __m128i*)(rows[3]+x)),
+                          _mm_loadu_si128((const __m128i*)(rows[4]+x)),
+                          _mm_loadu_si128((const __m128i*)(rows[5]+x)),
+                          _mm_loadu_si128((const __m128i*)(rows[6]+x)));
+        _mm_storeu_si128((__m128i*)(dst+x), b);
+    }
+    return x;
+}
+
+//horizontal pass off unaligned loads either side, then the dodge, which is
+//just a saturating subtract and a wrapping one (0 - 1 comes out 255)
+__attribute__((target("ssse3")))
+int sketchDodgeRowSSSE3(const uint8_t* blurred, const uint8_t* grey, uint8_t* dst, int width){
+    const __m128i one = _mm_set1_epi8(1);
+
+    int x = 0;
+    for (; x <= width - 16; x += 16) {
+        const uint8_t* p = blurred + x;
+        __m128i b = blur7(_mm_loadu_si128((const __m128i*)(p-3)),
+                          _mm_loadu_si128((const __m128i*)(p-2)),
+                          _mm_loadu_si128((const __m128i*)(p-1)),
+                          _mm_loadu_si128((const __m128i*)(p)),
+                          _mm_loadu_si128((const __m128i*)(p+1)),
+                          _mm_loadu_si128((const __m128i*)(p+2)),
+                          _mm_loadu_si128((const __m128i*)(p+3)));
+        __m128i g = _mm_loadu_si128((const __m128i*)(grey+x));
+
+        _mm_storeu_si128((__m128i*)(dst+x), _mm_sub_epi8(_mm_subs_epu8(b, g), one));
+    }
+    return x;
+}
+
+#endif
@@ -0,0 +1,103 @@
+//
+//  StageTimer.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#include "StageTimer.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifdef ANDROID
+#include <android/log.h>
+
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOG_TAG "Captain's Log"
+#else
+#define LOGE(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#endif
+
+/*
+ * Private variables
+ */
+
+static const char* stageNames[TIMING_STAGE_COUNT] = {
+    "unpack",
+    "kernel",
+    "repack",
+    "encode"
+};
+
+static struct timing_span timingRing[TIMING_RING_SIZE];
+//total spans ever recorded, the next one goes in at timingCount % TIMING_RING_SIZE
+static unsigned int timingCount = 0;
+static pthread_mutex_t timingLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Public functions
+ */
+
+int64_t timingNow(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec*1000000000LL + now.tv_nsec;
+}
+
+int64_t recordTimingSpan(int stage, int worker, int64_t start){
+    int64_t end = timingNow();
+
+    //only a handful of spans per frame, so a lock costs nothing here
+    pthread_mutex_lock(&timingLock);
+    struct timing_span* span = &timingRing[timingCount % TIMING_RING_SIZE];
+    span->stage = stage;
+    span->worker = worker;
+    span->start = start;
+    span->duration = end - start;
+    timingCount++;
+    pthread_mutex_unlock(&timingLock);
+
+    return end;
+}
+
+float timingSeconds(int64_t start, int64_t end){
+    return (float)((double)(end - start) / 1000000000.0);
+}
+
+int copyTimingSpans(struct timing_span* spans, int max){
+    pthread_mutex_lock(&timingLock);
+    unsigned int count = timingCount < TIMING_RING_SIZE ? timingCount : TIMING_RING_SIZE;
+    if (max < 0)
+        max = 0;
+    if (count > (unsigned int)max)
+        count = max;
+
+    for (unsigned int i = 0; i < count; i++)
+        spans[i] = timingRing[(timingCount - count + i) % TIMING_RING_SIZE];
+    pthread_mutex_unlock(&timingLock);
+
+    return (int)count;
+}
+
+void clearTimingSpans(){
+    pthread_mutex_lock(&timingLock);
+    timingCount = 0;
+    pthread_mutex_unlock(&timingLock);
+}
+
+const char* getTimingStageName(int stage){
+    if (stage < 0 || stage >= TIMING_STAGE_COUNT)
+        return "unknown";
+    return stageNames[stage];
+}
+
+void logTimeTaken(const char* what, float seconds){
+    char my_string[22];
+    sprintf(my_string,"%18.4f",seconds);
+    LOGE("****************************************");
+    LOGE("Time taken to %s:", what);
+    LOGE(my_string);
+    LOGE("****************************************");
+}
@@ -0,0 +1,69 @@
+//
+//  StageTimer.h
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#ifndef FaceIt_StageTimer_h
+#define FaceIt_StageTimer_h
+
+#include <stdint.h>
+
+/*
+ * Wall clock timing of the pipeline, one span per stage a frame goes
+ * through, and per worker for the parts that are split across the pool.
+ *
+ * clock() is cpu time summed over every thread in the process, so it made the
+ * SMP variants look slower the more cores they kept busy. These spans are
+ * CLOCK_MONOTONIC instead, kept in a fixed ring of the most recent
+ * TIMING_RING_SIZE so the java side (getTimingSpans) can pull them out after
+ * a run without anything being allocated while it's being timed.
+ */
+
+#define TIMING_RING_SIZE 256
+
+//the worker recorded for spans taken on the thread that called in, rather
+//than one of the worker pool's slices
+#define TIMING_CALLING_THREAD -1
+
+enum {
+    //interleaved pixels split out into planes (or converted in from java)
+    TIMING_STAGE_UNPACK = 0,
+    //the filter itself
+    TIMING_STAGE_KERNEL,
+    //planes written back into the interleaved image
+    TIMING_STAGE_REPACK,
+    //the result turned into something java can draw (BMP, ARGB)
+    TIMING_STAGE_ENCODE,
+    TIMING_STAGE_COUNT
+};
+
+struct timing_span
+{
+    int         stage;
+    int         worker;
+    //nanoseconds on the monotonic clock
+    int64_t     start;
+    int64_t     duration;
+};
+
+//the monotonic clock in nanoseconds
+int64_t     timingNow();
+
+//record [start, now) against stage, returning now so the next stage can
+//start from it
+int64_t     recordTimingSpan(int stage, int worker, int64_t start);
+
+float       timingSeconds(int64_t start, int64_t end);
+
+//copy out up to max of the most recent spans, oldest first, returning how many
+int         copyTimingSpans(struct timing_span* spans, int max);
+void        clearTimingSpans();
+
+const char* getTimingStageName(int stage);
+
+//the banner the TIMEIT blocks print to the log
+void        logTimeTaken(const char* what, float seconds);
+
+#endif
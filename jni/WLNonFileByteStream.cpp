@@ -19,7 +19,6 @@ subject to the following restrictions:
 WLNonFileByteStream::WLNonFileByteStream()
 {
     m_start = m_end = m_current = 0;
-    _size = 0;
     m_is_opened = false;
 }
 
@@ -30,13 +29,29 @@ WLNonFileByteStream::~WLNonFileByteStream()
 }
 
 
-void  WLNonFileByteStream::Allocate(int data_size)
+// make sure there's room for count more bytes, growing by at least double
+// so a stream written a little at a time still only reallocates log(n) times
+void  WLNonFileByteStream::Reserve(int count)
 {
-	if(!m_start)
-    	m_start = new uchar[data_size];
+    if( m_end - m_current >= count )
+        return;
 
-    m_end = m_start + data_size;
-    m_current = m_start;
+    int used = (int)(m_current - m_start);
+    int capacity = (int)(m_end - m_start);
+    int needed = used + count;
+
+    capacity = capacity > 0 ? capacity*2 : 64;
+    if( capacity < needed )
+        capacity = needed;
+
+    uchar* start = new uchar[capacity];
+    if( used > 0 )
+        memcpy( start, m_start, used );
+    delete [] m_start;
+
+    m_start = start;
+    m_end = m_start + capacity;
+    m_current = m_start + used;
 }
 
 void  WLNonFileByteStream::Deallocate()
@@ -46,16 +61,17 @@ void  WLNonFileByteStream::Deallocate()
 		delete [] m_start;
 		m_start = 0;
 	}
+    m_end = m_current = 0;
 }
 
 bool  WLNonFileByteStream::Open(int data_size)
 {
-    Close();
-    Allocate(data_size);
+    //keep whatever we had from last time, only grow if it's too small
+    m_current = m_start;
+    if( data_size > 0 )
+        Reserve(data_size);
     
     m_is_opened = true;
-    m_current = m_start;
-    _size = data_size;
     
     return true;
 }
@@ -63,77 +79,68 @@ bool  WLNonFileByteStream::Open(int data_size)
 
 void  WLNonFileByteStream::Close()
 {
+    //the buffer stays for the next Open, it goes in the destructor
     m_is_opened = false;
-	Deallocate();
 }
 
 
 void WLNonFileByteStream::PutByte( int val )
 {
+    Reserve(1);
     *m_current++ = (uchar)val;
 }
 
 
 void WLNonFileByteStream::PutBytes( const void* buffer, int count )
 {
-    uchar* data = (uchar*)buffer;
-    
-    assert( data && m_current && count >= 0 );
+    assert( buffer && count >= 0 );
 
-    while( count )
-    {
-        int l = (int)(m_end - m_current);
-        
-        if( l > count )
-            l = count;
-        
-        if( l > 0 )
-        {
-            memcpy( m_current, data, l );
-            m_current += l;
-            data += l;
-            count -= l;
-        }
-    }
+    Reserve(count);
+    memcpy( m_current, buffer, count );
+    m_current += count;
 }
 
 
 void WLNonFileByteStream::PutWord( int val )
 {
-    uchar *current = m_current;
+    Reserve(2);
 
-    if( current+1 < m_end )
-    {
-        current[0] = (uchar)val;
-        current[1] = (uchar)(val >> 8);
-        m_current = current + 2;
-    }
-    else
-    {
-        PutByte(val);
-        PutByte(val >> 8);
-    }
+    m_current[0] = (uchar)val;
+    m_current[1] = (uchar)(val >> 8);
+    m_current += 2;
 }
 
 
 void WLNonFileByteStream::PutDWord( int val )
 {
-    uchar *current = m_current;
+    Reserve(4);
 
-    if( current+3 < m_end )
-    {
-        current[0] = (uchar)val;
-        current[1] = (uchar)(val >> 8);
-        current[2] = (uchar)(val >> 16);
-        current[3] = (uchar)(val >> 24);
-        m_current = current + 4;
-    }
-    else
+    m_current[0] = (uchar)val;
+    m_current[1] = (uchar)(val >> 8);
+    m_current[2] = (uchar)(val >> 16);
+    m_current[3] = (uchar)(val >> 24);
+    m_current += 4;
+}
+
+
+void WLNonFileByteStream::PutRows( const void* data, int step, int width, int height, int pad )
+{
+    const uchar* row = (const uchar*)data;
+
+    assert( data && width >= 0 && height >= 0 && pad >= 0 );
+
+    Reserve((width + pad)*height);
+
+    for( int y = 0; y < height; y++, row += step )
     {
-        PutByte(val);
-        PutByte(val >> 8);
-        PutByte(val >> 16);
-        PutByte(val >> 24);
+        memcpy( m_current, row, width );
+        m_current += width;
+
+        if( pad > 0 )
+        {
+            memset( m_current, 0, pad );
+            m_current += pad;
+        }
     }
 }
 
@@ -145,6 +152,10 @@ uchar* WLNonFileByteStream::GetByte()
 
 int WLNonFileByteStream::GetSize()
 {
-	return _size;
+	return (int)(m_current - m_start);
 }
 
+int WLNonFileByteStream::GetCapacity()
+{
+	return (int)(m_end - m_start);
+}
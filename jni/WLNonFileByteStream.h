@@ -23,24 +23,32 @@ subject to the following restrictions:
 #include "ml.h"
 #include "utils.h"
 
+// An in memory byte sink. The buffer grows (doubling) as it's written to and
+// is kept across Close/Open, so encoding frame after frame into the same
+// stream stops allocating once it's big enough.
 class WLNonFileByteStream {
 public:
     WLNonFileByteStream();
     ~WLNonFileByteStream();
 
+    // data_size is how many bytes are expected, writing more just grows it
     bool    Open(int data_size);
     void    Close();
     void    PutByte( int val );
     void    PutBytes( const void* buffer, int count );
     void    PutWord( int val );
     void    PutDWord( int val ); 
+    // rows of width bytes, step apart (negative to go bottom up), each
+    // followed by pad zero bytes, with one size check for the lot
+    void    PutRows( const void* data, int step, int width, int height, int pad );
     uchar*  GetByte(); 
+    // the number of bytes written since Open
     int     GetSize(); 
+    int     GetCapacity();
 
 protected:
-    void    Allocate(int data_size);
+    void    Reserve(int count);
 	void    Deallocate();
-    int     _size;
     uchar*  m_start;
     uchar*  m_end;
     uchar*  m_current;
@@ -0,0 +1,227 @@
+//
+//  WorkerPool.cpp
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#include "WorkerPool.h"
+
+#include <stdint.h>
+#include <unistd.h>
+
+/*
+ * Private variables
+ */
+
+//set on every thread that is currently running a slice (worker index + 1),
+//so a task that calls back into ParallelFor runs inline rather than deadlocking
+static pthread_key_t insideWorkerKey;
+static pthread_once_t insideWorkerKeyOnce = PTHREAD_ONCE_INIT;
+
+static WorkerPool* sharedPool = 0;
+static pthread_once_t sharedPoolOnce = PTHREAD_ONCE_INIT;
+
+static void createInsideWorkerKey(){
+    pthread_key_create(&insideWorkerKey, NULL);
+}
+
+static void createSharedPool(){
+    sharedPool = new WorkerPool();
+}
+
+///////////////////////////// WorkerPool ///////////////////////////////////
+
+WorkerPool::WorkerPool(int numberOfWorkers)
+{
+    pthread_once(&insideWorkerKeyOnce, createInsideWorkerKey);
+
+    if (numberOfWorkers <= 0)
+        numberOfWorkers = GetNumberOfCores();
+    if (numberOfWorkers > WORKER_POOL_MAX_WORKERS)
+        numberOfWorkers = WORKER_POOL_MAX_WORKERS;
+
+    pthread_mutex_init(&m_dispatchLock, NULL);
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_workAvailable, NULL);
+    pthread_cond_init(&m_workDone, NULL);
+
+    m_generation = 0;
+    m_pending = 0;
+    m_shutdown = false;
+    m_task = 0;
+    m_arg = 0;
+    m_count = 0;
+    m_slices = 1;
+
+    //worker 0 is always whoever calls ParallelFor, so only spawn the rest
+    m_numberOfWorkers = 1;
+    for (int t = 1; t < numberOfWorkers; t++) {
+        m_threadData[t].pool = this;
+        m_threadData[t].worker = t;
+
+        if (pthread_create(&m_threads[t], NULL, WorkerMain, (void*)&m_threadData[t])) {
+            //carry on with however many we managed to get
+            break;
+        }
+        m_numberOfWorkers++;
+    }
+    m_activeWorkers = m_numberOfWorkers;
+}
+
+
+WorkerPool::~WorkerPool()
+{
+    pthread_mutex_lock(&m_lock);
+    m_shutdown = true;
+    pthread_cond_broadcast(&m_workAvailable);
+    pthread_mutex_unlock(&m_lock);
+
+    for (int t = 1; t < m_numberOfWorkers; t++) {
+        pthread_join(m_threads[t], NULL);
+    }
+
+    pthread_cond_destroy(&m_workDone);
+    pthread_cond_destroy(&m_workAvailable);
+    pthread_mutex_destroy(&m_lock);
+    pthread_mutex_destroy(&m_dispatchLock);
+}
+
+
+int WorkerPool::GetNumberOfWorkers()
+{
+    return m_numberOfWorkers;
+}
+
+
+void WorkerPool::SetActiveWorkers(int count)
+{
+    if (count <= 0 || count > m_numberOfWorkers)
+        count = m_numberOfWorkers;
+
+    m_activeWorkers = count;
+}
+
+
+int WorkerPool::GetActiveWorkers()
+{
+    return m_activeWorkers;
+}
+
+
+int WorkerPool::GetNumberOfCores()
+{
+    //android hotplugs cores under load, so count the configured ones
+    //rather than only those that happen to be awake right now
+    long cores = sysconf(_SC_NPROCESSORS_CONF);
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (online > cores)
+        cores = online;
+    if (cores < 1)
+        cores = 1;
+    if (cores > WORKER_POOL_MAX_WORKERS)
+        cores = WORKER_POOL_MAX_WORKERS;
+
+    return (int)cores;
+}
+
+
+WorkerPool* WorkerPool::GetShared()
+{
+    pthread_once(&sharedPoolOnce, createSharedPool);
+    return sharedPool;
+}
+
+
+void WorkerPool::RunSlice(int worker, int count)
+{
+    if (worker >= m_slices)
+        return;
+
+    //split as evenly as possible, the first (count % workers) slices get one extra
+    int start = (int)(((int64_t)count * worker) / m_slices);
+    int stop = (int)(((int64_t)count * (worker+1)) / m_slices);
+
+    if (start < stop)
+        m_task(m_arg, start, stop, worker);
+}
+
+
+void* WorkerPool::WorkerMain(void* arg)
+{
+    struct worker_pool_thread_data *my_data = (struct worker_pool_thread_data *)arg;
+    WorkerPool* pool = my_data->pool;
+    int worker = my_data->worker;
+    int seenGeneration = 0;
+
+    pthread_setspecific(insideWorkerKey, (void*)(intptr_t)(worker+1));
+
+    pthread_mutex_lock(&pool->m_lock);
+    for (;;) {
+        while (pool->m_generation == seenGeneration && !pool->m_shutdown)
+            pthread_cond_wait(&pool->m_workAvailable, &pool->m_lock);
+
+        if (pool->m_shutdown)
+            break;
+
+        seenGeneration = pool->m_generation;
+        int count = pool->m_count;
+        pthread_mutex_unlock(&pool->m_lock);
+
+        pool->RunSlice(worker, count);
+
+        pthread_mutex_lock(&pool->m_lock);
+        if (--pool->m_pending == 0)
+            pthread_cond_signal(&pool->m_workDone);
+    }
+    pthread_mutex_unlock(&pool->m_lock);
+
+    return NULL;
+}
+
+
+void WorkerPool::ParallelFor(int count, WorkerPoolTask task, void* arg)
+{
+    if (count <= 0 || !task)
+        return;
+
+    //nested call from inside a slice, or nothing worth splitting
+    intptr_t inside = (intptr_t)pthread_getspecific(insideWorkerKey);
+    if (inside || m_activeWorkers == 1 || count == 1) {
+        task(arg, 0, count, inside ? (int)(inside-1) : 0);
+        return;
+    }
+
+    //only one range in flight at a time. Anyone else (another session on its
+    //own thread) does their range themselves rather than queue up behind it
+    if (pthread_mutex_trylock(&m_dispatchLock) != 0) {
+        task(arg, 0, count, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    m_task = task;
+    m_arg = arg;
+    m_count = count;
+    m_slices = m_activeWorkers;
+    m_pending = m_numberOfWorkers-1;
+    m_generation++;
+    pthread_cond_broadcast(&m_workAvailable);
+    pthread_mutex_unlock(&m_lock);
+
+    //do our own share rather than sit idle
+    pthread_setspecific(insideWorkerKey, (void*)(intptr_t)1);
+    RunSlice(0, count);
+    pthread_setspecific(insideWorkerKey, NULL);
+
+    //barrier: wait for every other slice to land
+    pthread_mutex_lock(&m_lock);
+    while (m_pending > 0)
+        pthread_cond_wait(&m_workDone, &m_lock);
+    m_task = 0;
+    m_arg = 0;
+    pthread_mutex_unlock(&m_lock);
+
+    pthread_mutex_unlock(&m_dispatchLock);
+}
@@ -0,0 +1,80 @@
+//
+//  WorkerPool.h
+//  FaceIt
+//
+//  Copyright (c) 2012 OpenParallel.com all rights reserved.
+//
+
+#ifndef FaceIt_WorkerPool_h
+#define FaceIt_WorkerPool_h
+
+#include <pthread.h>
+
+//the maximum number of threads we will ever spin up (including the caller)
+#define WORKER_POOL_MAX_WORKERS 16
+
+//a unit of work, called once per worker with the [start, stop) slice of the
+//range handed to ParallelFor and the index of the worker running it
+typedef void (*WorkerPoolTask)(void* arg, int start, int stop, int worker);
+
+class WorkerPool;
+
+struct worker_pool_thread_data
+{
+    WorkerPool* pool;
+    int         worker;
+};
+
+/*
+ * A fixed set of long lived pthreads that sleep until ParallelFor hands them
+ * a range to chew through. The calling thread does the first slice itself
+ * and ParallelFor only returns once every slice is done, so it doubles as a
+ * barrier between pipeline stages. If the pool is already busy with someone
+ * else's range the caller runs the whole of theirs on its own thread, so
+ * sessions running side by side never wait on each other.
+ */
+class WorkerPool {
+public:
+    //numberOfWorkers <= 0 means one worker per cpu core
+    WorkerPool(int numberOfWorkers = 0);
+    ~WorkerPool();
+
+    int     GetNumberOfWorkers();
+    void    ParallelFor(int count, WorkerPoolTask task, void* arg);
+
+    //only split ranges over the first count workers (the rest sit the range
+    //out), so one pool can be measured at every thread count up to its size.
+    //count <= 0 goes back to all of them
+    void    SetActiveWorkers(int count);
+    int     GetActiveWorkers();
+
+    //the process wide pool that all the filters dispatch into
+    static WorkerPool*  GetShared();
+    static int          GetNumberOfCores();
+
+protected:
+    static void*    WorkerMain(void* arg);
+    void            RunSlice(int worker, int count);
+
+    int             m_numberOfWorkers;
+    volatile int    m_activeWorkers;
+    //m_activeWorkers as it was when the range in flight was handed out
+    int             m_slices;
+    pthread_t       m_threads[WORKER_POOL_MAX_WORKERS];
+    struct worker_pool_thread_data m_threadData[WORKER_POOL_MAX_WORKERS];
+
+    pthread_mutex_t m_dispatchLock;
+    pthread_mutex_t m_lock;
+    pthread_cond_t  m_workAvailable;
+    pthread_cond_t  m_workDone;
+
+    int             m_generation;
+    int             m_pending;
+    bool            m_shutdown;
+
+    WorkerPoolTask  m_task;
+    void*           m_arg;
+    int             m_count;
+};
+
+#endif
@@ -1158,6 +1158,21 @@ CVAPI(void) mycvSetImagesForHaarClassifierCascade( CvHaarClassifierCascade* casc
 CVAPI(int) mycvRunHaarClassifierCascade( CvHaarClassifierCascade* cascade,
                                       CvPoint pt, int start_stage CV_DEFAULT(0));
 
+/* Keeps the objects found in one video frame so the next one only has to be
+   searched around them, with a full search every full_scan_interval frames */
+typedef struct MyCvHaarTracker MyCvHaarTracker;
+
+CVAPI(MyCvHaarTracker*) mycvCreateHaarTracker( int full_scan_interval CV_DEFAULT(10) );
+
+CVAPI(void) mycvReleaseHaarTracker( MyCvHaarTracker** tracker );
+
+/* mycvHaarDetectObjects for successive frames of the same video */
+CVAPI(CvSeq*) mycvHaarTrackObjects( const CvArr* image,
+                     CvHaarClassifierCascade* cascade, MyCvHaarTracker* tracker,
+                     CvMemStorage* storage, double scale_factor CV_DEFAULT(1.1),
+                     int min_neighbors CV_DEFAULT(3), int flags CV_DEFAULT(0),
+                     CvSize min_size CV_DEFAULT(cvSize(0,0)));
+
 /****************************************************************************************\
 *                      Camera Calibration, Pose Estimation and Stereo                    *
 \****************************************************************************************/
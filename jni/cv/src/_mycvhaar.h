@@ -0,0 +1,156 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                        Intel License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000, Intel Corporation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of Intel Corporation may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+/* the hidden Haar cascade of mycvHaarDetectObjects.cpp, shared with the
+   files that hold its vector code */
+
+#ifndef _MYCV_HAAR_H_
+#define _MYCV_HAAR_H_
+
+#include "_cv.h"
+
+typedef int sumtype;
+typedef double sqsumtype;
+
+typedef struct MyCvHidHaarFeature
+	{
+		struct
+		{
+			sumtype *p0, *p1, *p2, *p3;
+			int weight;
+		}
+		rect[CV_HAAR_FEATURE_MAX];
+	}
+	MyCvHidHaarFeature;
+
+
+typedef struct MyCvHidHaarTreeNode
+	{
+		MyCvHidHaarFeature feature;
+		int threshold;
+		int left;
+		int right;
+	}
+	MyCvHidHaarTreeNode;
+
+
+typedef struct MyCvHidHaarClassifier
+	{
+		int count;
+		//CvHaarFeature* orig_feature;
+		MyCvHidHaarTreeNode* node;
+		float* alpha;
+	}
+	MyCvHidHaarClassifier;
+
+
+typedef struct MyCvHidHaarStageClassifier
+	{
+		int  count;
+		float threshold;
+		MyCvHidHaarClassifier* classifier;
+		int two_rects;
+		
+		struct MyCvHidHaarStageClassifier* next;
+		struct MyCvHidHaarStageClassifier* child;
+		struct MyCvHidHaarStageClassifier* parent;
+	}
+	MyCvHidHaarStageClassifier;
+
+
+struct MyCvHidHaarClassifierCascade
+{
+    int  count;
+    int  is_stump_based;
+    int  has_tilted_features;
+    int  is_tree;
+    double inv_window_area;
+    CvMat sum, sqsum, tilted;
+    MyCvHidHaarStageClassifier* stage_classifier;
+    sqsumtype *pq0, *pq1, *pq2, *pq3;
+    sumtype *p0, *p1, *p2, *p3;
+	
+    void** ipp_stages;
+
+    /* the stumps again, flattened for the first pass scan. 0 unless the
+       cascade is all stumps on the upright sum */
+    struct MyCvHaarFlatStage* flat_stage;
+};
+
+
+/* one stump of the flattened cascade. The rectangle corners are offsets from
+   the window's top left in the sum, so it holds everything one test needs in
+   a single record and a stage is one run of them. An unused third rectangle
+   has weight 0 and all its offsets 0 */
+typedef struct MyCvHaarFlatStump
+	{
+		int ofs[CV_HAAR_FEATURE_MAX][4];
+		int weight[CV_HAAR_FEATURE_MAX];
+		int threshold;
+		float alpha[2];
+	}
+	MyCvHaarFlatStump;
+
+
+typedef struct MyCvHaarFlatStage
+	{
+		int count;
+		float threshold;
+		int two_rects;
+		MyCvHaarFlatStump* stump;
+	}
+	MyCvHaarFlatStage;
+
+
+/* stage 0 of four windows at once (see myicvScanHaarRowsBatched), p_offset
+   and norm for each of them. The bits set in the result are the windows
+   that get through */
+typedef int (*MyCvHaarPassStage4Func)( const MyCvHidHaarClassifierCascade* cascade,
+                                       const int* p_offset, const int* norm );
+
+#ifdef HAVE_NEON
+/* in mycvHaarDetectObjectsNeon.cpp, built with -mfpu=neon on armeabi-v7a
+   only and only called once cpufeatures has seen neon on the device */
+int myicvPassHaarStage4Neon( const MyCvHidHaarClassifierCascade* cascade,
+                             const int* p_offset, const int* norm );
+#endif
+
+#endif /*_MYCV_HAAR_H_*/
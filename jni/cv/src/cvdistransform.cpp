@@ -441,66 +441,36 @@ icvGetDistanceTransformMask( int maskType, float *metrics )
 }
 
 
-static void
-icvTrueDistTrans( const CvMat* src, CvMat* dst )
+typedef struct CvDistTransStage1
 {
-    CvMat* buffer = 0;
-
-    CV_FUNCNAME( "cvDistTransform2" );
-
-    __BEGIN__;
-
-    int i, m, n;
-    int sstep, dstep;
-    const float inf = 1e6f;
-    int thread_count = cvGetNumThreads();
-    int pass1_sz, pass2_sz;
-
-    if( !CV_ARE_SIZES_EQ( src, dst ))
-        CV_ERROR( CV_StsUnmatchedSizes, "" );
-
-    if( CV_MAT_TYPE(src->type) != CV_8UC1 ||
-        CV_MAT_TYPE(dst->type) != CV_32FC1 )
-        CV_ERROR( CV_StsUnsupportedFormat,
-        "The input image must have 8uC1 type and the output one must have 32fC1 type" );
-
-    m = src->rows;
-    n = src->cols;
-
-    // (see stage 1 below):
-    // sqr_tab: 2*m, sat_tab: 3*m + 1, d: m*thread_count,
-    pass1_sz = src->rows*(5 + thread_count) + 1;
-    // (see stage 2):
-    // sqr_tab & inv_tab: n each; f & v: n*thread_count each; z: (n+1)*thread_count
-    pass2_sz = src->cols*(2 + thread_count*3) + thread_count;
-    CV_CALL( buffer = cvCreateMat( 1, MAX(pass1_sz, pass2_sz), CV_32FC1 ));
+    const CvMat* src;
+    CvMat* dst;
+    const float* sqr_tab;
+    int* sat_tab;
+}
+CvDistTransStage1;
 
-    sstep = src->step;
-    dstep = dst->step / sizeof(float);
 
-    // stage 1: compute 1d distance transform of each column
-    {
-    float* sqr_tab = buffer->data.fl;
-    int* sat_tab = (int*)(sqr_tab + m*2);
+// stage 1 of icvTrueDistTrans on columns [start,end): 1d distance transform of each column
+static void CV_CDECL
+icvTrueDistTransCols( int start, int end, void* userdata )
+{
+    const CvDistTransStage1* stage = (const CvDistTransStage1*)userdata;
+    const CvMat* src = stage->src;
+    CvMat* dst = stage->dst;
+    const float* sqr_tab = stage->sqr_tab;
+    int* sat_tab = stage->sat_tab;
+    int m = src->rows;
     const int shift = m*2;
+    int sstep = src->step;
+    int dstep = dst->step / sizeof(float);
+    int* d = sat_tab + m*3+1+m*cvGetThreadNum();
+    int i;
 
-    for( i = 0; i < m; i++ )
-        sqr_tab[i] = (float)(i*i);
-    for( i = m; i < m*2; i++ )
-        sqr_tab[i] = inf;
-    for( i = 0; i < shift; i++ )
-        sat_tab[i] = 0;
-    for( ; i <= m*3; i++ )
-        sat_tab[i] = i - shift;
-
-#ifdef _OPENMP
-    #pragma omp parallel for num_threads(thread_count)
-#endif
-    for( i = 0; i < n; i++ )
+    for( i = start; i < end; i++ )
     {
         const uchar* sptr = src->data.ptr + i + (m-1)*sstep;
         float* dptr = dst->data.fl + i;
-        int* d = (int*)(sat_tab + m*3+1+m*cvGetThreadNum());
         int j, dist = m-1;
 
         for( j = m-1; j >= 0; j--, sptr -= sstep )
@@ -517,29 +487,36 @@ icvTrueDistTrans( const CvMat* src, CvMat* dst )
             dptr[0] = sqr_tab[dist];
         }
     }
-    }
+}
 
-    // stage 2: compute modified distance transform for each row
-    {
-    float* inv_tab = buffer->data.fl;
-    float* sqr_tab = inv_tab + n;
 
-    inv_tab[0] = sqr_tab[0] = 0.f;
-    for( i = 1; i < n; i++ )
-    {
-        inv_tab[i] = (float)(0.5/i);
-        sqr_tab[i] = (float)(i*i);
-    }
+typedef struct CvDistTransStage2
+{
+    CvMat* dst;
+    const float* inv_tab;
+    float* sqr_tab;
+}
+CvDistTransStage2;
 
-#ifdef _OPENMP
-    #pragma omp parallel for num_threads(thread_count) schedule(dynamic)
-#endif
-    for( i = 0; i < m; i++ )
+
+// stage 2 of icvTrueDistTrans on rows [start,end): modified distance transform of each row
+static void CV_CDECL
+icvTrueDistTransRows( int start, int end, void* userdata )
+{
+    const CvDistTransStage2* stage = (const CvDistTransStage2*)userdata;
+    CvMat* dst = stage->dst;
+    const float* inv_tab = stage->inv_tab;
+    const float* sqr_tab = stage->sqr_tab;
+    const float inf = 1e6f;
+    int n = dst->cols;
+    float* f = stage->sqr_tab + n + (n*3+1)*cvGetThreadNum();
+    float* z = f + n;
+    int* v = (int*)(z + n + 1);
+    int i;
+
+    for( i = start; i < end; i++ )
     {
         float* d = (float*)(dst->data.ptr + i*dst->step);
-        float* f = sqr_tab + n + (n*3+1)*cvGetThreadNum();
-        float* z = f + n;
-        int* v = (int*)(z + n + 1);
         int p, q, k;
 
         v[0] = 0;
@@ -575,6 +552,75 @@ icvTrueDistTrans( const CvMat* src, CvMat* dst )
             d[q] = sqr_tab[abs(q - p)] + f[p];
         }
     }
+}
+
+
+static void
+icvTrueDistTrans( const CvMat* src, CvMat* dst )
+{
+    CvMat* buffer = 0;
+
+    CV_FUNCNAME( "cvDistTransform2" );
+
+    __BEGIN__;
+
+    int i, m, n;
+    const float inf = 1e6f;
+    int thread_count = cvGetNumThreads();
+    int pass1_sz, pass2_sz;
+
+    if( !CV_ARE_SIZES_EQ( src, dst ))
+        CV_ERROR( CV_StsUnmatchedSizes, "" );
+
+    if( CV_MAT_TYPE(src->type) != CV_8UC1 ||
+        CV_MAT_TYPE(dst->type) != CV_32FC1 )
+        CV_ERROR( CV_StsUnsupportedFormat,
+        "The input image must have 8uC1 type and the output one must have 32fC1 type" );
+
+    m = src->rows;
+    n = src->cols;
+
+    // (see stage 1 below):
+    // sqr_tab: 2*m, sat_tab: 3*m + 1, d: m*thread_count,
+    pass1_sz = src->rows*(5 + thread_count) + 1;
+    // (see stage 2):
+    // sqr_tab & inv_tab: n each; f & v: n*thread_count each; z: (n+1)*thread_count
+    pass2_sz = src->cols*(2 + thread_count*3) + thread_count;
+    CV_CALL( buffer = cvCreateMat( 1, MAX(pass1_sz, pass2_sz), CV_32FC1 ));
+
+    // stage 1: compute 1d distance transform of each column
+    {
+    float* sqr_tab = buffer->data.fl;
+    int* sat_tab = (int*)(sqr_tab + m*2);
+    const int shift = m*2;
+
+    for( i = 0; i < m; i++ )
+        sqr_tab[i] = (float)(i*i);
+    for( i = m; i < m*2; i++ )
+        sqr_tab[i] = inf;
+    for( i = 0; i < shift; i++ )
+        sat_tab[i] = 0;
+    for( ; i <= m*3; i++ )
+        sat_tab[i] = i - shift;
+
+    CvDistTransStage1 stage1 = { src, dst, sqr_tab, sat_tab };
+    cvParallelFor( n, icvTrueDistTransCols, &stage1, thread_count );
+    }
+
+    // stage 2: compute modified distance transform for each row
+    {
+    float* inv_tab = buffer->data.fl;
+    float* sqr_tab = inv_tab + n;
+
+    inv_tab[0] = sqr_tab[0] = 0.f;
+    for( i = 1; i < n; i++ )
+    {
+        inv_tab[i] = (float)(0.5/i);
+        sqr_tab[i] = (float)(i*i);
+    }
+
+    CvDistTransStage2 stage2 = { dst, inv_tab, sqr_tab };
+    cvParallelFor( m, icvTrueDistTransRows, &stage2, thread_count );
     }
 
     cvPow( dst, dst, 0.5 );
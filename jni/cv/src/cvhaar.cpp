@@ -1082,6 +1082,8 @@ cvHaarDetectObjects( const CvArr* _img,
                     CvSeqBlock* b = s->first;
                     for( j = 0; j < total; j += b->count, b = b->next )
                         cvSeqPushMulti( seq, b->data, b->count );
+                    /* the next scale starts with empty per thread lists */
+                    cvClearSeq( s );
                 }
         }
     }
@@ -1256,6 +1258,8 @@ cvHaarDetectObjects( const CvArr* _img,
                     CvSeqBlock* b = s->first;
                     for( j = 0; j < total; j += b->count, b = b->next )
                         cvSeqPushMulti( seq, b->data, b->count );
+                    /* the next scale starts with empty per thread lists */
+                    cvClearSeq( s );
 	            }
 
             if( find_biggest_object )
@@ -255,6 +255,246 @@ icvCalcIxIy_32f( const float* src, int src_step, float* dstX, float* dstY, int d
 }
 
 
+typedef struct CvLKFlowLevel
+{
+    const uchar* imgI;
+    const uchar* imgJ;
+    int levelStep;
+    CvSize levelSize;
+    double scale;
+    int l;
+    int level;
+    const CvPoint2D32f* featuresA;
+    CvPoint2D32f* featuresB;
+    char* status;
+    float* error;
+    CvSize winSize;
+    CvSize patchSize;
+    CvTermCriteria criteria;
+    int flags;
+    const float* smoothKernel;
+    float** patchI;
+    float** patchJ;
+    float** Ix;
+    float** Iy;
+}
+CvLKFlowLevel;
+
+
+/* find flow for points [start,end) on pyramid level job->l */
+static void CV_CDECL
+icvCalcOpticalFlowPyrLKPoints( int start, int end, void* userdata )
+{
+    const CvLKFlowLevel* job = (const CvLKFlowLevel*)userdata;
+    const uchar* imgI = job->imgI;
+    const uchar* imgJ = job->imgJ;
+    int levelStep = job->levelStep;
+    CvSize levelSize = job->levelSize;
+    double scale = job->scale;
+    int l = job->l, level = job->level;
+    const CvPoint2D32f* featuresA = job->featuresA;
+    CvPoint2D32f* featuresB = job->featuresB;
+    char* status = job->status;
+    float* error = job->error;
+    CvSize winSize = job->winSize, patchSize = job->patchSize;
+    CvTermCriteria criteria = job->criteria;
+    int flags = job->flags;
+    const float* smoothKernel = job->smoothKernel;
+    int threadIdx = cvGetThreadNum();
+    float* patchI = job->patchI[threadIdx];
+    float* patchJ = job->patchJ[threadIdx];
+    float* Ix = job->Ix[threadIdx];
+    float* Iy = job->Iy[threadIdx];
+    int i;
+
+    for( i = start; i < end; i++ )
+    {
+        CvPoint2D32f v;
+        CvPoint minI, maxI, minJ, maxJ;
+        CvSize isz, jsz;
+        int pt_status;
+        CvPoint2D32f u;
+        CvPoint prev_minJ = { -1, -1 }, prev_maxJ = { -1, -1 };
+        double Gxx = 0, Gxy = 0, Gyy = 0, D = 0, minEig = 0;
+        float prev_mx = 0, prev_my = 0;
+        int j, x, y;
+
+        v.x = featuresB[i].x;
+        v.y = featuresB[i].y;
+        if( l < level )
+        {
+            v.x += v.x;
+            v.y += v.y;
+        }
+        else
+        {
+            v.x = (float)(v.x * scale);
+            v.y = (float)(v.y * scale);
+        }
+
+        pt_status = status[i];
+        if( !pt_status )
+            continue;
+
+        minI = maxI = minJ = maxJ = cvPoint( 0, 0 );
+
+        u.x = (float) (featuresA[i].x * scale);
+        u.y = (float) (featuresA[i].y * scale);
+
+        intersect( u, winSize, levelSize, &minI, &maxI );
+        isz = jsz = cvSize(maxI.x - minI.x + 2, maxI.y - minI.y + 2);
+        u.x += (minI.x - (patchSize.width - maxI.x + 1))*0.5f;
+        u.y += (minI.y - (patchSize.height - maxI.y + 1))*0.5f;
+
+        if( isz.width < 3 || isz.height < 3 ||
+            icvGetRectSubPix_8u32f_C1R( imgI, levelStep, levelSize,
+                patchI, isz.width*sizeof(patchI[0]), isz, u ) < 0 )
+        {
+            /* point is outside the image. take the next */
+            status[i] = 0;
+            continue;
+        }
+
+        icvCalcIxIy_32f( patchI, isz.width*sizeof(patchI[0]), Ix, Iy,
+            (isz.width-2)*sizeof(patchI[0]), isz, smoothKernel, patchJ );
+
+        for( j = 0; j < criteria.max_iter; j++ )
+        {
+            double bx = 0, by = 0;
+            float mx, my;
+            CvPoint2D32f _v;
+
+            intersect( v, winSize, levelSize, &minJ, &maxJ );
+
+            minJ.x = MAX( minJ.x, minI.x );
+            minJ.y = MAX( minJ.y, minI.y );
+
+            maxJ.x = MIN( maxJ.x, maxI.x );
+            maxJ.y = MIN( maxJ.y, maxI.y );
+
+            jsz = cvSize(maxJ.x - minJ.x, maxJ.y - minJ.y);
+
+            _v.x = v.x + (minJ.x - (patchSize.width - maxJ.x + 1))*0.5f;
+            _v.y = v.y + (minJ.y - (patchSize.height - maxJ.y + 1))*0.5f;
+
+            if( jsz.width < 1 || jsz.height < 1 ||
+                icvGetRectSubPix_8u32f_C1R( imgJ, levelStep, levelSize, patchJ,
+                                            jsz.width*sizeof(patchJ[0]), jsz, _v ) < 0 )
+            {
+                /* point is outside image. take the next */
+                pt_status = 0;
+                break;
+            }
+
+            if( maxJ.x == prev_maxJ.x && maxJ.y == prev_maxJ.y &&
+                minJ.x == prev_minJ.x && minJ.y == prev_minJ.y )
+            {
+                for( y = 0; y < jsz.height; y++ )
+                {
+                    const float* pi = patchI +
+                        (y + minJ.y - minI.y + 1)*isz.width + minJ.x - minI.x + 1;
+                    const float* pj = patchJ + y*jsz.width;
+                    const float* ix = Ix +
+                        (y + minJ.y - minI.y)*(isz.width-2) + minJ.x - minI.x;
+                    const float* iy = Iy + (ix - Ix);
+
+                    for( x = 0; x < jsz.width; x++ )
+                    {
+                        double t0 = pi[x] - pj[x];
+                        bx += t0 * ix[x];
+                        by += t0 * iy[x];
+                    }
+                }
+            }
+            else
+            {
+                Gxx = Gyy = Gxy = 0;
+                for( y = 0; y < jsz.height; y++ )
+                {
+                    const float* pi = patchI +
+                        (y + minJ.y - minI.y + 1)*isz.width + minJ.x - minI.x + 1;
+                    const float* pj = patchJ + y*jsz.width;
+                    const float* ix = Ix +
+                        (y + minJ.y - minI.y)*(isz.width-2) + minJ.x - minI.x;
+                    const float* iy = Iy + (ix - Ix);
+
+                    for( x = 0; x < jsz.width; x++ )
+                    {
+                        double t = pi[x] - pj[x];
+                        bx += (double) (t * ix[x]);
+                        by += (double) (t * iy[x]);
+                        Gxx += ix[x] * ix[x];
+                        Gxy += ix[x] * iy[x];
+                        Gyy += iy[x] * iy[x];
+                    }
+                }
+
+                D = Gxx * Gyy - Gxy * Gxy;
+                if( D < DBL_EPSILON )
+                {
+                    pt_status = 0;
+                    break;
+                }
+
+                // Adi Shavit - 2008.05
+                if( flags & CV_LKFLOW_GET_MIN_EIGENVALS )
+                    minEig = (Gyy + Gxx - sqrt((Gxx-Gyy)*(Gxx-Gyy) + 4.*Gxy*Gxy))/(2*jsz.height*jsz.width);
+
+                D = 1. / D;
+
+                prev_minJ = minJ;
+                prev_maxJ = maxJ;
+            }
+
+            mx = (float) ((Gyy * bx - Gxy * by) * D);
+            my = (float) ((Gxx * by - Gxy * bx) * D);
+
+            v.x += mx;
+            v.y += my;
+
+            if( mx * mx + my * my < criteria.epsilon )
+                break;
+
+            if( j > 0 && fabs(mx + prev_mx) < 0.01 && fabs(my + prev_my) < 0.01 )
+            {
+                v.x -= mx*0.5f;
+                v.y -= my*0.5f;
+                break;
+            }
+            prev_mx = mx;
+            prev_my = my;
+        }
+
+        featuresB[i] = v;
+        status[i] = (char)pt_status;
+        if( l == 0 && error && pt_status )
+        {
+            /* calc error */
+            double err = 0;
+            if( flags & CV_LKFLOW_GET_MIN_EIGENVALS )
+                err = minEig;
+            else
+            {
+                for( y = 0; y < jsz.height; y++ )
+                {
+                    const float* pi = patchI +
+                        (y + minJ.y - minI.y + 1)*isz.width + minJ.x - minI.x + 1;
+                    const float* pj = patchJ + y*jsz.width;
+
+                    for( x = 0; x < jsz.width; x++ )
+                    {
+                        double t = pi[x] - pj[x];
+                        err += t * t;
+                    }
+                }
+                err = sqrt(err);
+            }
+            error[i] = (float)err;
+        }
+    }
+}
+
+
 icvOpticalFlowPyrLKInitAlloc_8u_C1R_t icvOpticalFlowPyrLKInitAlloc_8u_C1R_p = 0;
 icvOpticalFlowPyrLKFree_8u_C1R_t icvOpticalFlowPyrLKFree_8u_C1R_p = 0;
 icvOpticalFlowPyrLK_8u_C1R_t icvOpticalFlowPyrLK_8u_C1R_p = 0;
@@ -439,202 +679,10 @@ cvCalcOpticalFlowPyrLK( const void* arrA, const void* arrB,
         CvSize levelSize = size[l];
         int levelStep = step[l];
 
-        {
-#ifdef _OPENMP
-        #pragma omp parallel for num_threads(threadCount) schedule(dynamic) 
-#endif // _OPENMP
-        /* find flow for each given point */
-        for( i = 0; i < count; i++ )
-        {
-            CvPoint2D32f v;
-            CvPoint minI, maxI, minJ, maxJ;
-            CvSize isz, jsz;
-            int pt_status;
-            CvPoint2D32f u;
-            CvPoint prev_minJ = { -1, -1 }, prev_maxJ = { -1, -1 };
-            double Gxx = 0, Gxy = 0, Gyy = 0, D = 0, minEig = 0;
-            float prev_mx = 0, prev_my = 0;
-            int j, x, y;
-            int threadIdx = cvGetThreadNum();
-            float* patchI = _patchI[threadIdx];
-            float* patchJ = _patchJ[threadIdx];
-            float* Ix = _Ix[threadIdx];
-            float* Iy = _Iy[threadIdx];
-
-            v.x = featuresB[i].x;
-            v.y = featuresB[i].y;
-            if( l < level )
-            {
-                v.x += v.x;
-                v.y += v.y;
-            }
-            else
-            {
-                v.x = (float)(v.x * scale[l]);
-                v.y = (float)(v.y * scale[l]);
-            }
-
-            pt_status = status[i];
-            if( !pt_status )
-                continue;
-
-            minI = maxI = minJ = maxJ = cvPoint( 0, 0 );
-
-            u.x = (float) (featuresA[i].x * scale[l]);
-            u.y = (float) (featuresA[i].y * scale[l]);
-
-            intersect( u, winSize, levelSize, &minI, &maxI );
-            isz = jsz = cvSize(maxI.x - minI.x + 2, maxI.y - minI.y + 2);
-            u.x += (minI.x - (patchSize.width - maxI.x + 1))*0.5f;
-            u.y += (minI.y - (patchSize.height - maxI.y + 1))*0.5f;
-
-            if( isz.width < 3 || isz.height < 3 ||
-                icvGetRectSubPix_8u32f_C1R( imgI[l], levelStep, levelSize,
-                    patchI, isz.width*sizeof(patchI[0]), isz, u ) < 0 )
-            {
-                /* point is outside the image. take the next */
-                status[i] = 0;
-                continue;
-            }
-
-            icvCalcIxIy_32f( patchI, isz.width*sizeof(patchI[0]), Ix, Iy,
-                (isz.width-2)*sizeof(patchI[0]), isz, smoothKernel, patchJ );
-
-            for( j = 0; j < criteria.max_iter; j++ )
-            {
-                double bx = 0, by = 0;
-                float mx, my;
-                CvPoint2D32f _v;
-
-                intersect( v, winSize, levelSize, &minJ, &maxJ );
-
-                minJ.x = MAX( minJ.x, minI.x );
-                minJ.y = MAX( minJ.y, minI.y );
-
-                maxJ.x = MIN( maxJ.x, maxI.x );
-                maxJ.y = MIN( maxJ.y, maxI.y );
-
-                jsz = cvSize(maxJ.x - minJ.x, maxJ.y - minJ.y);
-
-                _v.x = v.x + (minJ.x - (patchSize.width - maxJ.x + 1))*0.5f;
-                _v.y = v.y + (minJ.y - (patchSize.height - maxJ.y + 1))*0.5f;
-
-                if( jsz.width < 1 || jsz.height < 1 ||
-                    icvGetRectSubPix_8u32f_C1R( imgJ[l], levelStep, levelSize, patchJ,
-                                                jsz.width*sizeof(patchJ[0]), jsz, _v ) < 0 )
-                {
-                    /* point is outside image. take the next */
-                    pt_status = 0;
-                    break;
-                }
-
-                if( maxJ.x == prev_maxJ.x && maxJ.y == prev_maxJ.y &&
-                    minJ.x == prev_minJ.x && minJ.y == prev_minJ.y )
-                {
-                    for( y = 0; y < jsz.height; y++ )
-                    {
-                        const float* pi = patchI +
-                            (y + minJ.y - minI.y + 1)*isz.width + minJ.x - minI.x + 1;
-                        const float* pj = patchJ + y*jsz.width;
-                        const float* ix = Ix +
-                            (y + minJ.y - minI.y)*(isz.width-2) + minJ.x - minI.x;
-                        const float* iy = Iy + (ix - Ix);
-
-                        for( x = 0; x < jsz.width; x++ )
-                        {
-                            double t0 = pi[x] - pj[x];
-                            bx += t0 * ix[x];
-                            by += t0 * iy[x];
-                        }
-                    }
-                }
-                else
-                {
-                    Gxx = Gyy = Gxy = 0;
-                    for( y = 0; y < jsz.height; y++ )
-                    {
-                        const float* pi = patchI +
-                            (y + minJ.y - minI.y + 1)*isz.width + minJ.x - minI.x + 1;
-                        const float* pj = patchJ + y*jsz.width;
-                        const float* ix = Ix +
-                            (y + minJ.y - minI.y)*(isz.width-2) + minJ.x - minI.x;
-                        const float* iy = Iy + (ix - Ix);
-
-                        for( x = 0; x < jsz.width; x++ )
-                        {
-                            double t = pi[x] - pj[x];
-                            bx += (double) (t * ix[x]);
-                            by += (double) (t * iy[x]);
-                            Gxx += ix[x] * ix[x];
-                            Gxy += ix[x] * iy[x];
-                            Gyy += iy[x] * iy[x];
-                        }
-                    }
-
-                    D = Gxx * Gyy - Gxy * Gxy;
-                    if( D < DBL_EPSILON )
-                    {
-                        pt_status = 0;
-                        break;
-                    }
-
-                    // Adi Shavit - 2008.05
-                    if( flags & CV_LKFLOW_GET_MIN_EIGENVALS )
-                        minEig = (Gyy + Gxx - sqrt((Gxx-Gyy)*(Gxx-Gyy) + 4.*Gxy*Gxy))/(2*jsz.height*jsz.width);
-
-                    D = 1. / D;
-
-                    prev_minJ = minJ;
-                    prev_maxJ = maxJ;
-                }
-
-                mx = (float) ((Gyy * bx - Gxy * by) * D);
-                my = (float) ((Gxx * by - Gxy * bx) * D);
-
-                v.x += mx;
-                v.y += my;
-
-                if( mx * mx + my * my < criteria.epsilon )
-                    break;
-
-                if( j > 0 && fabs(mx + prev_mx) < 0.01 && fabs(my + prev_my) < 0.01 )
-                {
-                    v.x -= mx*0.5f;
-                    v.y -= my*0.5f;
-                    break;
-                }
-                prev_mx = mx;
-                prev_my = my;
-            }
-
-            featuresB[i] = v;
-            status[i] = (char)pt_status;
-            if( l == 0 && error && pt_status )
-            {
-                /* calc error */
-                double err = 0;
-                if( flags & CV_LKFLOW_GET_MIN_EIGENVALS )
-                    err = minEig;
-                else
-                {
-                    for( y = 0; y < jsz.height; y++ )
-                    {
-                        const float* pi = patchI +
-                            (y + minJ.y - minI.y + 1)*isz.width + minJ.x - minI.x + 1;
-                        const float* pj = patchJ + y*jsz.width;
-
-                        for( x = 0; x < jsz.width; x++ )
-                        {
-                            double t = pi[x] - pj[x];
-                            err += t * t;
-                        }
-                    }
-                    err = sqrt(err);
-                }
-                error[i] = (float)err;
-            }
-        } // end of point processing loop (i)
-        }
+        CvLKFlowLevel job = { imgI[l], imgJ[l], levelStep, levelSize, scale[l], l, level,
+                              featuresA, featuresB, status, error, winSize, patchSize,
+                              criteria, flags, smoothKernel, _patchI, _patchJ, _Ix, _Iy };
+        cvParallelFor( count, icvCalcOpticalFlowPyrLKPoints, &job, threadCount );
     } // end of pyramid levels loop (l)
 
     __END__;
@@ -544,6 +544,74 @@ icvFindStereoCorrespondenceBM( const CvMat* left, const CvMat* right,
 }
 
 
+typedef struct CvStereoBMJob
+{
+    const CvMat* left0;
+    const CvMat* right0;
+    CvMat* left;
+    CvMat* right;
+    CvMat* disp;
+    CvStereoBMState* state;
+    int bufSize0;
+    int bufSize1;
+    int slices;
+}
+CvStereoBMJob;
+
+
+// prefilters the left (0) and/or the right (1) image, each into its own part of the buffer
+static void CV_CDECL
+icvPrefilterBM( int start, int end, void* userdata )
+{
+    const CvStereoBMJob* job = (const CvStereoBMJob*)userdata;
+    CvStereoBMState* state = job->state;
+    int i;
+
+    for( i = start; i < end; i++ )
+    {
+        if( i == 0 )
+            icvPrefilter( job->left0, job->left, state->preFilterSize,
+                state->preFilterCap, state->slidingSumBuf->data.ptr );
+        else
+            icvPrefilter( job->right0, job->right, state->preFilterSize,
+                state->preFilterCap, state->slidingSumBuf->data.ptr + job->bufSize1*(job->slices>1) );
+    }
+}
+
+
+// the disparity of horizontal slices [start,end) out of job->slices, each
+// thread with its own part of the sliding sum buffer
+static void CV_CDECL
+icvFindStereoCorrespondenceBMSlices( int start, int end, void* userdata )
+{
+    const CvStereoBMJob* job = (const CvStereoBMJob*)userdata;
+    CvStereoBMState* state = job->state;
+    uchar* buf = state->slidingSumBuf->data.ptr + cvGetThreadNum()*job->bufSize0;
+    int i, n = job->slices, rows = job->left->rows;
+
+    for( i = start; i < end; i++ )
+    {
+        CvMat left_i, right_i, disp_i;
+        int row0 = i*rows/n, row1 = (i+1)*rows/n;
+        cvGetRows( job->left, &left_i, row0, row1 );
+        cvGetRows( job->right, &right_i, row0, row1 );
+        cvGetRows( job->disp, &disp_i, row0, row1 );
+    #if CV_SSE2
+        if( state->preFilterCap <= 31 && state->SADWindowSize <= 21 )
+        {
+            icvFindStereoCorrespondenceBM_SSE2( &left_i, &right_i, &disp_i, state,
+                buf, row0, rows-row1 );
+        }
+        else
+    #endif
+        {
+            icvFindStereoCorrespondenceBM( &left_i, &right_i, &disp_i, state,
+                buf, row0, rows-row1 );
+        }
+    }
+}
+
+
 CV_IMPL void
 cvFindStereoCorrespondenceBM( const CvArr* leftarr, const CvArr* rightarr,
                               CvArr* disparr, CvStereoBMState* state )
@@ -558,7 +626,7 @@ cvFindStereoCorrespondenceBM( const CvArr* leftarr, const CvArr* rightarr,
     CvMat dstub, *disp = cvGetMat( disparr, &dstub );
     int bufSize0, bufSize1, bufSize, width, width1, height;
     int wsz, ndisp, mindisp, lofs, rofs;
-    int i, n = cvGetNumThreads();
+    int n = cvGetNumThreads();
 
     if( !CV_ARE_SIZES_EQ(left0, right0) ||
         !CV_ARE_SIZES_EQ(disp, left0) )
@@ -634,45 +702,10 @@ cvFindStereoCorrespondenceBM( const CvArr* leftarr, const CvArr* rightarr,
         state->slidingSumBuf = cvCreateMat( 1, bufSize*n, CV_8U );
     }
 
-#ifdef _OPENMP
-#pragma omp parallel sections num_threads(n)
-#endif
-    {
-    #ifdef _OPENMP
-    #pragma omp section
-    #endif
-        icvPrefilter( left0, &left, state->preFilterSize,
-            state->preFilterCap, state->slidingSumBuf->data.ptr );
-    #ifdef _OPENMP
-    #pragma omp section
-    #endif
-        icvPrefilter( right0, &right, state->preFilterSize,
-            state->preFilterCap, state->slidingSumBuf->data.ptr + bufSize1*(n>1) );
-    }
-
-#ifdef _OPENMP
-    #pragma omp parallel for num_threads(n) schedule(static)
-#endif
-    for( i = 0; i < n; i++ )
     {
-        int thread_id = cvGetThreadNum();
-        CvMat left_i, right_i, disp_i;
-        int row0 = i*left.rows/n, row1 = (i+1)*left.rows/n;
-        cvGetRows( &left, &left_i, row0, row1 );
-        cvGetRows( &right, &right_i, row0, row1 );
-        cvGetRows( disp, &disp_i, row0, row1 );
-    #if CV_SSE2
-        if( state->preFilterCap <= 31 && state->SADWindowSize <= 21 )
-        {
-            icvFindStereoCorrespondenceBM_SSE2( &left_i, &right_i, &disp_i, state,
-                state->slidingSumBuf->data.ptr + thread_id*bufSize0, row0, left.rows-row1 );
-        }
-        else
-    #endif
-        {
-            icvFindStereoCorrespondenceBM( &left_i, &right_i, &disp_i, state,
-                state->slidingSumBuf->data.ptr + thread_id*bufSize0, row0, left.rows-row1 );
-        }
+    CvStereoBMJob job = { left0, right0, &left, &right, disp, state, bufSize0, bufSize1, n };
+    cvParallelFor( 2, icvPrefilterBM, &job, MIN(n, 2) );
+    cvParallelFor( n, icvFindStereoCorrespondenceBMSlices, &job, n );
     }
 
     __END__;
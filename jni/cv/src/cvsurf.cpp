@@ -249,96 +249,45 @@ static CvSeq* icvFastHessianDetector( const CvMat* sum, const CvMat* mask_sum,
 }
 
 
-CV_IMPL void
-cvExtractSURF( const CvArr* _img, const CvArr* _mask,
-               CvSeq** _keypoints, CvSeq** _descriptors,
-               CvMemStorage* storage, CvSURFParams params )
+typedef struct CvSURFDescriptorJob
 {
-    CvMat *sum = 0, *mask1 = 0, *mask_sum = 0;
-
-    if( _keypoints )
-        *_keypoints = 0;
-    if( _descriptors )
-        *_descriptors = 0;
+    CvMat* img;
+    const CvMat* sum;
+    CvSeq* keypoints;
+    CvSeq* descriptors;
+    const CvSURFParams* params;
+    const float* G;
+    const float (*DW)[20];
+    const CvPoint* apt;
+    int nangle0;
+}
+CvSURFDescriptorJob;
 
-    CV_FUNCNAME( "cvExtractSURF" );
 
-    __BEGIN__;
-
-    CvSeq *keypoints, *descriptors = 0;
-    CvMat imghdr, *img = cvGetMat(_img, &imghdr);
-    CvMat maskhdr, *mask = _mask ? cvGetMat(_mask, &maskhdr) : 0;
-    
-    int descriptor_size = params.extended ? 128 : 64;
-    const int descriptor_data_type = CV_32F;
+/* the orientation, and the descriptor if there are any, of keypoints [start,end) */
+static void CV_CDECL
+icvSURFDescriptors( int start, int end, void* userdata )
+{
+    const CvSURFDescriptorJob* job = (const CvSURFDescriptorJob*)userdata;
+    /* the same sizes cvExtractSURF works with */
     const int NX=2, NY=2;
     const float sqrt_2 = 1.4142135623730950488016887242097f;
     const int PATCH_SZ = 20;
     const int RS_PATCH_SZ = 30; // ceil((PATCH_SZ+1)*sqrt_2);
     int dx_s[NX][5] = {{0, 0, 2, 4, -1}, {2, 0, 4, 4, 1}};
     int dy_s[NY][5] = {{0, 0, 4, 2, 1}, {0, 2, 4, 4, -1}};
-    float G[9] = {0,0,0,0,0,0,0,0,0};
-    CvMat _G = cvMat(1, 9, CV_32F, G);
-    float DW[PATCH_SZ][PATCH_SZ];
-    CvMat _DW = cvMat(PATCH_SZ, PATCH_SZ, CV_32F, DW);
-    CvPoint apt[81];
-    int i, j, k, nangle0 = 0, N;
-
-    CV_ASSERT( img != 0 && CV_MAT_TYPE(img->type) == CV_8UC1 &&
-        (mask == 0 || (CV_ARE_SIZES_EQ(img,mask) &&
-        CV_MAT_TYPE(mask->type) == CV_8UC1)) &&
-        storage != 0 && params.hessianThreshold >= 0 &&
-        params.nOctaves > 0 && params.nOctaveLayers > 0 );
-
-    sum = cvCreateMat( img->height+1, img->width+1, CV_32SC1 );
-    cvIntegral( img, sum );
-    if( mask )
-    {
-        mask1 = cvCreateMat( img->height, img->width, CV_8UC1 );
-        mask_sum = cvCreateMat( img->height+1, img->width+1, CV_32SC1 );
-        cvMinS( mask, 1, mask1 );
-        cvIntegral( mask1, mask_sum );
-    }
-    keypoints = icvFastHessianDetector( sum, mask_sum, storage, &params );
-    N = keypoints->total;
-    if( _descriptors )
-    {
-        descriptors = cvCreateSeq( 0, sizeof(CvSeq),
-            descriptor_size*CV_ELEM_SIZE(descriptor_data_type), storage );
-        cvSeqPushMulti( descriptors, 0, N );
-    }
-
-    CvSepFilter::init_gaussian_kernel( &_G, 2.5 );
-
-    {
-    const double sigma = 3.3;
-    double c2 = 1./(sigma*sigma*2), gs = 0;
-    for( i = 0; i < PATCH_SZ; i++ )
-    {
-        for( j = 0; j < PATCH_SZ; j++ )
-        {
-            double x = j - PATCH_SZ*0.5, y = i - PATCH_SZ*0.5;
-            double val = exp(-(x*x+y*y)*c2);
-            DW[i][j] = (float)val;
-            gs += val;
-        }
-    }
-    cvScale( &_DW, &_DW, 1./gs );
-    }
-
-    for( i = -4; i <= 4; i++ )
-        for( j = -4; j <= 4; j++ )
-        {
-            if( i*i + j*j <= 16 )
-                apt[nangle0++] = cvPoint(j,i);
-        }
-
-    {
-#ifdef _OPENMP
-    int nthreads = cvGetNumThreads();
-#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
-#endif
-    for( k = 0; k < N; k++ )
+    CvMat* img = job->img;
+    const CvMat* sum = job->sum;
+    CvSeq* keypoints = job->keypoints;
+    CvSeq* descriptors = job->descriptors;
+    CvSURFParams params = *job->params;
+    const float* G = job->G;
+    const float (*DW)[PATCH_SZ] = job->DW;
+    const CvPoint* apt = job->apt;
+    int nangle0 = job->nangle0;
+    int k;
+
+    for( k = start; k < end; k++ )
     {
         const int* sum_ptr = sum->data.i;
         int sum_cols = sum->cols;
@@ -408,7 +357,7 @@ cvExtractSURF( const CvArr* _img, const CvArr* _mask,
         float descriptor_dir = cvFastArctan( besty, bestx );
         kp->dir = descriptor_dir;
 
-        if( !_descriptors )
+        if( !descriptors )
             continue;
         descriptor_dir *= (float)(CV_PI/180);
         
@@ -547,6 +496,91 @@ cvExtractSURF( const CvArr* _img, const CvArr* _mask,
                 }
         }
     }
+}
+
+
+CV_IMPL void
+cvExtractSURF( const CvArr* _img, const CvArr* _mask,
+               CvSeq** _keypoints, CvSeq** _descriptors,
+               CvMemStorage* storage, CvSURFParams params )
+{
+    CvMat *sum = 0, *mask1 = 0, *mask_sum = 0;
+
+    if( _keypoints )
+        *_keypoints = 0;
+    if( _descriptors )
+        *_descriptors = 0;
+
+    CV_FUNCNAME( "cvExtractSURF" );
+
+    __BEGIN__;
+
+    CvSeq *keypoints, *descriptors = 0;
+    CvMat imghdr, *img = cvGetMat(_img, &imghdr);
+    CvMat maskhdr, *mask = _mask ? cvGetMat(_mask, &maskhdr) : 0;
+    
+    int descriptor_size = params.extended ? 128 : 64;
+    const int descriptor_data_type = CV_32F;
+    const int PATCH_SZ = 20;
+    float G[9] = {0,0,0,0,0,0,0,0,0};
+    CvMat _G = cvMat(1, 9, CV_32F, G);
+    float DW[PATCH_SZ][PATCH_SZ];
+    CvMat _DW = cvMat(PATCH_SZ, PATCH_SZ, CV_32F, DW);
+    CvPoint apt[81];
+    int i, j, nangle0 = 0, N;
+
+    CV_ASSERT( img != 0 && CV_MAT_TYPE(img->type) == CV_8UC1 &&
+        (mask == 0 || (CV_ARE_SIZES_EQ(img,mask) &&
+        CV_MAT_TYPE(mask->type) == CV_8UC1)) &&
+        storage != 0 && params.hessianThreshold >= 0 &&
+        params.nOctaves > 0 && params.nOctaveLayers > 0 );
+
+    sum = cvCreateMat( img->height+1, img->width+1, CV_32SC1 );
+    cvIntegral( img, sum );
+    if( mask )
+    {
+        mask1 = cvCreateMat( img->height, img->width, CV_8UC1 );
+        mask_sum = cvCreateMat( img->height+1, img->width+1, CV_32SC1 );
+        cvMinS( mask, 1, mask1 );
+        cvIntegral( mask1, mask_sum );
+    }
+    keypoints = icvFastHessianDetector( sum, mask_sum, storage, &params );
+    N = keypoints->total;
+    if( _descriptors )
+    {
+        descriptors = cvCreateSeq( 0, sizeof(CvSeq),
+            descriptor_size*CV_ELEM_SIZE(descriptor_data_type), storage );
+        cvSeqPushMulti( descriptors, 0, N );
+    }
+
+    CvSepFilter::init_gaussian_kernel( &_G, 2.5 );
+
+    {
+    const double sigma = 3.3;
+    double c2 = 1./(sigma*sigma*2), gs = 0;
+    for( i = 0; i < PATCH_SZ; i++ )
+    {
+        for( j = 0; j < PATCH_SZ; j++ )
+        {
+            double x = j - PATCH_SZ*0.5, y = i - PATCH_SZ*0.5;
+            double val = exp(-(x*x+y*y)*c2);
+            DW[i][j] = (float)val;
+            gs += val;
+        }
+    }
+    cvScale( &_DW, &_DW, 1./gs );
+    }
+
+    for( i = -4; i <= 4; i++ )
+        for( j = -4; j <= 4; j++ )
+        {
+            if( i*i + j*j <= 16 )
+                apt[nangle0++] = cvPoint(j,i);
+        }
+
+    {
+    CvSURFDescriptorJob job = { img, sum, keypoints, descriptors, &params, G, DW, apt, nangle0 };
+    cvParallelFor( N, icvSURFDescriptors, &job );
     }
 
     if( _keypoints )
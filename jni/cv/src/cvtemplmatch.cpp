@@ -41,6 +41,140 @@
 
 #include "_cv.h"
 
+typedef struct CvCrossCorrJob
+{
+    const CvMat* img;
+    const CvMat* templ;
+    CvMat* corr;
+    const CvMat* dft_templ;
+    CvMat** dft_img;
+    void** buf;
+    CvSize dftsize;
+    CvSize blocksize;
+    CvPoint anchor;
+    int tile_count_x;
+}
+CvCrossCorrJob;
+
+
+// correlation of tiles [start,end), each thread with its own dft_img and buf
+static void CV_CDECL
+icvCrossCorrTiles( int start, int end, void* userdata )
+{
+    const CvCrossCorrJob* job = (const CvCrossCorrJob*)userdata;
+    const CvMat* img = job->img;
+    const CvMat* templ = job->templ;
+    CvMat* corr = job->corr;
+    const CvMat* dft_templ = job->dft_templ;
+    CvSize dftsize = job->dftsize, blocksize = job->blocksize;
+    CvPoint anchor = job->anchor;
+    int tile_count_x = job->tile_count_x;
+    int depth = CV_MAT_DEPTH(img->type), cn = CV_MAT_CN(img->type);
+    int templ_cn = CV_MAT_CN(templ->type);
+    int corr_depth = CV_MAT_DEPTH(corr->type), corr_cn = CV_MAT_CN(corr->type);
+    int max_depth = CV_MAT_DEPTH(dft_templ->type);
+    int thread_idx = cvGetThreadNum();
+    CvMat* _dft_img = job->dft_img[thread_idx];
+    void* _buf = job->buf[thread_idx];
+    int k;
+
+    for( k = start; k < end; k++ )
+    {
+        int x = (k%tile_count_x)*blocksize.width;
+        int y = (k/tile_count_x)*blocksize.height;
+        int i, yofs;
+        CvMat sstub, dstub, *src, *dst, temp;
+        CvMat* planes[] = { 0, 0, 0, 0 };
+        CvSize csz = { blocksize.width, blocksize.height }, isz;
+        int x0 = x - anchor.x, y0 = y - anchor.y;
+        int x1 = MAX( 0, x0 ), y1 = MAX( 0, y0 ), x2, y2;
+        csz.width = MIN( csz.width, corr->cols - x );
+        csz.height = MIN( csz.height, corr->rows - y );
+        isz.width = csz.width + templ->cols - 1;
+        isz.height = csz.height + templ->rows - 1;
+        x2 = MIN( img->cols, x0 + isz.width );
+        y2 = MIN( img->rows, y0 + isz.height );
+        
+        for( i = 0; i < cn; i++ )
+        {
+            CvMat dstub1, *dst1;
+            yofs = i*dftsize.height;
+
+            src = cvGetSubRect( img, &sstub, cvRect(x1,y1,x2-x1,y2-y1) );
+            dst = cvGetSubRect( _dft_img, &dstub,
+                cvRect(0,0,isz.width,isz.height) );
+            dst1 = dst;
+            
+            if( x2 - x1 < isz.width || y2 - y1 < isz.height )
+                dst1 = cvGetSubRect( _dft_img, &dstub1,
+                    cvRect( x1 - x0, y1 - y0, x2 - x1, y2 - y1 ));
+
+            if( cn > 1 )
+            {
+                planes[i] = dst1;
+                if( depth != max_depth )
+                    planes[i] = cvInitMatHeader( &temp, y2 - y1, x2 - x1, depth, _buf );
+                cvSplit( src, planes[0], planes[1], planes[2], planes[3] );
+                src = planes[i];
+                planes[i] = 0;
+            }
+
+            if( dst1 != src )
+                cvConvert( src, dst1 );
+
+            if( dst != dst1 )
+                cvCopyMakeBorder( dst1, dst, cvPoint(x1 - x0, y1 - y0), IPL_BORDER_REPLICATE );
+
+            if( dftsize.width > isz.width )
+            {
+                cvGetSubRect( _dft_img, dst, cvRect(isz.width, 0,
+                      dftsize.width - isz.width,dftsize.height) );
+                cvZero( dst );
+            }
+
+            cvDFT( _dft_img, _dft_img, CV_DXT_FORWARD, isz.height );
+            cvGetSubRect( dft_templ, dst,
+                cvRect(0,(templ_cn>1?yofs:0),dftsize.width,dftsize.height) );
+
+            cvMulSpectrums( _dft_img, dst, _dft_img, CV_DXT_MUL_CONJ );
+            cvDFT( _dft_img, _dft_img, CV_DXT_INVERSE, csz.height );
+
+            src = cvGetSubRect( _dft_img, &sstub, cvRect(0,0,csz.width,csz.height) );
+            dst = cvGetSubRect( corr, &dstub, cvRect(x,y,csz.width,csz.height) );
+
+            if( corr_cn > 1 )
+            {
+                planes[i] = src;
+                if( corr_depth != max_depth )
+                {
+                    planes[i] = cvInitMatHeader( &temp, csz.height, csz.width,
+                                                 corr_depth, _buf );
+                    cvConvert( src, planes[i] );
+                }
+                cvMerge( planes[0], planes[1], planes[2], planes[3], dst );
+                planes[i] = 0;                    
+            }
+            else
+            {
+                if( i == 0 )
+                    cvConvert( src, dst );
+                else
+                {
+                    if( max_depth > corr_depth )
+                    {
+                        cvInitMatHeader( &temp, csz.height, csz.width,
+                                         corr_depth, _buf );
+                        cvConvert( src, &temp );
+                        src = &temp;
+                    }
+                    cvAcc( src, dst );
+                }
+            }
+        }
+    }
+}
+
+
 void
 icvCrossCorr( const CvArr* _img, const CvArr* _templ, CvArr* _corr, CvPoint anchor )
 {
@@ -131,7 +265,12 @@ icvCrossCorr( const CvArr* _img, const CvArr* _templ, CvArr* _corr, CvPoint anch
 
     CV_CALL( dft_templ = cvCreateMat( dftsize.height*templ_cn, dftsize.width, max_depth ));
 
-    num_threads = cvGetNumThreads();
+    tile_count_x = (corr->cols + blocksize.width - 1)/blocksize.width;
+    tile_count_y = (corr->rows + blocksize.height - 1)/blocksize.height;
+    tile_count = tile_count_x*tile_count_y;
+
+    // no more threads, and so dft buffers, than there are tiles
+    num_threads = MAX( MIN( cvGetNumThreads(), tile_count ), 1 );
 
     for( k = 0; k < num_threads; k++ )
         CV_CALL( dft_img[k] = cvCreateMat( dftsize.height, dftsize.width, max_depth ));
@@ -184,112 +323,11 @@ icvCrossCorr( const CvArr* _img, const CvArr* _templ, CvArr* _corr, CvPoint anch
         cvDFT( dst, dst, CV_DXT_FORWARD + CV_DXT_SCALE, templ->rows );
     }
 
-    tile_count_x = (corr->cols + blocksize.width - 1)/blocksize.width;
-    tile_count_y = (corr->rows + blocksize.height - 1)/blocksize.height;
-    tile_count = tile_count_x*tile_count_y;
-
-    {
-#ifdef _OPENMP
-    #pragma omp parallel for num_threads(num_threads) schedule(dynamic)
-#endif
     // calculate correlation by blocks
-    for( k = 0; k < tile_count; k++ )
     {
-        int thread_idx = cvGetThreadNum();
-        int x = (k%tile_count_x)*blocksize.width;
-        int y = (k/tile_count_x)*blocksize.height;
-        int i, yofs;
-        CvMat sstub, dstub, *src, *dst, temp;
-        CvMat* planes[] = { 0, 0, 0, 0 };
-        CvMat* _dft_img = dft_img[thread_idx];
-        void* _buf = buf[thread_idx];
-        CvSize csz = { blocksize.width, blocksize.height }, isz;
-        int x0 = x - anchor.x, y0 = y - anchor.y;
-        int x1 = MAX( 0, x0 ), y1 = MAX( 0, y0 ), x2, y2;
-        csz.width = MIN( csz.width, corr->cols - x );
-        csz.height = MIN( csz.height, corr->rows - y );
-        isz.width = csz.width + templ->cols - 1;
-        isz.height = csz.height + templ->rows - 1;
-        x2 = MIN( img->cols, x0 + isz.width );
-        y2 = MIN( img->rows, y0 + isz.height );
-        
-        for( i = 0; i < cn; i++ )
-        {
-            CvMat dstub1, *dst1;
-            yofs = i*dftsize.height;
-
-            src = cvGetSubRect( img, &sstub, cvRect(x1,y1,x2-x1,y2-y1) );
-            dst = cvGetSubRect( _dft_img, &dstub,
-                cvRect(0,0,isz.width,isz.height) );
-            dst1 = dst;
-            
-            if( x2 - x1 < isz.width || y2 - y1 < isz.height )
-                dst1 = cvGetSubRect( _dft_img, &dstub1,
-                    cvRect( x1 - x0, y1 - y0, x2 - x1, y2 - y1 ));
-
-            if( cn > 1 )
-            {
-                planes[i] = dst1;
-                if( depth != max_depth )
-                    planes[i] = cvInitMatHeader( &temp, y2 - y1, x2 - x1, depth, _buf );
-                cvSplit( src, planes[0], planes[1], planes[2], planes[3] );
-                src = planes[i];
-                planes[i] = 0;
-            }
-
-            if( dst1 != src )
-                cvConvert( src, dst1 );
-
-            if( dst != dst1 )
-                cvCopyMakeBorder( dst1, dst, cvPoint(x1 - x0, y1 - y0), IPL_BORDER_REPLICATE );
-
-            if( dftsize.width > isz.width )
-            {
-                cvGetSubRect( _dft_img, dst, cvRect(isz.width, 0,
-                      dftsize.width - isz.width,dftsize.height) );
-                cvZero( dst );
-            }
-
-            cvDFT( _dft_img, _dft_img, CV_DXT_FORWARD, isz.height );
-            cvGetSubRect( dft_templ, dst,
-                cvRect(0,(templ_cn>1?yofs:0),dftsize.width,dftsize.height) );
-
-            cvMulSpectrums( _dft_img, dst, _dft_img, CV_DXT_MUL_CONJ );
-            cvDFT( _dft_img, _dft_img, CV_DXT_INVERSE, csz.height );
-
-            src = cvGetSubRect( _dft_img, &sstub, cvRect(0,0,csz.width,csz.height) );
-            dst = cvGetSubRect( corr, &dstub, cvRect(x,y,csz.width,csz.height) );
-
-            if( corr_cn > 1 )
-            {
-                planes[i] = src;
-                if( corr_depth != max_depth )
-                {
-                    planes[i] = cvInitMatHeader( &temp, csz.height, csz.width,
-                                                 corr_depth, _buf );
-                    cvConvert( src, planes[i] );
-                }
-                cvMerge( planes[0], planes[1], planes[2], planes[3], dst );
-                planes[i] = 0;                    
-            }
-            else
-            {
-                if( i == 0 )
-                    cvConvert( src, dst );
-                else
-                {
-                    if( max_depth > corr_depth )
-                    {
-                        cvInitMatHeader( &temp, csz.height, csz.width,
-                                         corr_depth, _buf );
-                        cvConvert( src, &temp );
-                        src = &temp;
-                    }
-                    cvAcc( src, dst );
-                }
-            }
-        }
-    }
+    CvCrossCorrJob job = { img, templ, corr, dft_templ, dft_img, buf,
+                           dftsize, blocksize, anchor, tile_count_x };
+    cvParallelFor( tile_count, icvCrossCorrTiles, &job, num_threads );
     }
 
     __END__;
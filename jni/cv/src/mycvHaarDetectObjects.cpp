@@ -41,78 +41,17 @@
 
 /* Haar features calculation */
 
-#include "_cv.h"
+#include "_mycvhaar.h"
 #include <stdio.h>
 
+#if defined HAVE_NEON && defined ANDROID && defined __arm__
+#include <cpu-features.h>
+#endif
+
 /* these settings affect the quality of detection: change with care */
 #define CV_ADJUST_FEATURES 1
 #define CV_ADJUST_WEIGHTS  1
 
-typedef int sumtype;
-typedef double sqsumtype;
-
-typedef struct MyCvHidHaarFeature
-	{
-		struct
-		{
-			sumtype *p0, *p1, *p2, *p3;
-			int weight;
-		}
-		rect[CV_HAAR_FEATURE_MAX];
-	}
-	MyCvHidHaarFeature;
-
-
-typedef struct MyCvHidHaarTreeNode
-	{
-		MyCvHidHaarFeature feature;
-		int threshold;
-		int left;
-		int right;
-	}
-	MyCvHidHaarTreeNode;
-
-
-typedef struct MyCvHidHaarClassifier
-	{
-		int count;
-		//CvHaarFeature* orig_feature;
-		MyCvHidHaarTreeNode* node;
-		float* alpha;
-	}
-	MyCvHidHaarClassifier;
-
-
-typedef struct MyCvHidHaarStageClassifier
-	{
-		int  count;
-		float threshold;
-		MyCvHidHaarClassifier* classifier;
-		int two_rects;
-		
-		struct MyCvHidHaarStageClassifier* next;
-		struct MyCvHidHaarStageClassifier* child;
-		struct MyCvHidHaarStageClassifier* parent;
-	}
-	MyCvHidHaarStageClassifier;
-
-
-struct MyCvHidHaarClassifierCascade
-{
-    int  count;
-    int  is_stump_based;
-    int  has_tilted_features;
-    int  is_tree;
-    double inv_window_area;
-    CvMat sum, sqsum, tilted;
-    MyCvHidHaarStageClassifier* stage_classifier;
-    sqsumtype *pq0, *pq1, *pq2, *pq3;
-    sumtype *p0, *p1, *p2, *p3;
-	
-    void** ipp_stages;
-};
-
-
 const int icv_object_win_border = 1;
 const float icv_stage_threshold_bias = 0.0001f;
 
@@ -245,7 +184,9 @@ myicvCreateHidHaarClassifierCascade( CvHaarClassifierCascade* cascade )
 	sizeof(MyCvHidHaarStageClassifier)*cascade->count +
 	sizeof(MyCvHidHaarClassifier) * total_classifiers +
 	sizeof(MyCvHidHaarTreeNode) * total_nodes +
-	sizeof(void*)*(total_nodes + total_classifiers);
+	sizeof(void*)*(total_nodes + total_classifiers) +
+	sizeof(MyCvHaarFlatStage)*cascade->count +
+	sizeof(MyCvHaarFlatStump)*total_classifiers + sizeof(void*);
 	
     CV_CALL( out = (MyCvHidHaarClassifierCascade*)cvAlloc( datasize ));
     memset( out, 0, sizeof(*out) );
@@ -317,6 +258,40 @@ myicvCreateHidHaarClassifierCascade( CvHaarClassifierCascade* cascade )
         }
     }
 	
+    /* the flattened copy takes the thresholds and alphas now, the offsets
+       and weights change with the scale and are filled in by
+       mycvSetImagesForHaarClassifierCascade */
+    if( out->is_stump_based && !out->has_tilted_features && !out->is_tree )
+    {
+        MyCvHaarFlatStump* flat_stump;
+		
+        out->flat_stage = (MyCvHaarFlatStage*)cvAlignPtr( haar_node_ptr, sizeof(void*) );
+        flat_stump = (MyCvHaarFlatStump*)(out->flat_stage + cascade->count);
+		
+        for( i = 0; i < cascade->count; i++ )
+        {
+            MyCvHidHaarStageClassifier* hid_stage_classifier = out->stage_classifier + i;
+            MyCvHaarFlatStage* flat_stage = out->flat_stage + i;
+			
+            flat_stage->count = hid_stage_classifier->count;
+            flat_stage->threshold = hid_stage_classifier->threshold;
+            flat_stage->two_rects = hid_stage_classifier->two_rects;
+            flat_stage->stump = flat_stump;
+			
+            for( j = 0; j < hid_stage_classifier->count; j++, flat_stump++ )
+            {
+                MyCvHidHaarClassifier* hid_classifier = hid_stage_classifier->classifier + j;
+				
+                memset( flat_stump, 0, sizeof(*flat_stump) );
+                flat_stump->threshold = hid_classifier->node->threshold;
+                flat_stump->alpha[0] = hid_classifier->alpha[0];
+                flat_stump->alpha[1] = hid_classifier->alpha[1];
+            }
+        }
+		
+        haar_node_ptr = (MyCvHidHaarTreeNode*)flat_stump;
+    }
+	
     /*{
 	 int can_use_ipp = icvHaarClassifierInitAlloc_32f_p != 0 &&
 	 icvHaarClassifierFree_32f_p != 0 &&
@@ -422,6 +397,31 @@ double myicvEvalHidHaarClassifier( MyCvHidHaarClassifier* classifier,
     return classifier->alpha[-idx];
 }
 
+/* the standard deviation of the window at p_offset (pq_offset in the square
+   sum), truncated to the integer the stump thresholds are scaled by */
+CV_INLINE
+int myicvHaarWindowNorm( const MyCvHidHaarClassifierCascade* cascade,
+						int p_offset, int pq_offset )
+{
+	int pq0, pq1, pq2, pq3;
+    double mean;
+	int variance_norm_factor;
+	
+    mean = calc_sum(*cascade,p_offset) * cascade->inv_window_area;
+	pq0 = cascade->pq0[pq_offset];
+	pq1 = cascade->pq1[pq_offset];
+	pq2 = cascade->pq2[pq_offset];
+	pq3 = cascade->pq3[pq_offset];
+    variance_norm_factor = pq0 - pq1 - pq2 + pq3;
+    variance_norm_factor = variance_norm_factor * cascade->inv_window_area - mean * mean;
+    if( variance_norm_factor >= 0. )
+        variance_norm_factor = sqrt(variance_norm_factor);
+    else
+        variance_norm_factor = 1.;
+	
+    return variance_norm_factor;
+}
+
 /*********************** Special integer sqrt **************************/
 
 int
@@ -459,7 +459,7 @@ unsigned int isqrt1(int number) {
 	unsigned int n  = 1;
 	unsigned int n1 = NEXT(n, number);
 	
-	while(abs(n1 - n) > 1) {
+	while(abs((int)(n1 - n)) > 1) {
 		n  = n1;
 		n1 = NEXT(n, number);
 	}
@@ -480,9 +480,7 @@ mycvRunHaarClassifierCascade( CvHaarClassifierCascade* _cascade,
     __BEGIN__;
 	
     int p_offset, pq_offset;
-	int pq0, pq1, pq2, pq3;
     int i, j;
-    double mean;
 	int variance_norm_factor;
     MyCvHidHaarClassifierCascade* cascade;
 	
@@ -501,17 +499,7 @@ mycvRunHaarClassifierCascade( CvHaarClassifierCascade* _cascade,
 	
     p_offset = pt.y * (cascade->sum.step/sizeof(sumtype)) + pt.x;
     pq_offset = pt.y * (cascade->sqsum.step/sizeof(sqsumtype)) + pt.x;
-    mean = calc_sum(*cascade,p_offset) * cascade->inv_window_area;
-	pq0 = cascade->pq0[pq_offset];
-	pq1 = cascade->pq1[pq_offset];
-	pq2 = cascade->pq2[pq_offset];
-	pq3 = cascade->pq3[pq_offset];
-    variance_norm_factor = pq0 - pq1 - pq2 + pq3;
-    variance_norm_factor = variance_norm_factor * cascade->inv_window_area - mean * mean;
-    if( variance_norm_factor >= 0. )
-        variance_norm_factor = sqrt(variance_norm_factor);
-    else
-        variance_norm_factor = 1.;
+    variance_norm_factor = myicvHaarWindowNorm( cascade, p_offset, pq_offset );
 	
 //    if( cascade->is_tree )
 //    {
@@ -623,6 +611,35 @@ mycvRunHaarClassifierCascade( CvHaarClassifierCascade* _cascade,
 ((sqsumtype*)CV_MAT_ELEM_PTR_FAST((sqsum),(row),(col),sizeof(sqsumtype)))
 
 
+/* the rectangles of the scale just set, as offsets from the window corner */
+static void
+myicvFlattenHaarStumps( MyCvHidHaarClassifierCascade* cascade, int count )
+{
+    const sumtype* origin = cascade->sum.data.i;
+    int i, j, k;
+	
+    for( i = 0; i < count; i++ )
+    {
+        MyCvHidHaarStageClassifier* stage_classifier = cascade->stage_classifier + i;
+        MyCvHaarFlatStump* flat_stump = cascade->flat_stage[i].stump;
+		
+        for( j = 0; j < stage_classifier->count; j++, flat_stump++ )
+        {
+            MyCvHidHaarFeature* hidfeature = &stage_classifier->classifier[j].node->feature;
+			
+            for( k = 0; k < CV_HAAR_FEATURE_MAX && hidfeature->rect[k].p0; k++ )
+            {
+                flat_stump->ofs[k][0] = (int)(hidfeature->rect[k].p0 - origin);
+                flat_stump->ofs[k][1] = (int)(hidfeature->rect[k].p1 - origin);
+                flat_stump->ofs[k][2] = (int)(hidfeature->rect[k].p2 - origin);
+                flat_stump->ofs[k][3] = (int)(hidfeature->rect[k].p3 - origin);
+                flat_stump->weight[k] = hidfeature->rect[k].weight;
+            }
+        }
+    }
+}
+
+
 CV_IMPL void
 mycvSetImagesForHaarClassifierCascade( CvHaarClassifierCascade* _cascade,
 									const CvArr* _sum,
@@ -862,22 +879,526 @@ mycvSetImagesForHaarClassifierCascade( CvHaarClassifierCascade* _cascade,
 		}
     }
 	
+    if( cascade->flat_stage )
+        myicvFlattenHaarStumps( cascade, _cascade->count );
+	
     __END__;
 }
 
+/* stages [start_stage,end_stage) of the window at p_offset over the
+   flattened stumps, norm being its myicvHaarWindowNorm. Returns what
+   mycvRunHaarClassifierCascade would, stopping short at end_stage */
+CV_INLINE int
+myicvRunHaarStumps( const MyCvHidHaarClassifierCascade* cascade,
+                    int p_offset, int norm, int start_stage, int end_stage )
+{
+    const sumtype* s = cascade->sum.data.i + p_offset;
+    int i, j;
+	
+    for( i = start_stage; i < end_stage; i++ )
+    {
+        const MyCvHaarFlatStage* stage = cascade->flat_stage + i;
+        const MyCvHaarFlatStump* stump = stage->stump;
+        double stage_sum = 0;
+		
+        for( j = 0; j < stage->count; j++, stump++ )
+        {
+            int t = stump->threshold * norm;
+            int sum = (s[stump->ofs[0][0]] - s[stump->ofs[0][1]] -
+                       s[stump->ofs[0][2]] + s[stump->ofs[0][3]]) * stump->weight[0];
+            sum += (s[stump->ofs[1][0]] - s[stump->ofs[1][1]] -
+                    s[stump->ofs[1][2]] + s[stump->ofs[1][3]]) * stump->weight[1];
+            if( !stage->two_rects )
+                sum += (s[stump->ofs[2][0]] - s[stump->ofs[2][1]] -
+                        s[stump->ofs[2][2]] + s[stump->ofs[2][3]]) * stump->weight[2];
+            stage_sum += stump->alpha[sum >= t];
+        }
+		
+        if( stage_sum < stage->threshold )
+            return -i;
+    }
+	
+    return 1;
+}
+
+
+/* stage 0 of four windows at once, the test that turns most windows away.
+   p_offset and norm are as above for each of them, the bits set in the
+   result are the windows that get through. The integer sums wrap the way the
+   scalar ones do and each window's stage sum is added up in double in the
+   same order, so the answer is the same bit for bit */
+#if CV_SSE2
+
+/* the low 32 bits of each product, sse2 has no pmulld */
+CV_INLINE __m128i myicvMulLo32( __m128i a, __m128i b )
+{
+    __m128i even = _mm_mul_epu32( a, b );
+    __m128i odd = _mm_mul_epu32( _mm_srli_epi64( a, 32 ), _mm_srli_epi64( b, 32 ));
+    return _mm_unpacklo_epi32( _mm_shuffle_epi32( even, _MM_SHUFFLE(0,0,2,0) ),
+                               _mm_shuffle_epi32( odd, _MM_SHUFFLE(0,0,2,0) ));
+}
+
+/* myicvHaarWindowNorm of four windows. The integer parts are done as they are
+   there, the double ones two windows to a register with the same roundings
+   and truncations */
+static void
+myicvHaarWindowNorm4( const MyCvHidHaarClassifierCascade* cascade,
+                      const int* p_offset, const int* pq_offset, int* norm )
+{
+    const double inv = cascade->inv_window_area;
+    __m128d vinv = _mm_set1_pd( inv );
+    __m128i sum = _mm_setr_epi32( calc_sum(*cascade,p_offset[0]), calc_sum(*cascade,p_offset[1]),
+                                  calc_sum(*cascade,p_offset[2]), calc_sum(*cascade,p_offset[3]) );
+    __m128i sqsum, var, root;
+    __m128d mean01, mean23, var01, var23;
+    int pq[4], k;
+	
+    for( k = 0; k < 4; k++ )
+    {
+        int o = pq_offset[k];
+        int pq0 = cascade->pq0[o], pq1 = cascade->pq1[o], pq2 = cascade->pq2[o], pq3 = cascade->pq3[o];
+        pq[k] = pq0 - pq1 - pq2 + pq3;
+    }
+    sqsum = _mm_loadu_si128( (const __m128i*)pq );
+	
+    mean01 = _mm_mul_pd( _mm_cvtepi32_pd( sum ), vinv );
+    mean23 = _mm_mul_pd( _mm_cvtepi32_pd( _mm_srli_si128( sum, 8 )), vinv );
+    var01 = _mm_sub_pd( _mm_mul_pd( _mm_cvtepi32_pd( sqsum ), vinv ), _mm_mul_pd( mean01, mean01 ));
+    var23 = _mm_sub_pd( _mm_mul_pd( _mm_cvtepi32_pd( _mm_srli_si128( sqsum, 8 )), vinv ),
+                        _mm_mul_pd( mean23, mean23 ));
+    var = _mm_unpacklo_epi64( _mm_cvttpd_epi32( var01 ), _mm_cvttpd_epi32( var23 ));
+	
+    root = _mm_unpacklo_epi64( _mm_cvttpd_epi32( _mm_sqrt_pd( _mm_cvtepi32_pd( var ))),
+                               _mm_cvttpd_epi32( _mm_sqrt_pd( _mm_cvtepi32_pd(
+                                                 _mm_srli_si128( var, 8 )))));
+	
+    /* a negative variance counts as 1 */
+    {
+        __m128i negative = _mm_cmplt_epi32( var, _mm_setzero_si128() );
+        root = _mm_or_si128( _mm_andnot_si128( negative, root ),
+                             _mm_and_si128( negative, _mm_set1_epi32( 1 )));
+    }
+    _mm_storeu_si128( (__m128i*)norm, root );
+}
+
+#define MY_HAAR_RECT_SUM4(s,o) \
+_mm_setr_epi32( (s)[0][(o)[0]] - (s)[0][(o)[1]] - (s)[0][(o)[2]] + (s)[0][(o)[3]], \
+                (s)[1][(o)[0]] - (s)[1][(o)[1]] - (s)[1][(o)[2]] + (s)[1][(o)[3]], \
+                (s)[2][(o)[0]] - (s)[2][(o)[1]] - (s)[2][(o)[2]] + (s)[2][(o)[3]], \
+                (s)[3][(o)[0]] - (s)[3][(o)[1]] - (s)[3][(o)[2]] + (s)[3][(o)[3]] )
+
+static int
+myicvPassHaarStage4( const MyCvHidHaarClassifierCascade* cascade,
+                     const int* p_offset, const int* norm )
+{
+    const MyCvHaarFlatStage* stage = cascade->flat_stage;
+    const MyCvHaarFlatStump* stump = stage->stump;
+    const sumtype* s[4];
+    __m128i vnorm = _mm_loadu_si128( (const __m128i*)norm );
+    __m128d stage_sum01 = _mm_setzero_pd(), stage_sum23 = _mm_setzero_pd();
+    __m128d threshold = _mm_set1_pd( stage->threshold );
+    int j, k;
+	
+    for( k = 0; k < 4; k++ )
+        s[k] = cascade->sum.data.i + p_offset[k];
+	
+    for( j = 0; j < stage->count; j++, stump++ )
+    {
+        __m128i t = myicvMulLo32( _mm_set1_epi32( stump->threshold ), vnorm );
+        __m128i sum = myicvMulLo32( MY_HAAR_RECT_SUM4( s, stump->ofs[0] ),
+                                    _mm_set1_epi32( stump->weight[0] ));
+        __m128i left;
+        __m128d alpha0, alpha1, left01, left23;
+		
+        sum = _mm_add_epi32( sum, myicvMulLo32( MY_HAAR_RECT_SUM4( s, stump->ofs[1] ),
+                                                _mm_set1_epi32( stump->weight[1] )));
+        if( !stage->two_rects )
+            sum = _mm_add_epi32( sum, myicvMulLo32( MY_HAAR_RECT_SUM4( s, stump->ofs[2] ),
+                                                    _mm_set1_epi32( stump->weight[2] )));
+		
+        /* the windows that take alpha[0], widened to the double lanes */
+        left = _mm_cmplt_epi32( sum, t );
+        left01 = _mm_castsi128_pd( _mm_unpacklo_epi32( left, left ));
+        left23 = _mm_castsi128_pd( _mm_unpackhi_epi32( left, left ));
+        alpha0 = _mm_set1_pd( stump->alpha[0] );
+        alpha1 = _mm_set1_pd( stump->alpha[1] );
+		
+        stage_sum01 = _mm_add_pd( stage_sum01, _mm_or_pd( _mm_and_pd( left01, alpha0 ),
+                                                          _mm_andnot_pd( left01, alpha1 )));
+        stage_sum23 = _mm_add_pd( stage_sum23, _mm_or_pd( _mm_and_pd( left23, alpha0 ),
+                                                          _mm_andnot_pd( left23, alpha1 )));
+    }
+	
+    return _mm_movemask_pd( _mm_cmpnlt_pd( stage_sum01, threshold )) |
+           (_mm_movemask_pd( _mm_cmpnlt_pd( stage_sum23, threshold )) << 2);
+}
+
+#undef MY_HAAR_RECT_SUM4
+
+#define myicvGetPassHaarStage4() myicvPassHaarStage4
+
+#else
+
+/* no vector unit to speak of (or not one the whole abi has), one window
+   after another */
+static int
+myicvPassHaarStage4( const MyCvHidHaarClassifierCascade* cascade,
+                     const int* p_offset, const int* norm )
+{
+    int k, passed = 0;
+	
+    for( k = 0; k < 4; k++ )
+        if( myicvRunHaarStumps( cascade, p_offset[k], norm[k], 0, 1 ) == 1 )
+            passed |= 1 << k;
+	
+    return passed;
+}
+
+#ifdef HAVE_NEON
+/* the neon stage 0 where the cpu has it. There's no cpufeatures off android,
+   so there the build is trusted */
+static MyCvHaarPassStage4Func
+myicvGetPassHaarStage4( void )
+{
+    static MyCvHaarPassStage4Func pass_stage4 = 0;
+	
+    if( !pass_stage4 )
+    {
+#if defined ANDROID && defined __arm__
+        pass_stage4 = android_getCpuFamily() == ANDROID_CPU_FAMILY_ARM &&
+                      (android_getCpuFeatures() & ANDROID_CPU_ARM_FEATURE_NEON) ?
+                      myicvPassHaarStage4Neon : myicvPassHaarStage4;
+#else
+        pass_stage4 = myicvPassHaarStage4Neon;
+#endif
+    }
+	
+    return pass_stage4;
+}
+#else
+#define myicvGetPassHaarStage4() myicvPassHaarStage4
+#endif
+
+/* no double lanes (armv7 neon hasn't any either), the norms go one at a time */
+static void
+myicvHaarWindowNorm4( const MyCvHidHaarClassifierCascade* cascade,
+                      const int* p_offset, const int* pq_offset, int* norm )
+{
+    int k;
+    for( k = 0; k < 4; k++ )
+        norm[k] = myicvHaarWindowNorm( cascade, p_offset[k], pq_offset[k] );
+}
+
+#endif
+
+
+/* one scale's worth of window scanning, handed out a row at a time */
+typedef struct MyCvHaarScanJob
+{
+    CvHaarClassifierCascade* cascade;
+    CvMat* mask;
+    CvSeq** seq_thread;
+    double ystep;
+    double scale;   /* from the scanned image to the caller's one */
+    CvSize win_size;
+    int start_x, end_x, start_y;
+    int pass, npass, stage_offset;
+}
+MyCvHaarScanJob;
+
+
+/* the first pass of a two pass scan over rows [start,end), four rows at a
+   time. Along a row the next window depends on how the last one did (2 on
+   after one that fails stage 0 or gets through the pass, 1 on after one that
+   fails later), so each row keeps its own place and the four windows tested
+   together are one from each. The pass only marks the mask, so it doesn't
+   matter that the rows finish in a different order. A lane whose window is
+   too near the edge for mycvRunHaarClassifierCascade, or that has run out of
+   rows, tests the top left window and its answer is thrown away */
+static void
+myicvScanHaarRowsBatched( const MyCvHaarScanJob* job, int start, int end )
+{
+    CvHaarClassifierCascade* cascade = job->cascade;
+    MyCvHidHaarClassifierCascade* hid = (MyCvHidHaarClassifierCascade*)cascade->hid_cascade;
+    int sum_step = hid->sum.step/sizeof(sumtype);
+    int sqsum_step = hid->sqsum.step/sizeof(sqsumtype);
+    int max_x = hid->sum.width - 2 - cascade->real_window_size.width;
+    int max_y = hid->sum.height - 2 - cascade->real_window_size.height;
+    int iy[4], _ix[4];
+    uchar* mask_row[4];
+    MyCvHaarPassStage4Func pass_stage4 = myicvGetPassHaarStage4();
+    int _iy = job->start_y + start, k, active = 0;
+	
+    for( ;; )
+    {
+        int ix[4], p_offset[4], pq_offset[4], norm[4];
+        int inside = 0, passed, result;
+		
+        /* rows that are done hand their lane on to the next one */
+        for( k = 0; k < 4; k++ )
+        {
+            if( (active & (1 << k)) && _ix[k] < job->end_x )
+                continue;
+            active &= ~(1 << k);
+            if( _iy < job->start_y + end && job->start_x < job->end_x )
+            {
+                iy[k] = cvRound(_iy*job->ystep);
+                _ix[k] = job->start_x;
+                mask_row[k] = job->mask->data.ptr + job->mask->step * iy[k];
+                active |= 1 << k;
+                _iy++;
+            }
+        }
+		
+        if( !active )
+            break;
+		
+        for( k = 0; k < 4; k++ )
+        {
+            p_offset[k] = pq_offset[k] = 0;
+            if( active & (1 << k) )
+            {
+                ix[k] = cvRound(_ix[k]*job->ystep);
+                if( ix[k] < max_x && iy[k] < max_y )
+                {
+                    p_offset[k] = iy[k]*sum_step + ix[k];
+                    pq_offset[k] = iy[k]*sqsum_step + ix[k];
+                    inside |= 1 << k;
+                }
+            }
+        }
+		
+        myicvHaarWindowNorm4( hid, p_offset, pq_offset, norm );
+        passed = pass_stage4( hid, p_offset, norm );
+		
+        for( k = 0; k < 4; k++ )
+        {
+            if( !(active & (1 << k)) )
+                continue;
+            if( !(inside & (1 << k)) )
+                result = -1;
+            else if( passed & (1 << k) )
+                result = myicvRunHaarStumps( hid, p_offset[k], norm[k], 1, hid->count );
+            else
+                result = 0;
+            if( result > 0 )
+                mask_row[k][ix[k]] = 1;
+            _ix[k] += result < 0 ? 1 : 2;
+        }
+    }
+}
+
+
+/* rows [start,end) (from job->start_y) of one pass over one scale. Every
+   thread pushes what it finds into its own seq_thread list */
+static void CV_CDECL
+myicvScanHaarRows( int start, int end, void* userdata )
+{
+    const MyCvHaarScanJob* job = (const MyCvHaarScanJob*)userdata;
+    CvHaarClassifierCascade* cascade = job->cascade;
+    MyCvHidHaarClassifierCascade* hid = (MyCvHidHaarClassifierCascade*)cascade->hid_cascade;
+    CvSeq* seq = job->seq_thread[cvGetThreadNum()];
+    CvSize win_size = job->win_size;
+    int pass = job->pass, npass = job->npass;
+    int _iy;
+
+    if( pass == 0 && npass > 1 && hid->flat_stage )
+    {
+        myicvScanHaarRowsBatched( job, start, end );
+        return;
+    }
+
+    for( _iy = job->start_y + start; _iy < job->start_y + end; _iy++ )
+    {
+        int iy = cvRound(_iy*job->ystep);
+        int _ix, _xstep = 1;
+        uchar* mask_row = job->mask->data.ptr + job->mask->step * iy;
+
+        for( _ix = job->start_x; _ix < job->end_x; _ix += _xstep )
+        {
+            int ix = cvRound(_ix*job->ystep); // it really should be ystep
+
+            if( pass == 0 )
+            {
+                int result;
+                _xstep = 2;
+
+                result = mycvRunHaarClassifierCascade( cascade, cvPoint(ix,iy), 0 );
+                if( result > 0 )
+                {
+                    if( pass < npass - 1 )
+                        mask_row[ix] = 1;
+                    else
+                    {
+                        CvRect rect = cvRect(cvRound(ix*job->scale),cvRound(iy*job->scale),
+                                             win_size.width,win_size.height);
+                        cvSeqPush( seq, &rect );
+                    }
+                }
+                if( result < 0 )
+                    _xstep = 1;
+            }
+            else if( mask_row[ix] )
+            {
+                int result = mycvRunHaarClassifierCascade( cascade, cvPoint(ix,iy),
+                                                           job->stage_offset );
+                if( result > 0 )
+                {
+                    if( pass == npass - 1 )
+                    {
+                        CvRect rect = cvRect(cvRound(ix*job->scale),cvRound(iy*job->scale),
+                                             win_size.width,win_size.height);
+                        cvSeqPush( seq, &rect );
+                    }
+                }
+                else
+                    mask_row[ix] = 0;
+            }
+        }
+    }
+}
+
+
+/* runs the passes of one scale over its rows, the first npass-1 of them only
+   as far as split_stage and the last one through the rest of the cascade on
+   whatever they left in the mask */
+static void
+myicvScanHaarScale( MyCvHaarScanJob* job, int rows, int split_stage, int max_threads )
+{
+    CvHaarClassifierCascade* cascade = job->cascade;
+    MyCvHidHaarClassifierCascade* hid = (MyCvHidHaarClassifierCascade*)cascade->hid_cascade;
+
+    hid->count = split_stage;
+
+    for( job->pass = 0; job->pass < job->npass; job->pass++ )
+    {
+        cvParallelFor( rows, myicvScanHaarRows, job, max_threads );
+        job->stage_offset = hid->count;
+        hid->count = cascade->count;
+    }
+}
+
+
+static int myicvCmpRectsRowMajor( const void* _r1, const void* _r2 )
+{
+    const CvRect* r1 = (const CvRect*)_r1;
+    const CvRect* r2 = (const CvRect*)_r2;
+
+    return r1->y != r2->y ? (r1->y < r2->y ? -1 : 1) :
+           r1->x != r2->x ? (r1->x < r2->x ? -1 : 1) : 0;
+}
+
+
+/* moves one scale's hits from the per thread lists onto the end of seq, in
+   the row major order a single thread would have found them in, so the
+   grouping afterwards doesn't depend on how the rows were shared out */
+static void
+myicvGatherHaarRects( CvSeq* seq, CvSeq** seq_thread, int max_threads )
+{
+    CvRect* rects = 0;
+
+    CV_FUNCNAME( "myicvGatherHaarRects" );
+
+    __BEGIN__;
+
+    int i, total = 0;
+
+    for( i = 0; i < max_threads; i++ )
+        total += seq_thread[i]->total;
+
+    if( total == 0 )
+        EXIT;
+
+    CV_CALL( rects = (CvRect*)cvAlloc( total*sizeof(rects[0]) ));
+
+    for( i = 0, total = 0; i < max_threads; i++ )
+    {
+        cvCvtSeqToArray( seq_thread[i], rects + total );
+        total += seq_thread[i]->total;
+        /* the next scale starts with empty per thread lists */
+        cvClearSeq( seq_thread[i] );
+    }
+
+    qsort( rects, total, sizeof(rects[0]), myicvCmpRectsRowMajor );
+    CV_CALL( cvSeqPushMulti( seq, rects, total ));
+
+    __END__;
+
+    cvFree( &rects );
+}
+
+
+/* how far round each track the next frame is searched, as a share of its size */
+#define MYCV_HAAR_TRACK_MARGIN  0.5
+
+/* the parts of the frame worth searching with windows of win_size: round each
+   track no more than two scale steps off that size, grown by
+   MYCV_HAAR_TRACK_MARGIN and merged where they overlap so that no window is
+   tried twice. Returns how many boxes it has put in boxes */
+static int
+myicvHaarTrackBoxes( const CvAvgComp* tracks, int track_count, CvSize win_size,
+                     double scale_factor, CvSize img_size, CvRect* boxes )
+{
+    double max_ratio = scale_factor*scale_factor;
+    int i, j, count = 0;
+
+    for( i = 0; i < track_count; i++ )
+    {
+        CvRect r = tracks[i].rect;
+        int dx = cvRound( r.width*MYCV_HAAR_TRACK_MARGIN );
+        int dy = cvRound( r.height*MYCV_HAAR_TRACK_MARGIN );
+        int x0, y0, x1, y1;
+
+        if( win_size.width*max_ratio < r.width || r.width*max_ratio < win_size.width )
+            continue;
+
+        x0 = MAX( r.x - dx, 0 );
+        y0 = MAX( r.y - dy, 0 );
+        x1 = MIN( r.x + r.width + dx, img_size.width );
+        y1 = MIN( r.y + r.height + dy, img_size.height );
+
+        /* swallow every box this one touches, starting again after each
+           since the grown box can reach ones it didn't before */
+        for( j = 0; j < count; )
+        {
+            CvRect b = boxes[j];
+            if( b.x < x1 && x0 < b.x + b.width && b.y < y1 && y0 < b.y + b.height )
+            {
+                x0 = MIN( x0, b.x );
+                y0 = MIN( y0, b.y );
+                x1 = MAX( x1, b.x + b.width );
+                y1 = MAX( y1, b.y + b.height );
+                boxes[j] = boxes[--count];
+                j = 0;
+            }
+            else
+                j++;
+        }
+
+        boxes[count++] = cvRect( x0, y0, x1 - x0, y1 - y0 );
+    }
+
+    return count;
+}
+
+
 CvMat *temp = 0, *sum = 0, *sqsum = 0;
 double tickFreqTimes1000 = ((double)cvGetTickFrequency()*1000.);
 
-CV_IMPL CvSeq*
-mycvHaarDetectObjects( const CvArr* _img,
+/* mycvHaarDetectObjects, except that given tracks it only searches round
+   them (see myicvHaarTrackBoxes), always with the cascade scaled up */
+static CvSeq*
+myicvHaarDetectObjects( const CvArr* _img,
 					CvHaarClassifierCascade* cascade,
 					CvMemStorage* storage, double scale_factor,
-					int min_neighbors, int flags, CvSize min_size )
+					int min_neighbors, int flags, CvSize min_size,
+					const CvAvgComp* tracks, int track_count )
 {
     int split_stage = 2;
 	
     CvMat stub, *img = (CvMat*)_img;
-    CvMat  *tilted = 0, *norm_img = 0, *sumcanny = 0, *img_small = 0;
+    CvMat  *tilted = 0, *norm_img = 0, *sumcanny = 0, *img_small = 0, *mask_small = 0;
+    CvRect* boxes = 0;
     CvSeq* result_seq = 0;
     CvMemStorage* temp_storage = 0;
     CvAvgComp* comps = 0;
@@ -915,9 +1436,12 @@ mycvHaarDetectObjects( const CvArr* _img,
     if( scale_factor <= 1 )
         CV_ERROR( CV_StsOutOfRange, "scale factor must be > 1" );
 	
-    if( find_biggest_object )
+    if( find_biggest_object || track_count > 0 )
         flags &= ~CV_HAAR_SCALE_IMAGE;
 	
+    if( track_count > 0 )
+        CV_CALL( boxes = (CvRect*)cvAlloc( track_count*sizeof(boxes[0]) ));
+	
 	if(!temp) {
 		CV_CALL( temp = cvCreateMat( img->rows, img->cols, CV_8UC1 ));
 	}
@@ -960,164 +1484,76 @@ mycvHaarDetectObjects( const CvArr* _img,
     if( flags & CV_HAAR_FIND_BIGGEST_OBJECT )
         flags &= ~(CV_HAAR_SCALE_IMAGE|CV_HAAR_DO_CANNY_PRUNING);
 	
-//    if( flags & CV_HAAR_SCALE_IMAGE )
-//    {
-//        CvSize win_size0 = cascade->orig_window_size;
-//        /*int use_ipp = cascade->hid_cascade->ipp_stages != 0 &&
-//		 icvApplyHaarClassifier_32f_C1R_p != 0;
-//		 
-//		 if( use_ipp )
-//		 CV_CALL( norm_img = cvCreateMat( img->rows, img->cols, CV_32FC1 ));*/
-//        CV_CALL( img_small = cvCreateMat( img->rows + 1, img->cols + 1, CV_8UC1 ));
-//		
-//        for( factor = 1; ; factor *= scale_factor )
-//        {
-//            int strip_count, strip_size;
-//            int ystep = factor > 2. ? 1 : 2;
-//            CvSize win_size = { cvRound(win_size0.width*factor),
-//			cvRound(win_size0.height*factor) };
-//            CvSize sz = { cvRound( img->cols/factor ), cvRound( img->rows/factor ) };
-//            CvSize sz1 = { sz.width - win_size0.width, sz.height - win_size0.height };
-//            /*CvRect equ_rect = { icv_object_win_border, icv_object_win_border,
-//			 win_size0.width - icv_object_win_border*2,
-//			 win_size0.height - icv_object_win_border*2 };*/
-//            CvMat img1, sum1, sqsum1, norm1, tilted1, mask1;
-//            CvMat* _tilted = 0;
-//			
-//            if( sz1.width <= 0 || sz1.height <= 0 )
-//                break;
-//            if( win_size.width < min_size.width || win_size.height < min_size.height )
-//                continue;
-//			
-//            img1 = cvMat( sz.height, sz.width, CV_8UC1, img_small->data.ptr );
-//            sum1 = cvMat( sz.height+1, sz.width+1, CV_32SC1, sum->data.ptr );
-//            sqsum1 = cvMat( sz.height+1, sz.width+1, CV_64FC1, sqsum->data.ptr );
-//            if( tilted )
-//            {
-//                tilted1 = cvMat( sz.height+1, sz.width+1, CV_32SC1, tilted->data.ptr );
-//                _tilted = &tilted1;
-//            }
-//            norm1 = cvMat( sz1.height, sz1.width, CV_32FC1, norm_img ? norm_img->data.ptr : 0 );
-//            mask1 = cvMat( sz1.height, sz1.width, CV_8UC1, temp->data.ptr );
-//			
-//            cvResize( img, &img1, CV_INTER_LINEAR );
-//            cvIntegral( &img1, &sum1, &sqsum1, _tilted );
-//			
-//            if( max_threads > 1 )
-//            {
-//                strip_count = MAX(MIN(sz1.height/ystep, max_threads*3), 1);
-//                strip_size = (sz1.height + strip_count - 1)/strip_count;
-//                strip_size = (strip_size / ystep)*ystep;
-//            }
-//            else
-//            {
-//                strip_count = 1;
-//                strip_size = sz1.height;
-//            }
-//			
-//            //if( !use_ipp )
-//			cvSetImagesForHaarClassifierCascade( cascade, &sum1, &sqsum1, 0, 1. );
-//            /*else
-//			 {
-//			 for( i = 0; i <= sz.height; i++ )
-//			 {
-//			 const int* isum = (int*)(sum1.data.ptr + sum1.step*i);
-//			 float* fsum = (float*)isum;
-//			 const int FLT_DELTA = -(1 << 24);
-//			 int j;
-//			 for( j = 0; j <= sz.width; j++ )
-//			 fsum[j] = (float)(isum[j] + FLT_DELTA);
-//			 }
-//			 }*/
-//			
-//#ifdef _OPENMP
-//#pragma omp parallel for num_threads(max_threads) schedule(dynamic)
-//#endif
-//            for( i = 0; i < strip_count; i++ )
-//            {
-//                int thread_id = cvGetThreadNum();
-//                int positive = 0;
-//                int y1 = i*strip_size, y2 = (i+1)*strip_size/* - ystep + 1*/;
-//                CvSize ssz;
-//                int x, y;
-//                if( i == strip_count - 1 || y2 > sz1.height )
-//                    y2 = sz1.height;
-//                ssz = cvSize(sz1.width, y2 - y1);
-//				
-//                /*if( use_ipp )
-//				 {
-//				 icvRectStdDev_32f_C1R_p(
-//				 (float*)(sum1.data.ptr + y1*sum1.step), sum1.step,
-//				 (double*)(sqsum1.data.ptr + y1*sqsum1.step), sqsum1.step,
-//				 (float*)(norm1.data.ptr + y1*norm1.step), norm1.step, ssz, equ_rect );
-//				 
-//				 positive = (ssz.width/ystep)*((ssz.height + ystep-1)/ystep);
-//				 memset( mask1.data.ptr + y1*mask1.step, ystep == 1, mask1.height*mask1.step);
-//				 
-//				 if( ystep > 1 )
-//				 {
-//				 for( y = y1, positive = 0; y < y2; y += ystep )
-//				 for( x = 0; x < ssz.width; x += ystep )
-//				 mask1.data.ptr[mask1.step*y + x] = (uchar)1;
-//				 }
-//				 
-//				 for( int j = 0; j < cascade->count; j++ )
-//				 {
-//				 if( icvApplyHaarClassifier_32f_C1R_p(
-//				 (float*)(sum1.data.ptr + y1*sum1.step), sum1.step,
-//				 (float*)(norm1.data.ptr + y1*norm1.step), norm1.step,
-//				 mask1.data.ptr + y1*mask1.step, mask1.step, ssz, &positive,
-//				 cascade->hid_cascade->stage_classifier[j].threshold,
-//				 cascade->hid_cascade->ipp_stages[j]) < 0 )
-//				 {
-//				 positive = 0;
-//				 break;
-//				 }
-//				 if( positive <= 0 )
-//				 break;
-//				 }
-//				 }
-//				 else*/
-//                {
-//                    for( y = y1, positive = 0; y < y2; y += ystep )
-//                        for( x = 0; x < ssz.width; x += ystep )
-//                        {
-//                            mask1.data.ptr[mask1.step*y + x] =
-//							mycvRunHaarClassifierCascade( cascade, cvPoint(x,y), 0 ) > 0;
-//                            positive += mask1.data.ptr[mask1.step*y + x];
-//                        }
-//                }
-//				
-//                if( positive > 0 )
-//                {
-//                    for( y = y1; y < y2; y += ystep )
-//                        for( x = 0; x < ssz.width; x += ystep )
-//                            if( mask1.data.ptr[mask1.step*y + x] != 0 )
-//                            {
-//                                CvRect obj_rect = { cvRound(x*factor), cvRound(y*factor),
-//								win_size.width, win_size.height };
-//                                cvSeqPush( seq_thread[thread_id], &obj_rect );
-//                            }
-//                }
-//            }
-//			
-//            // gather the results
-//            if( max_threads > 1 )
-//                for( i = 0; i < max_threads; i++ )
-//                {
-//                    CvSeq* s = seq_thread[i];
-//                    int j, total = s->total;
-//                    CvSeqBlock* b = s->first;
-//                    for( j = 0; j < total; j += b->count, b = b->next )
-//                        cvSeqPushMulti( seq, b->data, b->count );
-//                }
-//        }
-//    }
-//    else
 	t1 = (double)cvGetTickCount();
 //	printf( "init time = %gms\n", (t1 - t)/tickFreqTimes1000);
 	t = t1;
 	
+    if( (unsigned)split_stage >= (unsigned)cascade->count ||
+	   ((MyCvHidHaarClassifierCascade*)cascade->hid_cascade)->is_tree )
+    {
+        split_stage = cascade->count;
+        npass = 1;
+    }
+	
+    if( flags & CV_HAAR_SCALE_IMAGE )
+    {
+        /* the frame shrinks instead of the cascade growing: each level is an
+           area resample of the frame, with its integrals packed at the front
+           of the full size ones, and the cascade is run on it at scale 1 */
+        CvSize win_size0 = cascade->orig_window_size;
+		
+        CV_CALL( img_small = cvCreateMat( img->rows, img->cols, CV_8UC1 ));
+        CV_CALL( mask_small = cvCreateMat( img->rows, img->cols, CV_8UC1 ));
+		
+        for( factor = 1; ; factor *= scale_factor )
+        {
+            int ystep = factor > 2. ? 1 : 2;
+            CvSize win_size = { cvRound( win_size0.width*factor ),
+			cvRound( win_size0.height*factor ) };
+            CvSize sz = { cvRound( img->cols/factor ), cvRound( img->rows/factor ) };
+            CvSize sz1 = { sz.width - win_size0.width, sz.height - win_size0.height };
+            CvMat img1, sum1, sqsum1, tilted1, mask1;
+            CvMat* _tilted = 0;
+			
+            if( sz1.width <= 0 || sz1.height <= 0 )
+                break;
+            if( win_size.width < min_size.width || win_size.height < min_size.height )
+                continue;
+			
+            img1 = cvMat( sz.height, sz.width, CV_8UC1, img_small->data.ptr );
+            sum1 = cvMat( sz.height+1, sz.width+1, CV_32SC1, sum->data.ptr );
+            sqsum1 = cvMat( sz.height+1, sz.width+1, CV_64FC1, sqsum->data.ptr );
+            if( tilted )
+            {
+                tilted1 = cvMat( sz.height+1, sz.width+1, CV_32SC1, tilted->data.ptr );
+                _tilted = &tilted1;
+            }
+            mask1 = cvMat( sz.height, sz.width, CV_8UC1, mask_small->data.ptr );
+			
+            if( sz.width == img->cols && sz.height == img->rows )
+                cvIntegral( img, &sum1, &sqsum1, _tilted );
+            else
+            {
+                cvResize( img, &img1, CV_INTER_AREA );
+                cvIntegral( &img1, &sum1, &sqsum1, _tilted );
+            }
+			
+            mycvSetImagesForHaarClassifierCascade( cascade, &sum1, &sqsum1, _tilted, 1. );
+            if( npass > 1 )
+                cvZero( &mask1 );
+			
+            {
+                /* the step stays an int here so the end counts round up as before */
+                MyCvHaarScanJob job = { cascade, &mask1, seq_thread, (double)ystep, factor, win_size,
+                                        0, (sz1.width + ystep - 1)/ystep, 0, 0, npass, 0 };
+                myicvScanHaarScale( &job, (sz1.height + ystep - 1)/ystep, split_stage, max_threads );
+            }
+			
+            if( max_threads > 1 )
+                CV_CALL( myicvGatherHaarRects( seq, seq_thread, max_threads ));
+        }
+    }
+    else
     {
         int n_factors = 0;
         CvRect scan_roi_rect = {0,0,0,0};
@@ -1132,13 +1568,6 @@ mycvHaarDetectObjects( const CvArr* _img,
 //            cvIntegral( temp, sumcanny );
 //        }
 		
-        if( (unsigned)split_stage >= (unsigned)cascade->count ||
-		   ((MyCvHidHaarClassifierCascade*)cascade->hid_cascade)->is_tree )
-        {
-            split_stage = cascade->count;
-            npass = 1;
-        }
-		
         for( n_factors = 0, factor = 1;
 			factor*cascade->orig_window_size.width < img->cols - 10 &&
 			factor*cascade->orig_window_size.height < img->rows - 10;
@@ -1162,10 +1591,10 @@ mycvHaarDetectObjects( const CvArr* _img,
             CvRect equ_rect = { 0, 0, 0, 0 };
             int *p0 = 0, *p1 = 0, *p2 = 0, *p3 = 0;
             int *pq0 = 0, *pq1 = 0, *pq2 = 0, *pq3 = 0;
-            int pass, stage_offset = 0;
             int start_x = 0, start_y = 0;
             int end_x = cvRound((img->cols - win_size.width) / ystep);
             int end_y = cvRound((img->rows - win_size.height) / ystep);
+            int box, nboxes = 0;
 			
             if( win_size.width < min_size.width || win_size.height < min_size.height )
             {
@@ -1174,6 +1603,16 @@ mycvHaarDetectObjects( const CvArr* _img,
                 continue;
             }
 			
+            if( track_count > 0 && !scan_roi )
+            {
+                /* scale_factor has been turned round if the scan goes biggest first */
+                nboxes = myicvHaarTrackBoxes( tracks, track_count, win_size,
+                                              MAX( scale_factor, 1./scale_factor ),
+                                              cvGetSize( img ), boxes );
+                if( nboxes == 0 )
+                    continue;
+            }
+			
             mycvSetImagesForHaarClassifierCascade( cascade, sum, sqsum, tilted, factor );
             cvZero( temp );
 			
@@ -1209,86 +1648,27 @@ mycvHaarDetectObjects( const CvArr* _img,
                 end_x = cvRound((scan_roi_rect.x + scan_roi_rect.width - win_size.width) / ystep);
             }
 			
-            ((MyCvHidHaarClassifierCascade*)cascade->hid_cascade)->count = split_stage;
-			
-            for( pass = 0; pass < npass; pass++ )
+            for( box = 0; box < MAX( nboxes, 1 ); box++ )
             {
-#ifdef _OPENMP
-#pragma omp parallel for num_threads(max_threads) schedule(dynamic)
-#endif
-                for( int _iy = start_y; _iy < end_y; _iy++ )
+                if( nboxes > 0 )
                 {
-                    int thread_id = cvGetThreadNum();
-                    int iy = cvRound(_iy*ystep);
-                    int _ix, _xstep = 1;
-                    uchar* mask_row = temp->data.ptr + temp->step * iy;
-					
-                    for( _ix = start_x; _ix < end_x; _ix += _xstep )
-                    {
-                        int ix = cvRound(_ix*ystep); // it really should be ystep
-						
-                        if( pass == 0 )
-                        {
-                            int result;
-                            _xstep = 2;
-							
-//                            if( do_canny_pruning )
-//                            {
-//                                int offset;
-//                                int s, sq;
-//								
-//                                offset = iy*(sum->step/sizeof(p0[0])) + ix;
-//                                s = p0[offset] - p1[offset] - p2[offset] + p3[offset];
-//                                sq = pq0[offset] - pq1[offset] - pq2[offset] + pq3[offset];
-//                                if( s < 100 || sq < 20 )
-//                                    continue;
-//                            }
-							
-                            result = mycvRunHaarClassifierCascade( cascade, cvPoint(ix,iy), 0 );
-                            if( result > 0 )
-                            {
-                                if( pass < npass - 1 )
-                                    mask_row[ix] = 1;
-                                else
-                                {
-                                    CvRect rect = cvRect(ix,iy,win_size.width,win_size.height);
-                                    cvSeqPush( seq_thread[thread_id], &rect );
-                                }
-                            }
-                            if( result < 0 )
-                                _xstep = 1;
-                        }
-                        else if( mask_row[ix] )
-                        {
-                            int result = mycvRunHaarClassifierCascade( cascade, cvPoint(ix,iy),
-																	stage_offset );
-                            if( result > 0 )
-                            {
-                                if( pass == npass - 1 )
-                                {
-                                    CvRect rect = cvRect(ix,iy,win_size.width,win_size.height);
-                                    cvSeqPush( seq_thread[thread_id], &rect );
-                                }
-                            }
-                            else
-                                mask_row[ix] = 0;
-                        }
-                    }
+                    CvRect b = boxes[box];
+                    start_y = cvRound(b.y / ystep);
+                    end_y = cvRound((b.y + b.height - win_size.height) / ystep);
+                    start_x = cvRound(b.x / ystep);
+                    end_x = cvRound((b.x + b.width - win_size.width) / ystep);
+                    if( start_x >= end_x || start_y >= end_y )
+                        continue;
                 }
-                stage_offset = ((MyCvHidHaarClassifierCascade*)cascade->hid_cascade)->count;
-                ((MyCvHidHaarClassifierCascade*)cascade->hid_cascade)->count = cascade->count;
+				
+                MyCvHaarScanJob job = { cascade, temp, seq_thread, ystep, 1., win_size,
+                                        start_x, end_x, start_y, 0, npass, 0 };
+                myicvScanHaarScale( &job, end_y - start_y, split_stage, max_threads );
             }
 			
             // gather the results
             if( max_threads > 1 )
-	            for( i = 0; i < max_threads; i++ )
-	            {
-		            CvSeq* s = seq_thread[i];
-                    int j, total = s->total;
-                    CvSeqBlock* b = s->first;
-                    for( j = 0; j < total; j += b->count, b = b->next )
-                        cvSeqPushMulti( seq, b->data, b->count );
-	            }
+                CV_CALL( myicvGatherHaarRects( seq, seq_thread, max_threads ));
 			
             if( find_biggest_object )
             {
@@ -1566,7 +1946,167 @@ mycvHaarDetectObjects( const CvArr* _img,
     cvReleaseMat( &sumcanny );
     cvReleaseMat( &norm_img );
     cvReleaseMat( &img_small );
+    cvReleaseMat( &mask_small );
     cvFree( &comps );
+    cvFree( &boxes );
 	
     return result_seq;
 }
+
+
+CV_IMPL CvSeq*
+mycvHaarDetectObjects( const CvArr* _img,
+					CvHaarClassifierCascade* cascade,
+					CvMemStorage* storage, double scale_factor,
+					int min_neighbors, int flags, CvSize min_size )
+{
+    return myicvHaarDetectObjects( _img, cascade, storage, scale_factor,
+                                   min_neighbors, flags, min_size, 0, 0 );
+}
+
+
+struct MyCvHaarTracker
+{
+    int full_scan_interval;
+    int frames_since_scan;
+    CvSize frame_size;
+    int count, capacity;
+    CvAvgComp* tracks;
+};
+
+
+CV_IMPL MyCvHaarTracker*
+mycvCreateHaarTracker( int full_scan_interval )
+{
+    MyCvHaarTracker* tracker = 0;
+
+    CV_FUNCNAME( "mycvCreateHaarTracker" );
+
+    __BEGIN__;
+
+    if( full_scan_interval < 1 )
+        CV_ERROR( CV_StsOutOfRange, "full scan interval must be >= 1" );
+
+    CV_CALL( tracker = (MyCvHaarTracker*)cvAlloc( sizeof(*tracker) ));
+    memset( tracker, 0, sizeof(*tracker) );
+    tracker->full_scan_interval = full_scan_interval;
+
+    __END__;
+
+    return tracker;
+}
+
+
+CV_IMPL void
+mycvReleaseHaarTracker( MyCvHaarTracker** _tracker )
+{
+    CV_FUNCNAME( "mycvReleaseHaarTracker" );
+
+    __BEGIN__;
+
+    MyCvHaarTracker* tracker;
+
+    if( !_tracker )
+        CV_ERROR( CV_StsNullPtr, "" );
+
+    tracker = *_tracker;
+    if( !tracker )
+        EXIT;
+
+    cvFree( &tracker->tracks );
+    cvFree( _tracker );
+
+    __END__;
+}
+
+
+/* whether some object in seq has its centre in the area r was searched over */
+static bool
+myicvHaarTrackFound( CvRect r, CvSeq* seq )
+{
+    int dx = cvRound( r.width*MYCV_HAAR_TRACK_MARGIN );
+    int dy = cvRound( r.height*MYCV_HAAR_TRACK_MARGIN );
+    int i;
+
+    for( i = 0; i < seq->total; i++ )
+    {
+        CvRect q = ((CvAvgComp*)cvGetSeqElem( seq, i ))->rect;
+        int cx = q.x + q.width/2, cy = q.y + q.height/2;
+
+        if( r.x - dx <= cx && cx < r.x + r.width + dx &&
+            r.y - dy <= cy && cy < r.y + r.height + dy )
+            return true;
+    }
+
+    return false;
+}
+
+
+/* mycvHaarDetectObjects for consecutive frames of one video. The whole frame
+   is only searched every full_scan_interval frames, when its size changes or
+   as soon as a track is lost; in between only the neighbourhood of what was
+   found last frame is (see myicvHaarTrackBoxes), so new objects show up at the
+   next full search */
+CV_IMPL CvSeq*
+mycvHaarTrackObjects( const CvArr* _img, CvHaarClassifierCascade* cascade,
+                      MyCvHaarTracker* tracker, CvMemStorage* storage,
+                      double scale_factor, int min_neighbors, int flags,
+                      CvSize min_size )
+{
+    CvSeq* result_seq = 0;
+
+    CV_FUNCNAME( "mycvHaarTrackObjects" );
+
+    __BEGIN__;
+
+    CvMat stub, *img = (CvMat*)_img;
+    int i, coi;
+
+    if( !tracker )
+        CV_ERROR( CV_StsNullPtr, "Null tracker pointer" );
+
+    CV_CALL( img = cvGetMat( img, &stub, &coi ));
+
+    if( tracker->count > 0 && tracker->frames_since_scan < tracker->full_scan_interval &&
+        img->cols == tracker->frame_size.width && img->rows == tracker->frame_size.height )
+    {
+        CV_CALL( result_seq = myicvHaarDetectObjects( img, cascade, storage, scale_factor,
+                                                      min_neighbors, flags, min_size,
+                                                      tracker->tracks, tracker->count ));
+
+        for( i = 0; i < tracker->count; i++ )
+            if( !myicvHaarTrackFound( tracker->tracks[i].rect, result_seq ))
+            {
+                result_seq = 0;
+                break;
+            }
+
+        tracker->frames_since_scan++;
+    }
+
+    if( !result_seq )
+    {
+        CV_CALL( result_seq = mycvHaarDetectObjects( img, cascade, storage, scale_factor,
+                                                     min_neighbors, flags, min_size ));
+        tracker->frames_since_scan = 1;
+        tracker->frame_size = cvGetSize( img );
+    }
+
+    /* the tracks for the next frame */
+    if( result_seq->total > tracker->capacity )
+    {
+        cvFree( &tracker->tracks );
+        tracker->count = tracker->capacity = 0;
+        CV_CALL( tracker->tracks = (CvAvgComp*)cvAlloc(
+                                   result_seq->total*sizeof(tracker->tracks[0]) ));
+        tracker->capacity = result_seq->total;
+    }
+
+    if( result_seq->total > 0 )
+        cvCvtSeqToArray( result_seq, tracker->tracks );
+    tracker->count = result_seq->total;
+
+    __END__;
+
+    return result_seq;
+}
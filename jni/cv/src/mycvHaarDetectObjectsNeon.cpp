@@ -0,0 +1,107 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                        Intel License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000, Intel Corporation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of Intel Corporation may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+/* Stage 0 of four Haar windows at once with neon, for the first pass of
+   myicvScanHaarRowsBatched. Built with -mfpu=neon on armeabi-v7a only (see
+   Android.mk) and only ever reached through myicvGetPassHaarStage4 once
+   cpufeatures has seen neon on the device. The answer is the same bit for
+   bit as the scalar myicvPassHaarStage4 */
+
+#include "_mycvhaar.h"
+
+#if defined HAVE_NEON && defined __ARM_NEON__
+
+#include <arm_neon.h>
+
+/* armv7 has no double lanes, so the stage sums are added up per window from
+   the test mask */
+#define MY_HAAR_RECT_SUM4(r,s,o) \
+(r)[0] = (s)[0][(o)[0]] - (s)[0][(o)[1]] - (s)[0][(o)[2]] + (s)[0][(o)[3]]; \
+(r)[1] = (s)[1][(o)[0]] - (s)[1][(o)[1]] - (s)[1][(o)[2]] + (s)[1][(o)[3]]; \
+(r)[2] = (s)[2][(o)[0]] - (s)[2][(o)[1]] - (s)[2][(o)[2]] + (s)[2][(o)[3]]; \
+(r)[3] = (s)[3][(o)[0]] - (s)[3][(o)[1]] - (s)[3][(o)[2]] + (s)[3][(o)[3]]
+
+int
+myicvPassHaarStage4Neon( const MyCvHidHaarClassifierCascade* cascade,
+                         const int* p_offset, const int* norm )
+{
+    const MyCvHaarFlatStage* stage = cascade->flat_stage;
+    const MyCvHaarFlatStump* stump = stage->stump;
+    const sumtype* s[4];
+    int32x4_t vnorm = vld1q_s32( norm );
+    double stage_sum[4] = { 0, 0, 0, 0 };
+    int j, k, passed = 0;
+	
+    for( k = 0; k < 4; k++ )
+        s[k] = cascade->sum.data.i + p_offset[k];
+	
+    for( j = 0; j < stage->count; j++, stump++ )
+    {
+        int rect[4];
+        uint32_t right[4];
+        int32x4_t t = vmulq_s32( vdupq_n_s32( stump->threshold ), vnorm );
+        int32x4_t sum;
+		
+        MY_HAAR_RECT_SUM4( rect, s, stump->ofs[0] );
+        sum = vmulq_s32( vld1q_s32( rect ), vdupq_n_s32( stump->weight[0] ));
+        MY_HAAR_RECT_SUM4( rect, s, stump->ofs[1] );
+        sum = vmlaq_s32( sum, vld1q_s32( rect ), vdupq_n_s32( stump->weight[1] ));
+        if( !stage->two_rects )
+        {
+            MY_HAAR_RECT_SUM4( rect, s, stump->ofs[2] );
+            sum = vmlaq_s32( sum, vld1q_s32( rect ), vdupq_n_s32( stump->weight[2] ));
+        }
+		
+        vst1q_u32( right, vcgeq_s32( sum, t ));
+        for( k = 0; k < 4; k++ )
+            stage_sum[k] += stump->alpha[right[k] & 1];
+    }
+	
+    for( k = 0; k < 4; k++ )
+        if( !(stage_sum[k] < stage->threshold) )
+            passed |= 1 << k;
+	
+    return passed;
+}
+
+#undef MY_HAAR_RECT_SUM4
+
+#endif
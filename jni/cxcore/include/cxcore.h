@@ -1752,12 +1752,20 @@ CVAPI(double) cvGetTickFrequency( void );
 
 /*********************************** Multi-Threading ************************************/
 
-/* retrieve/set the number of threads used in OpenMP implementations */
+/* retrieve/set the number of threads used in parallel implementations */
 CVAPI(int)  cvGetNumThreads( void );
 CVAPI(void) cvSetNumThreads( int threads CV_DEFAULT(0) );
 /* get index of the thread being executed */
 CVAPI(int)  cvGetThreadNum( void );
 
+/* runs body over [start,end) pieces of [0,count) on up to num_threads threads
+   (cvGetNumThreads() if <= 0), returning once the whole range is done. Inside
+   body cvGetThreadNum() is below num_threads. Uses OpenMP when built with it,
+   otherwise a pool of pthreads that steal work from each other */
+typedef void (CV_CDECL *CvParallelLoopBody)( int start, int end, void* userdata );
+CVAPI(void) cvParallelFor( int count, CvParallelLoopBody body, void* userdata,
+                           int num_threads CV_DEFAULT(0) );
+
 /*************** Convenience functions for better interaction with HighGUI **************/
 
 typedef IplImage* (CV_CDECL * CvLoadImageFunc)( const char* filename, int colorness );
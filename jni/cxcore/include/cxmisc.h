@@ -104,6 +104,10 @@
 /* maximum possible number of threads in parallel implementations */
 #ifdef _OPENMP
 #define CV_MAX_THREADS 128
+#elif !defined WIN32 && !defined WIN64
+/* no OpenMP, cvParallelFor runs on a pool of pthreads (see cxparallel.cpp) */
+#define CV_PTHREADS_PARALLEL 1
+#define CV_MAX_THREADS 16
 #else
 #define CV_MAX_THREADS 1
 #endif
@@ -0,0 +1,401 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                        Intel License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000, Intel Corporation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of Intel Corporation may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+
+
+/****************************************************************************************/
+/*                  Parallel loops on a pthread pool, for builds without OpenMP         */
+/****************************************************************************************/
+
+#include "_cxcore.h"
+
+#if CV_PTHREADS_PARALLEL
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+static int icvNumThreads = 0;
+static int icvNumProcs = 0;
+
+#if CV_PTHREADS_PARALLEL
+
+/* how many pieces per thread the range is cut into: the smaller they are, the
+   better the load balances, but every piece costs a lock */
+#define ICV_PARALLEL_CHUNKS_PER_THREAD  4
+
+/* the part of the range a thread still has to do. Its owner takes pieces off
+   the front, threads that have run out steal the back half */
+typedef struct CvParallelSlot
+{
+    pthread_mutex_t lock;
+    int start;
+    int end;
+    /* keep each slot on its own cache line */
+    char pad[64];
+}
+CvParallelSlot;
+
+typedef struct CvParallelJob
+{
+    CvParallelLoopBody body;
+    void* userdata;
+    int thread_count;
+    int grain;
+}
+CvParallelJob;
+
+typedef struct CvParallelPool
+{
+    /* held by whoever's job is running, anyone else runs theirs inline */
+    pthread_mutex_t dispatch;
+
+    /* guards the rest */
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    int generation;
+    int pending;
+    CvParallelJob* job;
+
+    /* threads started, counting the caller as thread 0 */
+    int thread_count;
+    pthread_t threads[CV_MAX_THREADS];
+    CvParallelSlot slots[CV_MAX_THREADS];
+}
+CvParallelPool;
+
+static CvParallelPool icvPool;
+static pthread_once_t icvPoolOnce = PTHREAD_ONCE_INIT;
+
+/* thread number + 1 inside a parallel loop, 0 (unset) outside */
+static pthread_key_t icvThreadKey;
+
+
+static int icvGetNumberOfCPUs( void )
+{
+    /* android hotplugs cores under load, so count the configured ones
+       rather than only those that happen to be awake right now */
+    long cpus = sysconf( _SC_NPROCESSORS_CONF );
+    long online = sysconf( _SC_NPROCESSORS_ONLN );
+
+    if( online > cpus )
+        cpus = online;
+
+    return (int)MAX( cpus, 1 );
+}
+
+
+static void icvInitParallelPool( void )
+{
+    int i;
+
+    pthread_key_create( &icvThreadKey, 0 );
+    pthread_mutex_init( &icvPool.dispatch, 0 );
+    pthread_mutex_init( &icvPool.lock, 0 );
+    pthread_cond_init( &icvPool.work_ready, 0 );
+    pthread_cond_init( &icvPool.work_done, 0 );
+
+    for( i = 0; i < CV_MAX_THREADS; i++ )
+        pthread_mutex_init( &icvPool.slots[i].lock, 0 );
+
+    icvPool.generation = 0;
+    icvPool.pending = 0;
+    icvPool.job = 0;
+    icvPool.thread_count = 1;
+}
+
+
+/* the next piece of a thread's own slot */
+static int icvTakeChunk( CvParallelSlot* slot, int grain, int* start, int* end )
+{
+    int found = 0;
+
+    pthread_mutex_lock( &slot->lock );
+    if( slot->start < slot->end )
+    {
+        *start = slot->start;
+        *end = MIN( slot->start + grain, slot->end );
+        slot->start = *end;
+        found = 1;
+    }
+    pthread_mutex_unlock( &slot->lock );
+
+    return found;
+}
+
+
+/* move the back half of whichever slot still has work into thread's own */
+static int icvStealWork( CvParallelJob* job, int thread )
+{
+    int i;
+
+    for( i = 1; i < job->thread_count; i++ )
+    {
+        CvParallelSlot* victim = &icvPool.slots[(thread + i) % job->thread_count];
+        int start = 0, end = 0;
+
+        pthread_mutex_lock( &victim->lock );
+        if( victim->start < victim->end )
+        {
+            start = victim->start + (victim->end - victim->start)/2;
+            end = victim->end;
+            victim->end = start;
+        }
+        pthread_mutex_unlock( &victim->lock );
+
+        if( start < end )
+        {
+            CvParallelSlot* own = &icvPool.slots[thread];
+
+            pthread_mutex_lock( &own->lock );
+            own->start = start;
+            own->end = end;
+            pthread_mutex_unlock( &own->lock );
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+static void icvRunParallelJob( CvParallelJob* job, int thread )
+{
+    CvParallelSlot* own = &icvPool.slots[thread];
+    int start, end;
+
+    for(;;)
+    {
+        if( !icvTakeChunk( own, job->grain, &start, &end ))
+        {
+            if( !icvStealWork( job, thread ))
+                break;
+            continue;
+        }
+
+        job->body( start, end, job->userdata );
+    }
+}
+
+
+static void* icvParallelWorker( void* arg )
+{
+    int thread = (int)(size_t)arg;
+    /* started for a job that may already have been posted by the time this
+       thread runs, so it must not take the current generation as seen */
+    int seen = -1;
+
+    pthread_setspecific( icvThreadKey, (void*)(size_t)(thread + 1) );
+
+    pthread_mutex_lock( &icvPool.lock );
+
+    for(;;)
+    {
+        CvParallelJob* job;
+
+        while( icvPool.generation == seen )
+            pthread_cond_wait( &icvPool.work_ready, &icvPool.lock );
+
+        seen = icvPool.generation;
+        job = icvPool.job;
+
+        if( job && thread < job->thread_count )
+        {
+            pthread_mutex_unlock( &icvPool.lock );
+            icvRunParallelJob( job, thread );
+            pthread_mutex_lock( &icvPool.lock );
+
+            if( --icvPool.pending == 0 )
+                pthread_cond_signal( &icvPool.work_done );
+        }
+    }
+
+    return 0;
+}
+
+
+/* start workers until there are thread_count threads, returns how many there are */
+static int icvStartParallelWorkers( int thread_count )
+{
+    pthread_mutex_lock( &icvPool.lock );
+    while( icvPool.thread_count < thread_count )
+    {
+        int thread = icvPool.thread_count;
+
+        if( pthread_create( &icvPool.threads[thread], 0, icvParallelWorker, (void*)(size_t)thread ))
+            break;
+        icvPool.thread_count++;
+    }
+    thread_count = MIN( thread_count, icvPool.thread_count );
+    pthread_mutex_unlock( &icvPool.lock );
+
+    return thread_count;
+}
+
+#endif /* CV_PTHREADS_PARALLEL */
+
+
+CV_IMPL int cvGetNumThreads(void)
+{
+    if( !icvNumProcs )
+        cvSetNumThreads(0);
+    return icvNumThreads;
+}
+
+CV_IMPL void cvSetNumThreads( int threads )
+{
+    if( !icvNumProcs )
+    {
+#ifdef _OPENMP
+        icvNumProcs = omp_get_num_procs();
+        icvNumProcs = MIN( icvNumProcs, CV_MAX_THREADS );
+#elif CV_PTHREADS_PARALLEL
+        icvNumProcs = MIN( icvGetNumberOfCPUs(), CV_MAX_THREADS );
+#else
+        icvNumProcs = 1;
+#endif
+    }
+
+#if defined _OPENMP || CV_PTHREADS_PARALLEL
+    if( threads <= 0 )
+        threads = icvNumProcs;
+
+    /* the per thread buffers are sized by CV_MAX_THREADS */
+    icvNumThreads = MIN( threads, CV_MAX_THREADS );
+#else
+    icvNumThreads = 1;
+#endif
+}
+
+
+CV_IMPL int cvGetThreadNum(void)
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#elif CV_PTHREADS_PARALLEL
+    size_t thread;
+
+    pthread_once( &icvPoolOnce, icvInitParallelPool );
+    thread = (size_t)pthread_getspecific( icvThreadKey );
+    return thread > 0 ? (int)thread - 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+
+CV_IMPL void cvParallelFor( int count, CvParallelLoopBody body, void* userdata, int num_threads )
+{
+    if( count <= 0 )
+        return;
+
+    if( num_threads <= 0 )
+        num_threads = cvGetNumThreads();
+    num_threads = MIN( num_threads, count );
+
+#ifdef _OPENMP
+    {
+    int i;
+    #pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+    for( i = 0; i < count; i++ )
+        body( i, i + 1, userdata );
+    }
+#elif CV_PTHREADS_PARALLEL
+    pthread_once( &icvPoolOnce, icvInitParallelPool );
+
+    /* loops inside loops, and loops from a second caller while the pool is
+       busy, run on the thread that asked. Inside a loop that is as thread 0
+       of this one, the way OpenMP numbers a nested region it serializes */
+    if( num_threads <= 1 || pthread_getspecific( icvThreadKey ) != 0 ||
+        pthread_mutex_trylock( &icvPool.dispatch ) != 0 )
+    {
+        void* outer = pthread_getspecific( icvThreadKey );
+
+        if( outer )
+            pthread_setspecific( icvThreadKey, (void*)(size_t)1 );
+        body( 0, count, userdata );
+        if( outer )
+            pthread_setspecific( icvThreadKey, outer );
+        return;
+    }
+
+    {
+    CvParallelJob job;
+    int i;
+
+    job.body = body;
+    job.userdata = userdata;
+    job.thread_count = icvStartParallelWorkers( MIN( num_threads, CV_MAX_THREADS ));
+    job.grain = MAX( count/(job.thread_count*ICV_PARALLEL_CHUNKS_PER_THREAD), 1 );
+
+    /* an even share each to start with */
+    for( i = 0; i < job.thread_count; i++ )
+    {
+        icvPool.slots[i].start = (int)((int64)count*i/job.thread_count);
+        icvPool.slots[i].end = (int)((int64)count*(i + 1)/job.thread_count);
+    }
+
+    pthread_mutex_lock( &icvPool.lock );
+    icvPool.job = &job;
+    icvPool.pending = job.thread_count - 1;
+    icvPool.generation++;
+    pthread_cond_broadcast( &icvPool.work_ready );
+    pthread_mutex_unlock( &icvPool.lock );
+
+    pthread_setspecific( icvThreadKey, (void*)(size_t)1 );
+    icvRunParallelJob( &job, 0 );
+    pthread_setspecific( icvThreadKey, 0 );
+
+    pthread_mutex_lock( &icvPool.lock );
+    while( icvPool.pending > 0 )
+        pthread_cond_wait( &icvPool.work_done, &icvPool.lock );
+    icvPool.job = 0;
+    pthread_mutex_unlock( &icvPool.lock );
+
+    pthread_mutex_unlock( &icvPool.dispatch );
+    }
+#else
+    body( 0, count, userdata );
+#endif
+}
+
+
+/* End of file. */
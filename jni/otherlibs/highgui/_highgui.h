@@ -76,7 +76,7 @@ struct CvCapture
     virtual IplImage* queryFrame() { return grabFrame() ? retrieveFrame() : 0; }
 };
 
-CvCapture* cvCreateCameraCapture_Socket( const char *address, const char* port, int width, int height );
+CvCapture* cvCreateCameraCapture_Socket( const char *address, const char* port, int width, int height, bool streaming );
 
 CVAPI(int) cvHaveImageReader(const char* filename);
 CVAPI(int) cvHaveImageWriter(const char* filename);
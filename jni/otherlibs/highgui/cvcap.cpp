@@ -89,5 +89,10 @@ CV_IMPL int cvSetCaptureProperty( CvCapture* capture, int id, double value )
 
 CV_IMPL CvCapture* cvCreateSocketCapture( const char *address, const char* port, int width, int height )
 {
-	return cvCreateCameraCapture_Socket(address, port, width, height);
+	return cvCreateCameraCapture_Socket(address, port, width, height, false);
+}
+
+CV_IMPL CvCapture* cvCreateSocketStreamCapture( const char *address, const char* port, int width, int height )
+{
+	return cvCreateCameraCapture_Socket(address, port, width, height, true);
 }
@@ -51,6 +51,8 @@
 #include <android/log.h>
 #include <errno.h>
 #include <netdb.h>
+#include <pthread.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 #define LOGV(...) __android_log_print(ANDROID_LOG_SILENT, LOG_TAG, __VA_ARGS__)
@@ -62,10 +64,18 @@
 #define CV_WARN(message) fprintf(stderr, "warning: %s (%s:%d)\n", message, __FILE__, __LINE__)
 #endif
 
-#define IMAGE( i, x, y, n )   *(( unsigned char * )(( i )->imageData      \
-                                    + ( x ) * sizeof( unsigned char ) * 3 \
-                                    + ( y ) * ( i )->widthStep ) + ( n ))
+// The number of frames the capture keeps preallocated and hands out in turn.
+#define SOCKET_CAPTURE_RING_SIZE 3
 
+// Frames are unpacked into a fixed ring of images made when the capture is
+// opened, so grabbing never allocates. A retrieved frame stays valid until
+// SOCKET_CAPTURE_RING_SIZE-1 more frames have been grabbed.
+//
+// In streaming mode one connection stays open and the server sends frame after
+// frame down it, each one prefixed with its length in bytes as a big endian
+// 32 bit int (what java's DataOutputStream.writeInt gives you). A background
+// thread reads and unpacks the next frame while the current one is being
+// processed.
 class CVCapture_Socket : public CvCapture
 {
 public:
@@ -77,14 +87,26 @@ public:
 		readBufSize = 0;
 		readBuf = 0;
         frame = 0;
+		memset(ring, 0, sizeof(ring));
+		ringPos = SOCKET_CAPTURE_RING_SIZE-1;
+		streaming = false;
+		streamSocket = -1;
+		prefetchRunning = false;
+		prefetchReady = false;
+		prefetchFailed = false;
+		stopPrefetch = false;
+		pthread_mutex_init(&prefetchLock, NULL);
+		pthread_cond_init(&prefetchCond, NULL);
     }
 
     virtual ~CVCapture_Socket()
     {
         close();
+		pthread_cond_destroy(&prefetchCond);
+		pthread_mutex_destroy(&prefetchLock);
     }
 
-    virtual bool open(const char* _address, const char* _port, int _width, int _height);
+    virtual bool open(const char* _address, const char* _port, int _width, int _height, bool _streaming);
     virtual void close();
     virtual double getProperty(int);
     virtual bool setProperty(int, double);
@@ -92,17 +114,58 @@ public:
     virtual IplImage* retrieveFrame();
 
 protected:
+	int connectSocket();
+	bool readFrame(int sockd, char* buf);
+	bool startStream();
+	void stopStream();
+	bool grabStreamFrame();
+	static void* prefetchMain(void* arg);
+
 	struct addrinfo *pAddrInfo;
 	int width; // the width of the images received over the socket
 	int height; // the height of the images received over the socket
 	long readBufSize; // the length of the read buffer
 	char *readBuf; // the read buffer
 
-    IplImage* frame;
+	bool streaming; // keep one connection open and read length prefixed frames
+	int streamSocket; // the open connection while streaming, -1 otherwise
+	pthread_t prefetchThread;
+	bool prefetchRunning;
+	bool prefetchReady; // the slot after ringPos holds a whole frame
+	bool prefetchFailed; // the stream broke, grabFrame reconnects
+	bool stopPrefetch;
+	pthread_mutex_t prefetchLock;
+	pthread_cond_t prefetchCond;
+
+	IplImage* ring[SOCKET_CAPTURE_RING_SIZE]; // the frames, owned by the capture
+	int ringPos; // the slot last handed out
+
+    IplImage* frame; // the slot retrieveFrame returns, 0 if the last grab failed
 };
 
+// Read exactly size bytes, false if the connection closed or broke first.
+static bool readFully(int sockd, char* buf, long size)
+{
+	long total_read = 0;
+	while (total_read < size)
+	{
+		long read_count = read(sockd, &buf[total_read], size - total_read);
+		if (read_count < 0 && errno == EINTR)
+			continue;
+		if (read_count <= 0)
+		{
+			char buffer[100];
+			sprintf(buffer, "socket read errorno = %d", read_count < 0 ? errno : 0);
+			LOGV(buffer);
+			return false;
+		}
+		total_read += read_count;
+	}
+	return true;
+}
+
 // The open method simply initializes some variables we will need later.
-bool CVCapture_Socket::open(const char* _address, const char* _port, int _width, int _height)
+bool CVCapture_Socket::open(const char* _address, const char* _port, int _width, int _height, bool _streaming)
 {	
 	// Free the addrinfo if it was allocated.
 	if (pAddrInfo)
@@ -147,6 +210,13 @@ bool CVCapture_Socket::open(const char* _address, const char* _port, int _width,
 		pAddrInfo = 0;
 		return false;
 	}
+	
+	// Every frame we'll ever hand out, made up front.
+	for (int i = 0; i < SOCKET_CAPTURE_RING_SIZE; i++)
+		ring[i] = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 3);
+	ringPos = SOCKET_CAPTURE_RING_SIZE-1;
+	
+	streaming = _streaming;
 		
 	return true;
 }
@@ -154,6 +224,10 @@ bool CVCapture_Socket::open(const char* _address, const char* _port, int _width,
 // Close cleans up all of our state and cached data.
 void CVCapture_Socket::close()
 {
+	LOGV("Stopping the stream");
+	stopStream();
+	streaming = false;
+	
 	LOGV("Setting simple vars to 0");
 	width = 0;
 	height = 0;
@@ -173,95 +247,222 @@ void CVCapture_Socket::close()
 		readBuf = 0;
 	}
 	
-	LOGV("Releasing Image");
-	if (frame)
+	LOGV("Releasing Images");
+	for (int i = 0; i < SOCKET_CAPTURE_RING_SIZE; i++)
 	{
-		cvReleaseImage( &frame );
-		frame = 0;
+		if (ring[i])
+			cvReleaseImage( &ring[i] );
 	}
+	frame = 0;
 
 	LOGV("Done closing Capture Socket");
 }
 
-// Helper to load pixels from a byte stream received over a socket.
-static IplImage* loadPixels(char* pixels, int width, int height) {
-
-	int x, y, pos, int_size = sizeof(int);
-	IplImage *img = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 3);
-
-	for ( y = 0; y < height; y++ ) {
-		pos = y * width * int_size;
-        for ( x = 0; x < width; x++, pos += int_size ) {
-            // blue
-            IMAGE( img, x, y, 0 ) = pixels[pos + 3] & 0xFF;
-            // green
-            IMAGE( img, x, y, 1 ) = pixels[pos + 2] & 0xFF;
-            // red
-            IMAGE( img, x, y, 2 ) = pixels[pos + 1] & 0xFF;
-        }
-    }
+// Helper to unpack the ARGB ints received over a socket into a BGR image.
+static void unpackPixels(const char* pixels, IplImage* img) {
+
+	const unsigned char* src = (const unsigned char*)pixels;
 
-	return img;
+	for ( int y = 0; y < img->height; y++ ) {
+		unsigned char* dst = (unsigned char*)img->imageData + y * img->widthStep;
+		for ( int x = 0; x < img->width; x++, src += 4, dst += 3 ) {
+			dst[0] = src[3]; // blue
+			dst[1] = src[2]; // green
+			dst[2] = src[1]; // red
+		}
+	}
 }
 
-// Grabs a frame (image) from a socket.
-bool CVCapture_Socket::grabFrame()
+// Opens a new connection to the address we were given, -1 if it fails.
+int CVCapture_Socket::connectSocket()
 {
-	// First ensure that our addrinfo and read buffer are allocated.
-	if (pAddrInfo == 0 || readBuf == 0)
-	{
-		LOGV("You haven't opened the socket capture yet!");
-		return false;
-	}
-	
 	// Establish the socket.
 	int sockd = socket(pAddrInfo->ai_family, pAddrInfo->ai_socktype, pAddrInfo->ai_protocol);
-	if (sockd < 0 || errno != 0)
+	if (sockd < 0)
 	{
 		char buffer[100];
 		sprintf(buffer, "Failed to create socket, errno = %d", errno);
 		LOGV(buffer);
-		::close(sockd);
-		return false;
+		return -1;
 	}
 	
 	// Now connect to the socket.
-	if (connect(sockd, pAddrInfo->ai_addr, pAddrInfo->ai_addrlen) < 0 || errno != 0)
+	if (connect(sockd, pAddrInfo->ai_addr, pAddrInfo->ai_addrlen) < 0)
 	{
 		char buffer[100];
 		sprintf(buffer, "socket connection errorno = %d", errno);
 		LOGV(buffer);
 		::close(sockd);
-		return false;
+		return -1;
 	}
+	
+	return sockd;
+}
 
-	// Release the image if it hasn't been already because we are going to overwrite it.
-	if (frame)
+// Reads one length prefixed frame off the stream into buf.
+bool CVCapture_Socket::readFrame(int sockd, char* buf)
+{
+	unsigned char prefix[4];
+	if (!readFully(sockd, (char*)prefix, 4))
+		return false;
+	
+	long length = ((long)prefix[0] << 24) | (prefix[1] << 16) | (prefix[2] << 8) | prefix[3];
+	if (length != readBufSize)
 	{
-		cvReleaseImage( &frame );
-		frame = 0;
+		char buffer[100];
+		sprintf(buffer, "frame is %ld bytes, expected %ld", length, readBufSize);
+		LOGV(buffer);
+		return false;
 	}
 	
-	// Read the socket until we have filled the data with the space allocated OR run
-	// out of data which we treat as an error.
-	long read_count, total_read = 0;
-	while (total_read < readBufSize)
+	return readFully(sockd, buf, readBufSize);
+}
+
+// Reads and unpacks frames into the ring, one ahead of whatever grabFrame last
+// handed out.
+void* CVCapture_Socket::prefetchMain(void* arg)
+{
+	CVCapture_Socket* capture = (CVCapture_Socket*)arg;
+	
+	pthread_mutex_lock(&capture->prefetchLock);
+	for (;;)
 	{
-		read_count = read(sockd, &readBuf[total_read], readBufSize);
-		if (read_count <= 0 || errno != 0)
+		// Wait for grabFrame to take the last frame we read.
+		while (capture->prefetchReady && !capture->stopPrefetch)
+			pthread_cond_wait(&capture->prefetchCond, &capture->prefetchLock);
+		
+		if (capture->stopPrefetch)
+			break;
+		
+		// The read buffer and the next slot are ours until we say it's ready,
+		// so read and unpack without the lock.
+		IplImage* slot = capture->ring[(capture->ringPos + 1) % SOCKET_CAPTURE_RING_SIZE];
+		pthread_mutex_unlock(&capture->prefetchLock);
+		bool ok = capture->readFrame(capture->streamSocket, capture->readBuf);
+		if (ok)
+			unpackPixels(capture->readBuf, slot);
+		pthread_mutex_lock(&capture->prefetchLock);
+		
+		if (!ok)
 		{
-			char buffer[100];
-			sprintf(buffer, "socket read errorno = %d", errno);
-			LOGV(buffer);
+			capture->prefetchFailed = true;
+			pthread_cond_broadcast(&capture->prefetchCond);
 			break;
 		}
-		total_read += read_count;
+		
+		capture->prefetchReady = true;
+		pthread_cond_broadcast(&capture->prefetchCond);
+	}
+	pthread_mutex_unlock(&capture->prefetchLock);
+	
+	return NULL;
+}
+
+// Connects and starts prefetching frames.
+bool CVCapture_Socket::startStream()
+{
+	streamSocket = connectSocket();
+	if (streamSocket < 0)
+		return false;
+	
+	prefetchReady = false;
+	prefetchFailed = false;
+	stopPrefetch = false;
+	
+	if (pthread_create(&prefetchThread, NULL, prefetchMain, (void*)this))
+	{
+		LOGV("Failed to start the prefetch thread");
+		::close(streamSocket);
+		streamSocket = -1;
+		return false;
+	}
+	
+	prefetchRunning = true;
+	return true;
+}
+
+// Stops the prefetch thread and drops the connection.
+void CVCapture_Socket::stopStream()
+{
+	if (prefetchRunning)
+	{
+		pthread_mutex_lock(&prefetchLock);
+		stopPrefetch = true;
+		pthread_cond_broadcast(&prefetchCond);
+		pthread_mutex_unlock(&prefetchLock);
+		
+		// Wakes the thread up if it's blocked in read.
+		shutdown(streamSocket, SHUT_RDWR);
+		pthread_join(prefetchThread, NULL);
+		prefetchRunning = false;
+	}
+	
+	if (streamSocket >= 0)
+	{
+		::close(streamSocket);
+		streamSocket = -1;
+	}
+}
+
+// Takes the frame the prefetch thread has read and sets it reading the next one.
+bool CVCapture_Socket::grabStreamFrame()
+{
+	// (Re)connect the first time through or after the stream broke.
+	if (!prefetchRunning && !startStream())
+		return false;
+	
+	pthread_mutex_lock(&prefetchLock);
+	while (!prefetchReady && !prefetchFailed)
+		pthread_cond_wait(&prefetchCond, &prefetchLock);
+	
+	bool ok = prefetchReady;
+	if (ok)
+	{
+		// Hand out the slot it just filled and set it going on the one after.
+		ringPos = (ringPos + 1) % SOCKET_CAPTURE_RING_SIZE;
+		frame = ring[ringPos];
+		prefetchReady = false;
+		pthread_cond_broadcast(&prefetchCond);
+	}
+	pthread_mutex_unlock(&prefetchLock);
+	
+	if (!ok)
+	{
+		LOGV("stream read failed, reconnecting next grab");
+		stopStream();
+		return false;
 	}
 	
-	// If we read all of the data we expected, we will load the frame from the pixels.
-	if (total_read == readBufSize)
+	return true;
+}
+
+// Grabs a frame (image) from a socket.
+bool CVCapture_Socket::grabFrame()
+{
+	// First ensure that our addrinfo and read buffer are allocated.
+	if (pAddrInfo == 0 || readBuf == 0)
+	{
+		LOGV("You haven't opened the socket capture yet!");
+		return false;
+	}
+	
+	// Nothing to retrieve unless this grab works.
+	frame = 0;
+	
+	if (streaming)
+		return grabStreamFrame();
+	
+	int sockd = connectSocket();
+	if (sockd < 0)
+		return false;
+	
+	// Read the socket until we have filled the data with the space allocated OR run
+	// out of data which we treat as an error.
+	if (readFully(sockd, readBuf, readBufSize))
 	{
-		frame = loadPixels(readBuf, width, height);
+		ringPos = (ringPos + 1) % SOCKET_CAPTURE_RING_SIZE;
+		frame = ring[ringPos];
+		unpackPixels(readBuf, frame);
 	}
 	else
 	{
@@ -291,10 +492,10 @@ bool CVCapture_Socket::setProperty(int id, double value)
     return false;
 }
 
-CvCapture* cvCreateCameraCapture_Socket( const char *address, const char *port, int width, int height )
+CvCapture* cvCreateCameraCapture_Socket( const char *address, const char *port, int width, int height, bool streaming )
 {
 	CVCapture_Socket* capture = new CVCapture_Socket;
-	if ( capture-> open(address, port, width, height) )
+	if ( capture-> open(address, port, width, height, streaming) )
 		return capture;
 		
 	delete capture;
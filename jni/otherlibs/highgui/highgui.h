@@ -170,6 +170,10 @@ typedef struct CvCapture CvCapture;
 /* start capturing frames from video file */
 CVAPI(CvCapture*) cvCreateSocketCapture( const char *address, const char* port, int width, int height );
 
+/* same, but over one connection that stays open, with each frame prefixed by its
+   length (big endian int32) and the next one read ahead in the background */
+CVAPI(CvCapture*) cvCreateSocketStreamCapture( const char *address, const char* port, int width, int height );
+
 /* grab a frame, return 1 on success, 0 on fail.
   this function is thought to be fast               */
 CVAPI(int) cvGrabFrame( CvCapture* capture );
@@ -5,6 +5,7 @@ import java.io.FileOutputStream;
 import java.io.IOException;
 import java.io.InputStream;
 import java.io.OutputStream;
+import java.nio.ByteBuffer;
 
 import org.openparallel.imagethresh.R;
 import org.openparallel.imagethresh.R.id;
@@ -53,6 +54,8 @@ public class ImageThreshActivity extends Activity {
 	public native boolean setSourceImage(int[] data, int w, int h);
 	public native void doGrayscaleTransform();
 	public native boolean doChainOfImageProcessingOperations();
+	//the EFFECT_*s (in order) doChainOfImageProcessingOperations runs, sepia by default
+	public native boolean setFilterChain(int[] effects);
 	public native void setWorkingDir(String string);
 	public native boolean imageProcessingHasFinished();
 	public native String stringFromJNI();
@@ -65,6 +68,73 @@ public class ImageThreshActivity extends Activity {
 	public native float STWithNeon();
 	public native float STWithNeonAndSMP();
 	
+	//force the vector backend the filters run on (-1 = auto, 0 = scalar,
+	//1 = neon, 2 = ssse3, 3 = avx2), false if this device can't run it
+	public native boolean setFilterBackend(int backend);
+	public native String getFilterBackendName();
+	
+	//zero copy versions, the Bitmap has to be ARGB_8888
+	public native boolean setSourceBitmap(Bitmap bitmap);
+	public native boolean getSourceBitmap(Bitmap bitmap);
+	//w*h ARGB ints, for Bitmap.createBitmap(pixels, w, h, ARGB_8888)
+	public native boolean getSourcePixels(int[] pixels);
+	public native float STWithBitmap(Bitmap bitmap);
+	
+	//effects that run in place on 4 channel pixels (EFFECT_* in ImageProcessor.h)
+	public static final int EFFECT_SEPIA = 0;
+	public static final int EFFECT_GRAYSCALE = 1;
+	public static final int EFFECT_SKETCHBOOK = 2;
+	public static final int EFFECT_FUNHOUSE = 3;
+	//neonising only works in filter chains
+	public static final int EFFECT_NEONISE = 4;
+	public native boolean applyEffectToBitmap(Bitmap bitmap, int effect);
+	
+	//direct ByteBuffers of width*height RGBA/BGRA pixels, stride 0 means packed rows.
+	//allocPixelBuffer's memory is native and has to go back through freePixelBuffer
+	public native ByteBuffer allocPixelBuffer(int width, int height);
+	public native void freePixelBuffer(ByteBuffer buffer);
+	public native boolean applyEffectToBuffer(ByteBuffer buffer, int width, int height, int stride, boolean rgba, int effect);
+
+	//a context per session so several images can be processed at once, each on
+	//its own thread (the functions above all share one). Contexts are native
+	//and have to go back through destroyProcessingContext, which is safe with
+	//jobs still queued for it: it goes once the last of them is done
+	public native long createProcessingContext();
+	public native void destroyProcessingContext(long context);
+	public native boolean setContextSourceImage(long context, int[] data, int w, int h);
+	public native byte[] getContextSourceImage(long context);
+	public native boolean setContextSourceBitmap(long context, Bitmap bitmap);
+	public native boolean getContextSourceBitmap(long context, Bitmap bitmap);
+	public native boolean getContextSourcePixels(long context, int[] pixels);
+	public native boolean setContextFilterChain(long context, int[] effects);
+	public native boolean runContextFilterChain(long context);
+	public native float getContextTimeStamp(long context);
+	public native boolean contextProcessingHasFinished(long context);
+
+	//called on the native job thread, so hop over to the UI thread before drawing
+	public interface ProcessingListener {
+		void onProcessingFinished(int job, boolean succeeded, float timeStamp);
+	}
+
+	//queue a frame (processed in place, null for the context's source image) through
+	//effects (null keeps the context's chain) without waiting. context 0 is the shared
+	//one. Returns the job id, or -1 if it couldn't be queued. Without a listener the result
+	//is kept for waitForProcessingJob until the queue needs the room for newer jobs
+	public native int submitProcessingJob(long context, Bitmap bitmap, int[] effects, ProcessingListener listener);
+	public native boolean waitForProcessingJob(int job);
+	public native boolean processingJobHasFinished(int job);
+
+	//wall clock timing of the native pipeline, 4 longs per span: stage, worker
+	//(-1 for the calling thread), start and duration in ns. Oldest first,
+	//returns how many spans were copied (the native side keeps the last 256)
+	public static final int TIMING_STAGE_UNPACK = 0;
+	public static final int TIMING_STAGE_KERNEL = 1;
+	public static final int TIMING_STAGE_REPACK = 2;
+	public static final int TIMING_STAGE_ENCODE = 3;
+	public static final String[] TIMING_STAGE_NAMES = {"unpack", "kernel", "repack", "encode"};
+	public native int getTimingSpans(long[] spans);
+	public native void clearTimingSpans();
+
 	//Image capture constants
 	final int PICTURE_ACTIVITY = 1000; // This is only really needed if you are catching the results of more than one activity.  It'll make sense later.
 	public static final String TEMP_PREFIX = "tmp_";
@@ -451,13 +521,20 @@ public class ImageThreshActivity extends Activity {
 					//establish the parameters of the image and allocate space for it
 					int w = photo.getWidth();
 					int h = photo.getHeight();
-					int[] data = new int[w * h];
-
-					//set the data with the pixels from the photo
-					photo.getPixels(data, 0, w, 0, 0, w, h);
-
-					//pass the pixels to OpenCV for later processing
-					boolean didSet = this.setSourceImage(data, w, h);
+					int[] data = null;
+
+					//pass the pixels to OpenCV for later processing, straight
+					//from the bitmap when it's in a format the NDK can lock
+					boolean fromBitmap = photo.getConfig() == Bitmap.Config.ARGB_8888;
+					boolean didSet;
+					if(fromBitmap){
+						didSet = this.setSourceBitmap(photo);
+					}else{
+						//set the data with the pixels from the photo
+						data = new int[w * h];
+						photo.getPixels(data, 0, w, 0, 0, w, h);
+						didSet = this.setSourceImage(data, w, h);
+					}
 
 					Log.i("Captain's Log", "Image Passed into the NDK");
 
@@ -469,7 +546,11 @@ public class ImageThreshActivity extends Activity {
 							//this.doGrayscaleTransform();
 							float [] runtimes = new float[100];
 							for (int i = 0; i < 100; i++){
-								this.setSourceImage(data, w, h);
+								if(fromBitmap){
+									this.setSourceBitmap(photo);
+								}else{
+									this.setSourceImage(data, w, h);
+								}
 								float startnow = android.os.SystemClock.uptimeMillis();
 
 								
@@ -535,6 +616,7 @@ public class ImageThreshActivity extends Activity {
 
 						}else{
 							//we don't need 100 iterations of the same thing, so we test it once
+							this.clearTimingSpans();
 							float startnow = android.os.SystemClock.uptimeMillis();
 
 							switch(effectNo){
@@ -564,6 +646,7 @@ public class ImageThreshActivity extends Activity {
 
 							float endnow = android.os.SystemClock.uptimeMillis();
 							Log.d("MYTAG", "Execution time: "+(endnow-startnow)+" ms");
+							LogTimingSpans();
 
 						}	
 
@@ -572,10 +655,19 @@ public class ImageThreshActivity extends Activity {
 
 						//collect the data back from openCV
 						Log.i("Captain's Log", "setting image was successful");
-						byte[] resultData = this.getSourceImage();
-
-						//process the OpenCV returned data back into a usable bitmap and display it
-						Bitmap resultPhoto = BitmapFactory.decodeByteArray(resultData, 0, resultData.length);
+						Bitmap resultPhoto = Bitmap.createBitmap(w, h, Bitmap.Config.ARGB_8888);
+
+						//have OpenCV write straight into a bitmap, then try raw pixels, and only
+						//fall back to decoding the BMP it makes if neither works
+						if(!this.getSourceBitmap(resultPhoto)){
+							int[] resultPixels = new int[w*h];
+							if(this.getSourcePixels(resultPixels)){
+								resultPhoto = Bitmap.createBitmap(resultPixels, w, h, Bitmap.Config.ARGB_8888);
+							}else{
+								byte[] resultData = this.getSourceImage();
+								resultPhoto = BitmapFactory.decodeByteArray(resultData, 0, resultData.length);
+							}
+						}
 
 						runtimeView.setText("Runtime (Sec) =" + Float.toString(runTime));
 						imageView.setImageBitmap(resultPhoto);
@@ -741,6 +833,23 @@ public class ImageThreshActivity extends Activity {
 	}
 
 
+	private void LogTimingSpans(){
+		long[] spans = new long[256*4];
+		int count = this.getTimingSpans(spans);
+		long[] totals = new long[TIMING_STAGE_NAMES.length];
+		
+		//the workers' spans overlap the calling thread's, so only add up the latter
+		for(int i = 0; i < count; i++){
+			if(spans[i*4+1] == -1)
+				totals[(int)spans[i*4]] += spans[i*4+3];
+		}
+		
+		for(int stage = 0; stage < totals.length; stage++){
+			Log.d("MYTAG", TIMING_STAGE_NAMES[stage]+" time: "+(totals[stage]/1000000.0)+" ms");
+		}
+	}
+
+
 	private void LogCameraResolutions(){
 		Log.i("Captain's Log", "The Back Camera has photo width -> " + backCameraPhotoWidth + " height -> " + backCameraPhotoHeight);
 		Log.i("Captain's Log", "The Front Camera has photo width -> " + frontCameraPhotoWidth + " height -> " + frontCameraPhotoHeight);